@@ -34,6 +34,7 @@
 #include <stdexcept>
 #include <string>
 #include <list>
+#include <thread>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -92,6 +93,15 @@ int main (int argc, char *argv[]) {
 
   int num_frames = 1;
   int threads = 1;
+  int spin_us = 0;
+  int pipeline_depth = 0;
+  int picture_threads = 0;
+  bool shared_pool = false;
+  bool numa_split = false;
+  bool global_transform = false;
+  bool sticky_jobs = false;
+  bool fused_dequantise = false;
+  bool subband_layout = false;
   bool disable_output = false;
   bool colourise_quantiser = false;
   bool colourise_padding = false;
@@ -110,6 +120,15 @@ int main (int argc, char *argv[]) {
     TCLAP::SwitchArg     verbose_arg             ("v", "verbose",        "verbose mode",                                    cmd, false);
     TCLAP::ValueArg<int> num_frames_arg          ("n", "num-frames",     "Number of frames to decode", false, 1, "integer", cmd);
     TCLAP::ValueArg<int> num_threads_arg         ("t", "threads",        "Number of threads",          false, 1, "integer", cmd);
+    TCLAP::ValueArg<int> spin_us_arg             ("s", "spin-us",        "Microseconds idle threads spin before sleeping (negative never spins)", false, 0, "integer", cmd);
+    TCLAP::ValueArg<int> pipeline_depth_arg      ("P", "pipeline-depth", "Number of pictures to decode at once",       false, 0, "integer", cmd);
+    TCLAP::ValueArg<int> picture_threads_arg     ("T", "picture-threads", "Number of threads to split each picture over", false, 0, "integer", cmd);
+    TCLAP::SwitchArg     shared_pool_arg         ("S", "shared-pool",    "run on a process wide shared pool of -t threads, one per core with -t=0",        cmd, false);
+    TCLAP::SwitchArg     numa_split_arg          ("N", "numa-split",     "split each picture between NUMA nodes",           cmd, false);
+    TCLAP::SwitchArg     global_transform_arg    ("G", "global-transform", "decode each picture as one plane, sharing each transform level", cmd, false);
+    TCLAP::SwitchArg     sticky_jobs_arg         ("K", "sticky-jobs",    "always decode each part of a picture on the same thread", cmd, false);
+    TCLAP::SwitchArg     fused_dequantise_arg    ("F", "fused-dequantise", "dequantise coefficients as they are decoded, in pictures of under one bit per coefficient", cmd, false);
+    TCLAP::SwitchArg     subband_layout_arg      ("B", "subband-layout", "hold each picture a subband at a time while decoding", cmd, false);
     TCLAP::SwitchArg     disable_output_args     ("d", "disable-output",      "disable output",                                  cmd, false);
     TCLAP::SwitchArg     colourise_quantiser_args("q", "colourise-quantiser", "colourise based on quantiser levels",             cmd, false);
     TCLAP::SwitchArg     colourise_padding_args  ("p", "colourise-padding", "colourise based on padding levels",               cmd, false);
@@ -122,6 +141,15 @@ int main (int argc, char *argv[]) {
 
     num_frames          = num_frames_arg.getValue();
     threads             = num_threads_arg.getValue();
+    spin_us             = spin_us_arg.getValue();
+    pipeline_depth      = pipeline_depth_arg.getValue();
+    picture_threads     = picture_threads_arg.getValue();
+    shared_pool         = shared_pool_arg.getValue();
+    numa_split          = numa_split_arg.getValue();
+    global_transform    = global_transform_arg.getValue();
+    sticky_jobs         = sticky_jobs_arg.getValue();
+    fused_dequantise    = fused_dequantise_arg.getValue();
+    subband_layout      = subband_layout_arg.getValue();
     disable_output      = disable_output_args.getValue();
     colourise_quantiser = colourise_quantiser_args.getValue();
     colourise_padding   = colourise_padding_args.getValue();
@@ -155,6 +183,17 @@ int main (int argc, char *argv[]) {
   
   /* Initialise decoder */
   vc2decode_init();
+  if (shared_pool) {
+    /* With -t=0 the pool has a thread for each core, and the decoder splits pictures over all of them */
+    int pool_threads = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+    if (pool_threads < 1)
+      pool_threads = 1;
+    VC2DecoderResult r = vc2decode_init_shared_pool(pool_threads, 0, spin_us);
+    if (r != VC2DECODER_OK) {
+      printf("Shared Pool Error: %d\n", r);
+      return 1;
+    }
+  }
   VC2DecoderHandle decoder = vc2decode_create();
 
   /* Configure decoder */
@@ -163,6 +202,15 @@ int main (int argc, char *argv[]) {
     memset((void *)&params, 0, sizeof(params));
 
     params.threads = threads;
+    params.thread_spin_us = spin_us;
+    params.pipeline_depth = pipeline_depth;
+    params.picture_threads = picture_threads;
+    params.use_shared_pool = shared_pool;
+    params.numa_split_picture = numa_split;
+    params.global_transform = global_transform;
+    params.sticky_jobs = sticky_jobs;
+    params.fused_dequantise = fused_dequantise;
+    params.subband_layout = subband_layout;
     params.colourise_quantiser = colourise_quantiser;
     params.colourise_padding   = colourise_padding;
     params.colourise_unpadded  = colourise_unpadded;
@@ -308,7 +356,10 @@ int main (int argc, char *argv[]) {
     int64_t start, end;
     start = gettime();
     while (total_frames_decoded < num_frames) {
-      r = vc2decode_decode_one_picture(decoder, &id, iend - id, opics[picture], ostride, true);
+      if (pipeline_depth > 1)
+        r = vc2decode_start_one_picture(decoder, &id, iend - id, opics[picture], ostride, true);
+      else
+        r = vc2decode_decode_one_picture(decoder, &id, iend - id, opics[picture], ostride, true);
 
       if (r == VC2DECODER_OK_EOS) {
         VERBOSE_PRINT("End of Sequence so break from loop");
@@ -344,6 +395,17 @@ int main (int argc, char *argv[]) {
       fprintf(stderr, "Unknown Return value: %d\n", r);
       break;
     }
+
+    VERBOSE_PRINT("Wait for any pictures still being decoded");
+    {
+      uint16_t *opic[3];
+      while ((r = vc2decode_finish_one_picture(decoder, opic)) == VC2DECODER_OK_PICTURE);
+      if (r < 0 && !err) {
+        fprintf(stderr, "Error decoding:\n");
+        fprintf(stderr, "  %s\n", VC2DecoderErrorString[-r]);
+        err = 1;
+      }
+    }
     end = gettime();
     VERBOSE_PRINT("We have reached the end of a sequence, or have decoded enough frames");
 
@@ -503,7 +565,7 @@ void print_sequence_info(VC2DecoderSequenceInfo &info, bool /*verbose*/) {
   if (info.transform_params.custom_quant_matrix_flag) {
     printf("      + Custom Quantisation Matrix\n");
     printf("        0 : %4d\n", info.transform_params.quant_matrix_LL);
-    for (int l = 1; l < (int)info.transform_params.wavelet_depth; l++) {
+    for (int l = 1; l <= (int)info.transform_params.wavelet_depth; l++) {
       printf("        %1d : %4d  %4d  %4d\n", l, info.transform_params.quant_matrix_LH[l - 1], info.transform_params.quant_matrix_HL[l - 1], info.transform_params.quant_matrix_HH[l - 1]);
     }
   }
@@ -49,10 +49,21 @@ dequantisetest_data DEQUANTISETEST_DATA[] = {
   { 0, 52,   4, 8, 2, 2 },
   { 0, 52,  32, 8, 3, 2 },
   { 0, 52,  16, 8, 3, 2 },
+  { 0, 52,  16,16, 3, 2 },
+  { 0, 52,  12, 4, 2, 2 },
+  { 0, 52,  64,16, 4, 2 },
+  { 0, 52,  64,32, 4, 2 },
   { 0, 112,  8, 8, 2, 4 },
   { 0, 112,  4, 8, 2, 4 },
   { 0, 112, 32, 8, 3, 4 },
   { 0, 112, 16, 8, 3, 4 },
+  { 0, 112, 16,16, 3, 4 },
+  { 0, 112, 24, 8, 3, 4 },
+  { 0, 112, 12, 4, 2, 4 },
+  { 0, 112, 64,16, 4, 4 },
+  { 0, 112, 32,16, 1, 4 },
+  { 0, 112, 16, 8, 0, 4 },
+  { 0, 112,  4, 4, 1, 4 },
 };
 const int DEQUANTISETEST_DATA_NUM = sizeof(DEQUANTISETEST_DATA)/sizeof(dequantisetest_data);
 
@@ -86,13 +97,16 @@ int perform_dequantisetest(dequantisetest_data &data,
     }
 
     {
-      /* Allocate input and output data buffers */
-      int32_t *idata = (int32_t *)ALIGNED_ALLOC(32, data.slice_width*data.slice_height*sizeof(int32_t));
+      /* Allocate input and output data buffers, the coefficients are the same size as the samples */
+      void *idata = ALIGNED_ALLOC(32, data.slice_width*data.slice_height*data.sample_size);
       void *cdata = ALIGNED_ALLOC(32, data.slice_width*data.slice_height*data.sample_size);
       void *tdata = ALIGNED_ALLOC(32, data.slice_width*data.slice_height*data.sample_size);
 
       for (int i = 0; i < data.slice_width*data.slice_height; i++) {
-        idata[i] = ((int32_t *)idata_pre)[i] >> (((data.sample_size == 2)?17:1) + ((qi + 3)/4));
+        if (data.sample_size == 2)
+          ((int16_t *)idata)[i] = ((int32_t *)idata_pre)[i] >> (17 + ((qi + 3)/4));
+        else
+          ((int32_t *)idata)[i] = ((int32_t *)idata_pre)[i] >> (1 + ((qi + 3)/4));
       }
       memset(cdata, 0, data.slice_width*data.slice_height*data.sample_size);
       memset(tdata, 0, data.slice_width*data.slice_height*data.sample_size);
@@ -142,6 +156,54 @@ int perform_dequantisetest(dequantisetest_data &data,
   return r;
 }
 
+/* A custom matrix equal to the default must share its cache entry, and matrices deeper than the
+   default tables go up to MAX_DWT_DEPTH */
+int perform_matrixcachetest() {
+  printf("Quantisation matrix cache: ");
+  const int depth = 3;
+  const int qindex_max = 64;
+  const uint32_t HL[] = { 2, 4, 5 }, LH[] = { 2, 4, 5 }, HH[] = { 0, 2, 3 };
+
+  VC2DecoderTransformParams params;
+  memset(&params, 0, sizeof(params));
+  params.wavelet_index = VC2DECODER_WFT_LEGALL_5_3;
+  params.wavelet_depth = depth;
+
+  QuantisationMatrix *reference = quantisation_matrices(VC2DECODER_WFT_LEGALL_5_3, depth, qindex_max);
+  QuantisationMatrix *defaults = get_quantisation_matrices(params, qindex_max);
+
+  params.custom_quant_matrix_flag = 1;
+  params.quant_matrix_LL = 4;
+  for (int l = 0; l < depth; l++) {
+    params.quant_matrix_HL[l] = HL[l];
+    params.quant_matrix_LH[l] = LH[l];
+    params.quant_matrix_HH[l] = HH[l];
+  }
+  QuantisationMatrix *custom = get_quantisation_matrices(params, qindex_max);
+
+  params.quant_matrix_HH[depth - 1]++;
+  QuantisationMatrix *changed = get_quantisation_matrices(params, qindex_max);
+
+  params.wavelet_depth = MAX_DWT_DEPTH;
+  QuantisationMatrix *deep = get_quantisation_matrices(params, qindex_max);
+
+  int r = (custom != defaults || changed == defaults || deep == changed);
+  for (int q = 0; !r && q <= qindex_max; q++)
+    for (int l = 0; l <= depth; l++)
+      if (memcmp(reference[q].qfactor[l], defaults[q].qfactor[l], 4*sizeof(__m128i)) ||
+          memcmp(reference[q].qoffset[l], defaults[q].qoffset[l], 4*sizeof(__m128i)))
+        r = 1;
+
+  release_quantisation_matrices(deep);
+  release_quantisation_matrices(changed);
+  release_quantisation_matrices(custom);
+  release_quantisation_matrices(defaults);
+  delete_matrices(reference);
+
+  printf(r ? " FAIL\n" : "  OK\n");
+  return r;
+}
+
 
 int test_dequantise(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
   printf("--------------------------------------------------------------------------------\n");
@@ -161,6 +223,8 @@ int test_dequantise(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
                                idata,
                                HAS_SSE4_2, HAS_AVX, HAS_AVX2);
   }
+  if (!r)
+    r = perform_matrixcachetest();
 
   printf("--------------------------------------------------------------------------------\n");
 
@@ -149,6 +149,30 @@ invvtransformtest_data INVVTRANSFORMTEST_DATA[] = {
 };
 const int INVVTRANSFORMTEST_DATA_NUM = sizeof(INVVTRANSFORMTEST_DATA)/sizeof(invvtransformtest_data);
 
+struct subbandtransformtest_data {
+  int wavelet;
+  int active_bits;
+  int sample_size;
+};
+
+subbandtransformtest_data SUBBANDTRANSFORMTEST_DATA[] = {
+  { VC2DECODER_WFT_HAAR_NO_SHIFT,     10, 2 },
+  { VC2DECODER_WFT_HAAR_NO_SHIFT,     12, 4 },
+  { VC2DECODER_WFT_HAAR_SINGLE_SHIFT, 10, 2 },
+  { VC2DECODER_WFT_HAAR_SINGLE_SHIFT, 12, 4 },
+  { VC2DECODER_WFT_LEGALL_5_3,        10, 2 },
+  { VC2DECODER_WFT_LEGALL_5_3,        10, 4 },
+  { VC2DECODER_WFT_LEGALL_5_3,        12, 2 },
+  { VC2DECODER_WFT_LEGALL_5_3,        12, 4 },
+};
+const int SUBBANDTRANSFORMTEST_DATA_NUM = sizeof(SUBBANDTRANSFORMTEST_DATA)/sizeof(subbandtransformtest_data);
+
+/* The subband tests undo a vertical level and then a horizontal one. With LeGall (5,3), which grows samples the
+   most, inputs below B in magnitude are below 2.5B + 1 after the vertical level, and the sums in the horizontal
+   lifting are below 3(2.5B + 1) + 2. The 16-bit kernels must agree when those sums fit in 16 bits, which is for
+   B up to 4368, so the 16-bit samples for these tests are kept below this */
+const int SUBBANDTRANSFORMTEST_MAX_SAMPLE_16 = 4096;
+
 int perform_invhtransformtest(invhtransformtest_data &data,
                               void *idata_pre,
                               const int width,
@@ -422,6 +446,206 @@ int perform_invvtransformtest(invvtransformtest_data &data,
   return r;
 }
 
+/* Undoes one level held a subband at a time, with the subbands in the four quadrants of sdata, writing the
+   interleaved samples to odata, or the output of the final level to fdata when it is given */
+static void subband_transform(SubbandTransformV vtrans, SubbandTransformH htrans, SubbandTransformFinal ftrans,
+                              char *sdata, char *odata, char *fdata, int w, int h, int stride, int sample_size,
+                              int ooffset_x, int owidth) {
+  char *ll = sdata;
+  char *hl = sdata + w*sample_size;
+  char *lh = sdata + h*stride*sample_size;
+  char *hh = lh + w*sample_size;
+
+  vtrans(ll, stride, lh, stride, w, h);
+  vtrans(hl, stride, hh, stride, w, h);
+  if (fdata) {
+    ftrans(ll, stride, hl, stride, fdata, 2*stride, w, h, ooffset_x, owidth);
+    ftrans(lh, stride, hh, stride, fdata + stride*2, 2*stride, w, h, ooffset_x, owidth);
+  } else {
+    htrans(ll, stride, hl, stride, odata, 2*stride, w, h);
+    htrans(lh, stride, hh, stride, odata + stride*sample_size, 2*stride, w, h);
+  }
+}
+
+/* The transforms for planes held a subband at a time must match the interleaved ones on the same samples */
+int perform_subbandtransformtest(subbandtransformtest_data &data,
+                                 void *idata_pre,
+                                 const int stride,
+                                 bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
+  int r = 0;
+  (void)HAS_AVX;(void)HAS_AVX2;
+
+  /* An odd width leaves samples past the last whole vector, and an odd output width a lone sample at the end */
+  const int w = 477;
+  const int h = 270;
+  const int ooffset_x = 2;
+  const int owidth = 2*w - 7;
+  const int ss = data.sample_size;
+
+  printf("%-20s: Subbands %d-bit output ", VC2DecoderWaveletFilterTypeString[data.wavelet], data.active_bits);
+  if (ss == 2)
+    printf("16-bit ");
+  else
+    printf("32-bit ");
+
+  char *idata  = (char *)ALIGNED_ALLOC(32, 2*h*stride*ss);
+  char *sdata  = (char *)ALIGNED_ALLOC(32, 2*h*stride*ss);
+  char *odata  = (char *)ALIGNED_ALLOC(32, 2*h*stride*ss);
+  char *ifdata = (char *)ALIGNED_ALLOC(32, 2*h*stride*2);
+  char *sfdata = (char *)ALIGNED_ALLOC(32, 2*h*stride*2);
+
+  /* The interleaved transforms of the last level, with the samples split into their subbands for the others */
+  InplaceTransform ivtrans = get_invvtransform_c(data.wavelet, 1, 2, ss);
+  InplaceTransform ihtrans = get_invhtransform_c(data.wavelet, 1, 2, ss);
+  InplaceTransformFinal iftrans = get_invhtransformfinal_c(data.wavelet, data.active_bits, ss);
+
+  struct { bool present; const char *name; GetInvVSubbandTransform getv; GetInvHSubbandTransform geth; GetInvHSubbandTransformFinal getf; } variants[] = {
+    { true,       "C",      get_invvtransform_subbands_c,      get_invhtransform_subbands_c,      get_invhtransformfinal_subbands_c },
+    { HAS_SSE4_2, "SSE4.2", get_invvtransform_subbands_sse4_2, get_invhtransform_subbands_sse4_2, get_invhtransformfinal_subbands_sse4_2 },
+  };
+
+  for (int final = 0; !r && final < 2; final++) {
+    memcpy(idata, idata_pre, 2*h*stride*ss);
+    memset(ifdata, 0, 2*h*stride*2);
+    ivtrans(idata, stride, 2*w, 2*h);
+    if (final)
+      iftrans(idata, stride, ifdata, stride, 2*w, 2*h, ooffset_x, 0, owidth, 2*h);
+    else
+      ihtrans(idata, stride, 2*w, 2*h);
+
+    for (int i = 0; !r && i < (int)(sizeof(variants)/sizeof(variants[0])); i++) {
+      if (!variants[i].present)
+        continue;
+      printf(" %s %s [", variants[i].name, final ? "Final" : "H");
+
+      for (int y = 0; y < 2*h; y++) {
+        for (int x = 0; x < 2*w; x++) {
+          const int n = ((y%2)*h + y/2)*stride + (x%2)*w + x/2;
+          memcpy(&sdata[n*ss], &((char *)idata_pre)[(y*stride + x)*ss], ss);
+        }
+      }
+      memset(sfdata, 0, 2*h*stride*2);
+      subband_transform(variants[i].getv(data.wavelet, ss), variants[i].geth(data.wavelet, ss), variants[i].getf(data.wavelet, data.active_bits, ss),
+                        sdata, odata, final ? sfdata : NULL, w, h, stride, ss, ooffset_x, owidth);
+
+      bool same = true;
+      for (int y = 0; same && y < 2*h; y++) {
+        if (final)
+          same = !memcmp(&ifdata[y*stride*2], &sfdata[y*stride*2], owidth*2);
+        else
+          same = !memcmp(&idata[y*stride*ss], &odata[y*stride*ss], 2*w*ss);
+      }
+      if (!same) {
+        printf("FAIL]");
+        r = 1;
+      } else {
+        printf(" OK ]");
+      }
+    }
+  }
+
+  printf("\n");
+
+  ALIGNED_FREE(idata);
+  ALIGNED_FREE(sdata);
+  ALIGNED_FREE(odata);
+  ALIGNED_FREE(ifdata);
+  ALIGNED_FREE(sfdata);
+
+  return r;
+}
+
+/* The transforms for a zero high pass subband must match the others given one of zeros, without reading it */
+int perform_subbandzerohightest(subbandtransformtest_data &data,
+                                void *idata_pre,
+                                const int stride,
+                                bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
+  int r = 0;
+  (void)HAS_AVX;(void)HAS_AVX2;
+
+  const int w = 477;
+  const int h = 270;
+  const int ooffset_x = 2;
+  const int owidth = 2*w - 7;
+  const int ss = data.sample_size;
+
+  printf("%-20s: Zero High %d-bit output ", VC2DecoderWaveletFilterTypeString[data.wavelet], data.active_bits);
+  if (ss == 2)
+    printf("16-bit ");
+  else
+    printf("32-bit ");
+
+  char *ldata = (char *)idata_pre;
+  char *hdata = (char *)idata_pre + h*stride*ss;
+  char *cl = (char *)ALIGNED_ALLOC(32, h*stride*ss);
+  char *ch = (char *)ALIGNED_ALLOC(32, h*stride*ss);
+  char *co = (char *)ALIGNED_ALLOC(32, 2*h*stride*ss);
+  char *tl = (char *)ALIGNED_ALLOC(32, h*stride*ss);
+  char *th = (char *)ALIGNED_ALLOC(32, h*stride*ss);
+  char *to = (char *)ALIGNED_ALLOC(32, 2*h*stride*ss);
+
+  struct { bool present; const char *name; GetInvVSubbandTransform getv; GetInvHSubbandTransform geth; GetInvHSubbandTransformFinal getf; } variants[] = {
+    { true,       "C",      get_invvtransform_subbands_zero_high_c,      get_invhtransform_subbands_zero_high_c,      get_invhtransformfinal_subbands_zero_high_c },
+    { HAS_SSE4_2, "SSE4.2", get_invvtransform_subbands_zero_high_sse4_2, get_invhtransform_subbands_zero_high_sse4_2, get_invhtransformfinal_subbands_zero_high_sse4_2 },
+  };
+
+  for (int stage = 0; !r && stage < 3; stage++) {
+    /* The regular transforms given a high pass subband of zeros */
+    memcpy(cl, ldata, h*stride*ss);
+    memset(ch, 0, h*stride*ss);
+    memset(co, 0, 2*h*stride*ss);
+    if (stage == 0)
+      get_invvtransform_subbands_c(data.wavelet, ss)(cl, stride, ch, stride, w, h);
+    else if (stage == 1)
+      get_invhtransform_subbands_c(data.wavelet, ss)(cl, stride, ch, stride, co, 2*stride, w, h);
+    else
+      get_invhtransformfinal_subbands_c(data.wavelet, data.active_bits, ss)(cl, stride, ch, stride, co, stride, w, h, ooffset_x, owidth);
+
+    for (int i = 0; !r && i < (int)(sizeof(variants)/sizeof(variants[0])); i++) {
+      if (!variants[i].present)
+        continue;
+      printf(" %s %s [", variants[i].name, (stage == 0) ? "V" : (stage == 1) ? "H" : "Final");
+
+      /* Anything left in the high pass subband must not reach the output */
+      memcpy(tl, ldata, h*stride*ss);
+      memcpy(th, hdata, h*stride*ss);
+      memset(to, 0, 2*h*stride*ss);
+      if (stage == 0)
+        variants[i].getv(data.wavelet, ss)(tl, stride, th, stride, w, h);
+      else if (stage == 1)
+        variants[i].geth(data.wavelet, ss)(tl, stride, th, stride, to, 2*stride, w, h);
+      else
+        variants[i].getf(data.wavelet, data.active_bits, ss)(tl, stride, th, stride, to, stride, w, h, ooffset_x, owidth);
+
+      bool same = true;
+      for (int y = 0; same && y < h; y++) {
+        if (stage == 0)
+          same = !memcmp(&cl[y*stride*ss], &tl[y*stride*ss], w*ss) && !memcmp(&ch[y*stride*ss], &th[y*stride*ss], w*ss);
+        else if (stage == 1)
+          same = !memcmp(&co[y*2*stride*ss], &to[y*2*stride*ss], 2*w*ss);
+        else
+          same = !memcmp(&co[y*stride*2], &to[y*stride*2], owidth*2);
+      }
+      if (!same) {
+        printf("FAIL]");
+        r = 1;
+      } else {
+        printf(" OK ]");
+      }
+    }
+  }
+
+  printf("\n");
+
+  ALIGNED_FREE(cl);
+  ALIGNED_FREE(ch);
+  ALIGNED_FREE(co);
+  ALIGNED_FREE(tl);
+  ALIGNED_FREE(th);
+  ALIGNED_FREE(to);
+
+  return r;
+}
 
 int test_invtransform(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
   printf("--------------------------------------------------------------------------------\n");
@@ -483,8 +707,31 @@ int test_invtransform(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
                                   HAS_SSE4_2, HAS_AVX, HAS_AVX2);
   }
 
+  void *sdata16 = ALIGNED_ALLOC(32, height*stride*sizeof(int16_t));
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < stride; x++)
+      ((int16_t *)sdata16)[y*stride + x] = ((int16_t *)idata16)[y*stride + x] % SUBBANDTRANSFORMTEST_MAX_SAMPLE_16;
+  }
+
+  for (int i = 0; !r && i < SUBBANDTRANSFORMTEST_DATA_NUM; i++) {
+    void * idata = (SUBBANDTRANSFORMTEST_DATA[i].sample_size == 2)?sdata16:idata32;
+    r = perform_subbandtransformtest(SUBBANDTRANSFORMTEST_DATA[i],
+                                     idata,
+                                     stride,
+                                     HAS_SSE4_2, HAS_AVX, HAS_AVX2);
+  }
+
+  for (int i = 0; !r && i < SUBBANDTRANSFORMTEST_DATA_NUM; i++) {
+    void * idata = (SUBBANDTRANSFORMTEST_DATA[i].sample_size == 2)?sdata16:idata32;
+    r = perform_subbandzerohightest(SUBBANDTRANSFORMTEST_DATA[i],
+                                    idata,
+                                    stride,
+                                    HAS_SSE4_2, HAS_AVX, HAS_AVX2);
+  }
+
   ALIGNED_FREE(idata16);
   ALIGNED_FREE(idata32);
+  ALIGNED_FREE(sdata16);
 
   printf("--------------------------------------------------------------------------------\n");
   return r;
@@ -0,0 +1,269 @@
+/*****************************************************************************
+ * test_threadpool.cpp : test and time thread pool dispatch
+ *****************************************************************************
+ * Copyright (C) 2014-2015 BBC
+ *
+ * Authors: James P. Weaver <james.barrett@bbc.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at ipstudio@bbc.co.uk.
+ *****************************************************************************/
+
+#include "tests.hpp"
+#include <cstdio>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "ThreadPool.hpp"
+
+struct threadpooltest_data {
+  int threads;
+  int tasks;
+  int spin_us;
+};
+
+threadpooltest_data THREADPOOLTEST_DATA[] = {
+  { 1,  4,  -1 },
+  { 1,  4,  THREADPOOL_DEFAULT_SPIN_US },
+  { 2,  8,  -1 },
+  { 2,  8,  THREADPOOL_DEFAULT_SPIN_US },
+  { 4, 16,  -1 },
+  { 4, 16,  THREADPOOL_DEFAULT_SPIN_US },
+  { 8, 32,  -1 },
+  { 8, 32,  THREADPOOL_DEFAULT_SPIN_US },
+};
+const int THREADPOOLTEST_DATA_NUM = sizeof(THREADPOOLTEST_DATA)/sizeof(threadpooltest_data);
+
+const int THREADPOOLTEST_ROUNDS = 1000;
+
+static void count_task(std::atomic<int> *count, ThreadPool *pool, bool follow_on, int w) {
+  ++(*count);
+  if (follow_on)
+    pool->post(w, std::bind(count_task, count, pool, false, std::placeholders::_1));
+}
+
+int perform_threadpooltest(threadpooltest_data &data) {
+  printf("%2d threads %3d tasks, ", data.threads, data.tasks);
+  if (data.spin_us < 0)
+    printf("no spin:    ");
+  else
+    printf("spin %3dus: ", data.spin_us);
+
+  ThreadPool *pool = new ThreadPool(data.threads, 0, data.spin_us);
+  std::atomic<int> count(0);
+
+  double total = 0.0;
+  double worst = 0.0;
+  int r = 0;
+  for (int n = 0; n < THREADPOOLTEST_ROUNDS; n++) {
+    count = 0;
+
+    /* Half the tasks each post a follow-on task, as the decoder's slice rows do */
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pool->ready();
+    for (int i = 0; i < data.tasks/2; i++)
+      pool->post(std::bind(count_task, &count, pool, true, std::placeholders::_1));
+    if (pool->execute())
+      r = 1;
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    if (count != (data.tasks/2)*2)
+      r = 1;
+
+    double t = std::chrono::duration<double, std::micro>(end - start).count();
+    total += t;
+    if (t > worst)
+      worst = t;
+  }
+
+  pool->stop();
+  delete pool;
+
+  printf("mean %8.2fus, max %8.2fus ", total/THREADPOOLTEST_ROUNDS, worst);
+  if (r)
+    printf("[ FAIL ]\n");
+  else
+    printf("[  OK  ]\n");
+
+  return r;
+}
+
+static void order_task(std::vector<int> *order, int c, int) {
+  order->push_back(c);
+}
+
+static void gate_task(std::atomic<int> *gate, int) {
+  *gate = 1;
+  while (*gate == 1)
+    std::this_thread::yield();
+}
+
+/* With one worker and two clients, one of which posts far more work, the
+   workers should alternate between them rather than serving them in turn.
+   The worker is held on a gate task whilst the work is posted. */
+int perform_threadpoolfairnesstest() {
+  printf("fairness between clients: ");
+
+  const int TASKS_A = 64;
+  const int TASKS_B = 8;
+
+  ThreadPool *pool = new ThreadPool(1, 0, -1);
+  std::vector<int> order;
+  std::atomic<int> gate(0);
+
+  int a = pool->attach();
+  int b = pool->attach();
+  int r = (a < 0 || b < 0);
+
+  if (!r) {
+    pool->post(0, std::bind(gate_task, &gate, std::placeholders::_1));
+    while (gate == 0)
+      std::this_thread::yield();
+    for (int i = 0; i < TASKS_A; i++)
+      pool->post(a, 0, std::bind(order_task, &order, a, std::placeholders::_1));
+    for (int i = 0; i < TASKS_B; i++)
+      pool->post(b, 0, std::bind(order_task, &order, b, std::placeholders::_1));
+    gate = 2;
+    if (pool->execute() || pool->execute(a) || pool->execute(b))
+      r = 1;
+
+    int last_b = -1;
+    for (int i = 0; i < (int)order.size(); i++)
+      if (order[i] == b)
+        last_b = i;
+    if ((int)order.size() != TASKS_A + TASKS_B || last_b >= 2*TASKS_B)
+      r = 1;
+    printf("last of %d tasks finished %3d of %3d ", TASKS_B, last_b + 1, (int)order.size());
+
+    pool->detach(a);
+    pool->detach(b);
+  }
+
+  pool->stop();
+  delete pool;
+
+  if (r)
+    printf("[ FAIL ]\n");
+  else
+    printf("[  OK  ]\n");
+
+  return r;
+}
+
+static void worker_task(std::atomic<int> *wrong, int expected, int w) {
+  if (w != expected)
+    ++(*wrong);
+}
+
+/* Pinned tasks must only ever be run by the worker they were posted to, even
+   when all of them are given to one worker and the others are idle */
+int perform_threadpoolpinnedtest() {
+  printf("pinned tasks: ");
+
+  const int THREADS = 4;
+  const int TASKS = 64;
+
+  ThreadPool *pool = new ThreadPool(THREADS, 0, THREADPOOL_DEFAULT_SPIN_US);
+  std::atomic<int> wrong(0);
+  int r = 0;
+
+  for (int w = 0; w < THREADS; w++) {
+    pool->ready();
+    for (int i = 0; i < TASKS; i++)
+      pool->post_pinned(0, w, std::bind(worker_task, &wrong, w, std::placeholders::_1));
+    if (pool->execute())
+      r = 1;
+  }
+  if (wrong != 0)
+    r = 1;
+  printf("%d of %d tasks run elsewhere ", (int)wrong, THREADS*TASKS);
+
+  pool->stop();
+  delete pool;
+
+  if (r)
+    printf("[ FAIL ]\n");
+  else
+    printf("[  OK  ]\n");
+
+  return r;
+}
+
+static void sleep_task(int) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+/* Workers with nothing to take whilst another is still busy should go to
+   sleep, so a batch made of one long task uses little CPU time */
+int perform_threadpoolidletest() {
+  printf("idle workers sleep: ");
+
+  const int THREADS = 4;
+
+  ThreadPool *pool = new ThreadPool(THREADS, 0, THREADPOOL_DEFAULT_SPIN_US);
+  int r = 0;
+
+  std::clock_t cpu_start = std::clock();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  pool->ready();
+  pool->post(std::bind(sleep_task, std::placeholders::_1));
+  if (pool->execute())
+    r = 1;
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  double cpu = 1000.0*(std::clock() - cpu_start)/CLOCKS_PER_SEC;
+  double wall = std::chrono::duration<double, std::milli>(end - start).count();
+
+  if (cpu > wall/2)
+    r = 1;
+  printf("%6.2fms cpu in %6.2fms ", cpu, wall);
+
+  pool->stop();
+  delete pool;
+
+  if (r)
+    printf("[ FAIL ]\n");
+  else
+    printf("[  OK  ]\n");
+
+  return r;
+}
+
+int test_threadpool() {
+  printf("--------------------------------------------------------------------------------\n");
+  printf("  Thread Pool Dispatch Latency Tests\n");
+  printf("\n");
+
+  int r = 0;
+  for (int i = 0; !r && i < THREADPOOLTEST_DATA_NUM; i++) {
+    r = perform_threadpooltest(THREADPOOLTEST_DATA[i]);
+  }
+
+  if (!r)
+    r = perform_threadpoolfairnesstest();
+
+  if (!r)
+    r = perform_threadpoolpinnedtest();
+
+  if (!r)
+    r = perform_threadpoolidletest();
+
+  printf("--------------------------------------------------------------------------------\n");
+
+  return r;
+}
@@ -0,0 +1,233 @@
+/*****************************************************************************
+ * test_vlc.cpp : test variable length decoding functions
+ *****************************************************************************
+ * Copyright (C) 2014-2015 BBC
+ *
+ * Authors: James P. Weaver <james.barrett@bbc.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at ipstudio@bbc.co.uk.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include "tests.hpp"
+#include <cstdio>
+#include <vc2hqdecode/vc2hqdecode.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../vc2hqdecode/vlc.hpp"
+#include "../vc2hqdecode/dequantise.hpp"
+#include "../vc2inversetransform_c/vlc_c.hpp"
+#include "../vc2inversetransform_c/dequantise_c.hpp"
+#include "../vc2inversetransform_sse4_2/vlc_sse4_2.hpp"
+#include "../vc2inversetransform_avx2/vlc_avx2.hpp"
+#include "randomiser.hpp"
+#include "platform_variant.hpp"
+
+struct vlctest_data {
+  int slice_width;
+  int slice_height;
+  int slices_x;
+  int slices_y;
+  int length; /* Bytes of coded data per component, some slices are given less */
+};
+
+vlctest_data VLCTEST_DATA[] = {
+  {  8, 8, 4, 2,  16 },
+  {  8, 8, 4, 2,  64 },
+  {  8, 8, 3, 3,  48 },
+  { 16, 8, 4, 2,  32 },
+  { 32, 8, 4, 2, 128 },
+  { 32, 8, 2, 2, 512 },
+};
+const int VLCTEST_DATA_NUM = sizeof(VLCTEST_DATA)/sizeof(vlctest_data);
+const int VLCTEST_DEPTH = 2;
+const int VLCTEST_QINDEX_MAX = 64;
+
+/* Stands in for dequantisation so that the decoded coefficients are compared as they are */
+template<class T> static void copy_coefficients(QuantisationMatrix *, void *idata, void *odata, int ostride, int slice_width, int slice_height, int) {
+  for (int y = 0; y < slice_height; y++)
+    for (int x = 0; x < slice_width; x++)
+      ((T *)odata)[y*ostride + x] = ((T *)idata)[y*slice_width + x];
+}
+
+static void run_slice_decoder(SliceDecoderFunc func, vlctest_data &data, CodedSlice *slices, VideoPlane **planes,
+                              QuantisationMatrix *matrices, DequantiseFunction *dequant) {
+  DecodedSlice *scratch[3*VLC_SCRATCH_SLICES];
+  for (int k = 0; k < VLC_SCRATCH_SLICES; k++) {
+    scratch[3*k + 0] = new DecodedSlice(data.slice_width*data.slice_height);
+    scratch[3*k + 1] = new DecodedSlice(data.slice_width/2*data.slice_height);
+    scratch[3*k + 2] = new DecodedSlice(data.slice_width/2*data.slice_height);
+  }
+
+  for (int c = 0; c < 3; c++)
+    memset(planes[c]->data, 0xAA, planes[c]->allocsize);
+
+  func(matrices, slices, scratch, data.slices_x, data.slices_y, planes,
+       data.slice_width, data.slice_height, VLCTEST_DEPTH, dequant);
+
+  for (int i = 0; i < 3*VLC_SCRATCH_SLICES; i++)
+    delete scratch[i];
+}
+
+static void run_fused_slice_decoder(FusedSliceDecoderFunc func, vlctest_data &data, CodedSlice *slices, VideoPlane **planes,
+                                    QuantisationMatrix *matrices) {
+  FusedPlacement *placement[3] = { new FusedPlacement(data.slice_width,   data.slice_height, VLCTEST_DEPTH),
+                                   new FusedPlacement(data.slice_width/2, data.slice_height, VLCTEST_DEPTH),
+                                   new FusedPlacement(data.slice_width/2, data.slice_height, VLCTEST_DEPTH) };
+
+  for (int c = 0; c < 3; c++)
+    memset(planes[c]->data, 0xAA, planes[c]->allocsize);
+
+  func(matrices, slices, data.slices_x, data.slices_y, planes,
+       data.slice_width, data.slice_height, VLCTEST_DEPTH, placement);
+
+  for (int c = 0; c < 3; c++)
+    delete placement[c];
+}
+
+static bool same_output(vlctest_data &data, int sample_size, CodedSlice *cslices, VideoPlane **cplanes, CodedSlice *tslices, VideoPlane **tplanes) {
+  for (int n = 0; n < data.slices_x*data.slices_y; n++)
+    if (cslices[n].padding != tslices[n].padding)
+      return false;
+  for (int c = 0; c < 3; c++)
+    for (int y = 0; y < cplanes[c]->height; y++)
+      if (memcmp(&cplanes[c]->as<char>()[y*cplanes[c]->stride*sample_size], &tplanes[c]->as<char>()[y*tplanes[c]->stride*sample_size], cplanes[c]->width*sample_size))
+        return false;
+  return true;
+}
+
+int perform_vlctest(vlctest_data &data, char *idata, int sample_size, bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
+  (void)HAS_AVX;
+
+  printf("%2dx%-2d slices, %3d bytes, %2d-bit: ", data.slice_width, data.slice_height, data.length, 8*sample_size);
+
+  const int N = data.slices_x*data.slices_y;
+  CodedSlice *cslices = new CodedSlice[N];
+  CodedSlice *tslices = new CodedSlice[N];
+
+  /* Slices are given anything from no data at all to the full length, so that some
+     end part way through a coefficient and some are followed by unused bytes */
+  for (int n = 0; n < N; n++) {
+    for (int c = 0; c < 3; c++) {
+      cslices[n].data[c]   = idata + ((n*3 + c)*data.length)%4096;
+      cslices[n].length[c] = (n == 0) ? 0 : (data.length*((n*3 + c)%5 + 1))/5;
+    }
+    cslices[n].qindex = (n*7)%VLCTEST_QINDEX_MAX;
+    cslices[n].padding = 0;
+  }
+
+  VideoPlane *cplanes[3] = { new VideoPlane(data.slice_width*data.slices_x, data.slice_height*data.slices_y, sample_size),
+                             new VideoPlane(data.slice_width/2*data.slices_x, data.slice_height*data.slices_y, sample_size),
+                             new VideoPlane(data.slice_width/2*data.slices_x, data.slice_height*data.slices_y, sample_size) };
+  VideoPlane *tplanes[3] = { new VideoPlane(data.slice_width*data.slices_x, data.slice_height*data.slices_y, sample_size),
+                             new VideoPlane(data.slice_width/2*data.slices_x, data.slice_height*data.slices_y, sample_size),
+                             new VideoPlane(data.slice_width/2*data.slices_x, data.slice_height*data.slices_y, sample_size) };
+
+  int r = 0;
+
+  QuantisationMatrix *matrices = quantisation_matrices(VC2DECODER_WFT_LEGALL_5_3, VLCTEST_DEPTH, VLCTEST_QINDEX_MAX);
+  DequantiseFunction copy_function = (sample_size == 2) ? copy_coefficients<int16_t> : copy_coefficients<int32_t>;
+  DequantiseFunction copy[3] = { copy_function, copy_function, copy_function };
+  DequantiseFunction dequant[3] = { getDequantiseFunction_c(data.slice_width,   data.slice_height, VLCTEST_DEPTH, sample_size),
+                                    getDequantiseFunction_c(data.slice_width/2, data.slice_height, VLCTEST_DEPTH, sample_size),
+                                    getDequantiseFunction_c(data.slice_width/2, data.slice_height, VLCTEST_DEPTH, sample_size) };
+
+  printf(" C [ ");
+  run_slice_decoder(get_slice_decoder_c(sample_size), data, cslices, cplanes, matrices, copy);
+  printf("  OK   ] ");
+
+  struct { bool present; const char *name; GetSliceDecoderFunc get; } variants[] = {
+    { HAS_SSE4_2, "SSE4.2",      get_slice_decoder_sse4_2      },
+    { HAS_AVX2,   "AVX2",        get_slice_decoder_avx2        },
+    { HAS_SSE4_2, "SSE4.2 Wide", get_wide_slice_decoder_sse4_2 },
+    { HAS_AVX2,   "AVX2 Wide",   get_wide_slice_decoder_avx2   },
+  };
+  for (int i = 0; !r && i < (int)(sizeof(variants)/sizeof(variants[0])); i++) {
+    if (!variants[i].present)
+      continue;
+    printf(" %s [ ", variants[i].name);
+    memcpy(tslices, cslices, N*sizeof(CodedSlice));
+    run_slice_decoder(variants[i].get(sample_size), data, tslices, tplanes, matrices, copy);
+    if (!same_output(data, sample_size, cslices, cplanes, tslices, tplanes)) {
+      printf(" FAIL  ] ");
+      r = 1;
+    } else {
+      printf("  OK   ] ");
+    }
+  }
+
+  /* Fused decoders dequantise as they go, so are compared against dequantised output. The random
+     coefficients dequantise out of range of 16-bit samples, which are saturated by the fused decoder
+     but wrapped by the C dequantiser, so only 32-bit output is compared. */
+  if (!r && HAS_SSE4_2 && sample_size == 4) {
+    run_slice_decoder(get_slice_decoder_c(sample_size), data, cslices, cplanes, matrices, dequant);
+
+    printf(" SSE4.2 Fused [ ");
+    memcpy(tslices, cslices, N*sizeof(CodedSlice));
+    run_fused_slice_decoder(get_fused_slice_decoder_sse4_2(sample_size), data, tslices, tplanes, matrices);
+    if (!same_output(data, sample_size, cslices, cplanes, tslices, tplanes)) {
+      printf(" FAIL  ] ");
+      r = 1;
+    } else {
+      printf("  OK   ] ");
+    }
+  }
+  printf("\n");
+
+  delete_matrices(matrices);
+  for (int c = 0; c < 3; c++) {
+    delete cplanes[c];
+    delete tplanes[c];
+  }
+  delete[] cslices;
+  delete[] tslices;
+
+  return r;
+}
+
+int test_vlc(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2) {
+  printf("--------------------------------------------------------------------------------\n");
+  printf("  Variable Length Decoding Tests\n");
+  printf("\n");
+  /* Random bytes are always a valid stream of interleaved exp-Golomb codes */
+  const int ilength = 8192;
+  char *idata = (char *)ALIGNED_ALLOC(32, ilength);
+  if (!randomiser(idata, ilength)) {
+    printf("Error Getting Random Data\n");
+    return 1;
+  }
+  /* Runs of 0xFF bytes of all lengths, which are mostly zeros and take the zero run skipping paths */
+  for (int i = 0; i < ilength; i += 97)
+    memset(&idata[i], 0xFF, i%53);
+
+  /* Coefficients for 16-bit planes are decoded at 16 bits */
+  int r = 0;
+  for (int sample_size = 4; !r && sample_size >= 2; sample_size -= 2) {
+    for (int i = 0; !r && i < VLCTEST_DATA_NUM; i++) {
+      r = perform_vlctest(VLCTEST_DATA[i],
+                          idata,
+                          sample_size,
+                          HAS_SSE4_2, HAS_AVX, HAS_AVX2);
+    }
+  }
+
+  printf("--------------------------------------------------------------------------------\n");
+
+  ALIGNED_FREE(idata);
+  return r;
+}
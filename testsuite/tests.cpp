@@ -30,6 +30,8 @@
 
 int test_invtransform(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2);
 int test_dequantise(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2);
+int test_vlc(bool HAS_SSE4_2, bool HAS_AVX, bool HAS_AVX2);
+int test_threadpool();
 
 static bool HAS_SSE4_2 = false;
 static bool HAS_AVX    = false;
@@ -72,5 +74,11 @@ int main() {
   r = test_dequantise(HAS_SSE4_2, HAS_AVX, HAS_AVX2);
   if (r) return r;
 
+  r = test_vlc(HAS_SSE4_2, HAS_AVX, HAS_AVX2);
+  if (r) return r;
+
+  r = test_threadpool();
+  if (r) return r;
+
   return 0;
 }
@@ -26,11 +26,12 @@
 #ifndef __THREAD_POOL_HPP__
 #define __THREAD_POOL_HPP__
 
-#define ASIO_STANDALONE
-#include "asio/io_service.hpp"
 #include <functional>
 #include <thread>
-#include "threadbarrier.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
 #include "thread_group.hpp"
 
 #if !defined _WIN32 && !defined __CYGWIN__
@@ -44,50 +45,84 @@
 #endif
 
 #include <atomic>
+#include <immintrin.h>
 
-class ThreadPool {
-public:
-  typedef asio::io_service::work Work;
+/* How long an idle thread busy-waits for new work before it sleeps */
+#define THREADPOOL_DEFAULT_SPIN_US 50
 
-  ThreadPool()
-    : N(1)
-    , start_barrier(1 + 1)
-    , stop_barrier(1 + 1)
-    , _stop(false)
-    , exceptions(0) {
-    for (int i = 0; i < N; i++) {
-      threads.create_thread(std::bind(&ThreadPool::_run, this));
-    }
+/* The most clients, eg. decoders, which can share one pool */
+#define THREADPOOL_MAX_CLIENTS 64
+
+class SpinLock {
+public:
+  SpinLock() { flag.clear(); }
+  void lock() {
+    while (flag.test_and_set(std::memory_order_acquire))
+      _mm_pause();
   }
+  void unlock() { flag.clear(std::memory_order_release); }
+
+private:
+  std::atomic_flag flag;
+};
 
-  ThreadPool(int n)
+/* Work stealing pool: each worker owns a deque of tasks, which it pops from
+   the back. A worker whose own deque is empty steals from the front of the
+   others. Tasks are passed the index of the worker running them, and may
+   post further tasks (eg. ones that depend on them) whilst running.
+
+   The workers persist between calls to execute, and run tasks as soon as
+   they are posted. A worker with nothing it can take spins for up to spin_us
+   microseconds for more work before sleeping on a condition variable, which
+   is signalled by post whenever a worker is asleep. Threads waiting for work
+   to complete spin for the same time before sleeping, so that closely spaced
+   batches never wait on the scheduler. A negative spin_us disables spinning
+   altogether.
+
+   A pool may be shared by several clients, each of which attaches to get its
+   own set of deques. Having run a task from one client a worker looks to the
+   next client first, so that no client can starve the others. Client 0 is
+   always attached and is used by the calls which do not name a client. Each
+   client counts its own pending tasks and exceptions, so that execute on one
+   client neither waits for nor resets another.
+
+   Tasks posted with post_pinned are never stolen, they are only run by the
+   worker they are posted to, so that work on the same data can be kept on
+   the same core from one batch to the next. */
+class ThreadPool {
+public:
+  typedef std::function<void(int)> Task;
+
+  ThreadPool(int n, int numa_first_node = 0, int spin_us = THREADPOOL_DEFAULT_SPIN_US)
     : N(n)
-    , start_barrier(n + 1)
-    , stop_barrier(n + 1)
+    , clients(new Client[THREADPOOL_MAX_CLIENTS])
+    , n_clients(1)
+    , last_client(new int[n])
+    , nodes(new int[n])
+    , spin(spin_us)
     , _stop(false)
-    , exceptions(0) {
+    , sleepers(0)
+    , waiting(0) {
+    clients[0].queues = new WorkQueue[N];
+    clients[0].attached = true;
     for (int i = 0; i < N; i++) {
-      threads.create_thread(std::bind(&ThreadPool::_run, this));
+      last_client[i] = 0;
+      nodes[i] = -1;
     }
-  }
 
-  ThreadPool(int n, int numa_first_node)
-    : N(n)
-    , start_barrier(n + 1)
-    , stop_barrier(n + 1)
-    , _stop(false)
-    , exceptions(0) {
 #ifdef VC2_USE_NUMA
     int n_cpus = numa_num_task_cpus();
     cpu_set_t cpus;
 #endif
     for (int i = 0; i < N; i++) {
-      std::thread * t = threads.create_thread(std::bind(&ThreadPool::_run, this));
+      std::thread * t = threads.create_thread(std::bind(&ThreadPool::_run, this, i));
 #ifdef VC2_USE_NUMA
       pthread_t pt = t->native_handle();
       CPU_ZERO(&cpus);
       CPU_SET((numa_first_node + i)%n_cpus, &cpus);
       pthread_setaffinity_np(pt, sizeof(cpu_set_t), &cpus);
+      if (numa_available() >= 0)
+        nodes[i] = numa_node_of_cpu((numa_first_node + i)%n_cpus);
 #else
       (void)numa_first_node;
       (void)t;
@@ -95,70 +130,256 @@ public:
     }
   }
 
-  void ready() {
-    exceptions = 0;
-    io_service.reset();
-    work = new Work(io_service);
-    start_barrier.wait();
+  int size() const { return N; }
+
+  /* The NUMA node worker w runs on, or -1 if not known */
+  int node(int w) const { return nodes[w]; }
+
+  /* Returns a new client id, or -1 if there are too many clients */
+  int attach() {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    for (int c = 1; c < THREADPOOL_MAX_CLIENTS; c++) {
+      if (!clients[c].attached) {
+        if (!clients[c].queues)
+          clients[c].queues = new WorkQueue[N];
+        clients[c].attached = true;
+        clients[c].exceptions = 0;
+        clients[c].next_queue = 0;
+        if (c >= n_clients)
+          n_clients = c + 1;
+        return c;
+      }
+    }
+    return -1;
   }
 
-  template <typename F> void post(F f) { io_service.post(f); }
+  /* The client must have no work outstanding */
+  void detach(int c) {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    clients[c].attached = false;
+  }
 
-  void _run() {
-    while(true) {
-      start_barrier.wait();
-      if (_stop)
-        return;
+  void ready(int c = 0) {
+    clients[c].exceptions = 0;
+    clients[c].next_queue = 0;
+  }
 
-      try {
-        io_service.run();
-      } catch(...) {
-        ++exceptions;
-      }
-      if (_stop)
-        return;
+  /* Post to the workers in turn, for client 0 */
+  void post(Task f) {
+    post(clients[0].next_queue, f);
+    clients[0].next_queue = (clients[0].next_queue + 1)%N;
+  }
+
+  /* Post to the deque of a specific worker, may be called from a running task */
+  void post(int w, Task f) {
+    post(0, w, f);
+  }
+
+  void post(int c, int w, Task f) {
+    ++clients[c].pending;
+    {
+      std::lock_guard<SpinLock> lock(clients[c].queues[w].lock);
+      clients[c].queues[w].tasks.push_back(f);
+      ++clients[c].queued;
+    }
+    if (sleepers > 0) {
+      std::lock_guard<std::mutex> lock(park_mutex);
+      park_cond.notify_one();
+    }
+  }
 
-      stop_barrier.wait();
-      if (_stop)
-        return;
+  /* Post to worker w only, no other worker will steal the task */
+  void post_pinned(int c, int w, Task f) {
+    ++clients[c].pending;
+    {
+      std::lock_guard<SpinLock> lock(clients[c].queues[w].lock);
+      clients[c].queues[w].pinned.push_back(f);
+      ++clients[c].queues[w].queued_pinned;
+    }
+    if (sleepers > 0) {
+      std::lock_guard<std::mutex> lock(park_mutex);
+      park_cond.notify_all();
     }
   }
 
-  int execute() {
-    if (work)
-      delete work;
-    work = NULL;
+  /* Waits for everything client c posted since ready() to complete, returns the number of tasks which threw */
+  int execute(int c = 0) {
+    wait([this, c]{ return clients[c].pending == 0; });
+    return clients[c].exceptions;
+  }
 
-    stop_barrier.wait();
-    return exceptions;
+  /* Waits until cond is true, it is rechecked each time a task completes.
+     Several threads may wait at once on a shared pool. */
+  template<class C> void wait(C cond) {
+    if (!spin_until(cond)) {
+      std::unique_lock<std::mutex> lock(done_mutex);
+      ++waiting;
+      while (!cond())
+        done_cond.wait(lock);
+      --waiting;
+    }
   }
 
   void stop() {
-    _stop = true;
-    start_barrier.unblock();
-    stop_barrier.unblock();
-    if (work)
-      delete work;
-    io_service.stop();
-    //    threads.interrupt_all();
+    {
+      std::lock_guard<std::mutex> lock(park_mutex);
+      _stop = true;
+      park_cond.notify_all();
+    }
     threads.join_all();
   }
 
   ~ThreadPool() {
+    for (int c = 0; c < THREADPOOL_MAX_CLIENTS; c++)
+      if (clients[c].queues)
+        delete[] clients[c].queues;
+    delete[] clients;
+    delete[] last_client;
+    delete[] nodes;
   }
 
 protected:
+  struct WorkQueue {
+    WorkQueue() : queued_pinned(0) {}
+
+    SpinLock lock;
+    std::deque<Task> tasks;
+    std::deque<Task> pinned;
+    std::atomic<int> queued_pinned;
+  };
+
+  struct Client {
+    Client() : queues(NULL), attached(false), queued(0), pending(0), next_queue(0), exceptions(0) {}
+
+    WorkQueue *queues;
+    bool attached;
+    std::atomic<int> queued; /* Tasks which any worker may take */
+    std::atomic<int> pending; /* Tasks posted and not yet finished */
+    int next_queue;
+    std::atomic<int> exceptions;
+  };
+
+  void _run(int w) {
+    Task t;
+    while (!_stop) {
+      const int c = take(w, t);
+      if (c < 0) {
+        idle(w);
+        continue;
+      }
+      try {
+        t(w);
+      } catch(...) {
+        ++clients[c].exceptions;
+      }
+      t = nullptr;
+      --clients[c].pending;
+      if (waiting > 0) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done_cond.notify_all();
+      }
+    }
+  }
+
+  /* Spins and then sleeps until there is a task worker w can take */
+  void idle(int w) {
+    if (spin_until([this, w]{ return _stop || has_work(w); }))
+      return;
+    std::unique_lock<std::mutex> lock(park_mutex);
+    ++sleepers;
+    while (!_stop && !has_work(w))
+      park_cond.wait(lock);
+    --sleepers;
+  }
+
+  bool has_work(int w) {
+    const int n = n_clients;
+    for (int c = 0; c < n; c++)
+      if (clients[c].queued > 0 || clients[c].queues[w].queued_pinned > 0)
+        return true;
+    return false;
+  }
+
+  template<class C> bool spin_until(C cond) {
+    if (spin < 0)
+      return cond();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::microseconds(spin);
+    for (int i = 1; !cond(); i++) {
+      if ((i & 0x3F) == 0) {
+        if (std::chrono::steady_clock::now() >= end)
+          return false;
+        std::this_thread::yield();
+      }
+      _mm_pause();
+    }
+    return true;
+  }
+
+  /* Takes a task from the next client after the last one served which has any,
+     returns the client or -1 if there was nothing to take */
+  int take(int w, Task &t) {
+    const int n = n_clients;
+    for (int i = 1; i <= n; i++) {
+      const int c = (last_client[w] + i)%n;
+      if ((clients[c].queued > 0 || clients[c].queues[w].queued_pinned > 0) &&
+          (pop(clients[c], w, t) || steal(clients[c], w, t))) {
+        last_client[w] = c;
+        return c;
+      }
+    }
+    return -1;
+  }
+
+  bool pop(Client &client, int w, Task &t) {
+    WorkQueue &q = client.queues[w];
+    std::lock_guard<SpinLock> lock(q.lock);
+    if (!q.pinned.empty()) {
+      t = q.pinned.front();
+      q.pinned.pop_front();
+      --q.queued_pinned;
+      return true;
+    }
+    if (q.tasks.empty())
+      return false;
+    t = q.tasks.back();
+    q.tasks.pop_back();
+    --client.queued;
+    return true;
+  }
+
+  bool steal(Client &client, int w, Task &t) {
+    for (int i = 1; i < N; i++) {
+      WorkQueue &q = client.queues[(w + i)%N];
+      std::lock_guard<SpinLock> lock(q.lock);
+      if (!q.tasks.empty()) {
+        t = q.tasks.front();
+        q.tasks.pop_front();
+        --client.queued;
+        return true;
+      }
+    }
+    return false;
+  }
+
   int N;
 
-  asio::io_service io_service;
+  Client *clients;
+  std::atomic<int> n_clients;
+  std::mutex clients_mutex;
+  int *last_client;
+  int *nodes;
+
   thread_group threads;
-  Work *work;
+  int spin;
+  std::atomic<bool> _stop;
 
-  barrier start_barrier;
-  barrier stop_barrier;
-  bool _stop;
+  std::atomic<int> sleepers;
+  std::mutex park_mutex;
+  std::condition_variable park_cond;
 
-  std::atomic<int> exceptions;
+  std::atomic<int> waiting;
+  std::mutex done_mutex;
+  std::condition_variable done_cond;
 };
 
 #endif /* __THREAD_POOL_HPP__ */
@@ -33,6 +33,7 @@
 
 #include "../vc2inversetransform_c/vlc_c.hpp"
 #include "../vc2inversetransform_sse4_2/vlc_sse4_2.hpp"
+#include "../vc2inversetransform_avx2/vlc_avx2.hpp"
 
 #include <stdexcept>
 #include <cstdio>
@@ -61,19 +62,82 @@ static int DEBUG_P_SLICE_H;
 #endif
 
 #define MIN(A,B) (((A)<(B))?(A):(B))
+#define MAX(A,B) (((A)>(B))?(A):(B))
+
+/* Minimum number of slices in each unit of work handed to the thread pool */
+#define SLICES_PER_UNIT 16
 
 uint32_t max_to_active_bits(const uint32_t m) {
   return (32 - __builtin_clz(m));
 }
 
+/* Pick a grid of jobs_x x jobs_y jobs as close to n_jobs in number as the
+   picture allows, preferring jobs which are close to square. The picture is
+   units_x x units_y units of unit_width x unit_height samples, and every job
+   must be at least min_x x min_y units so that the overlaps stay within its
+   neighbours. */
+static void choose_job_layout(int n_jobs,
+                              int units_x, int units_y,
+                              int min_x, int min_y,
+                              int unit_width, int unit_height,
+                              int &jobs_x, int &jobs_y) {
+  int max_x = (units_x / min_x > 0) ? units_x / min_x : 1;
+  int max_y = (units_y / min_y > 0) ? units_y / min_y : 1;
+
+  int best_diff = -1;
+  double best_aspect = 0.0;
+
+  jobs_x = 1;
+  jobs_y = 1;
+  for (int y = 1; y <= max_y && y <= n_jobs; y++) {
+    for (int x = 1; x <= max_x && x <= n_jobs; x++) {
+      int diff = (x*y > n_jobs) ? x*y - n_jobs : n_jobs - x*y;
+      double w = (double)units_x*unit_width/x;
+      double h = (double)units_y*unit_height/y;
+      double aspect = (w > h) ? w/h : h/w;
+      if (best_diff < 0 || diff < best_diff || (diff == best_diff && aspect < best_aspect)) {
+        best_diff = diff;
+        best_aspect = aspect;
+        jobs_x = x;
+        jobs_y = y;
+      }
+    }
+  }
+}
+
+/* How many samples away from the edge of a job one level of the inverse transform
+   can carry an error in from beyond the edge. This is the reach of the synthesis
+   lifting steps on the interleaved samples, so Haar, whose pairs never straddle a
+   job boundary, has none. */
+static int wavelet_reach(int wavelet_index) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_DESLAURIERS_DUBUC_9_7:  return 4;
+  case VC2DECODER_WFT_LEGALL_5_3:             return 2;
+  case VC2DECODER_WFT_DESLAURIERS_DUBUC_13_7: return 6;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:          return 0;
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:      return 0;
+  case VC2DECODER_WFT_FIDELITY:               return 14;
+  case VC2DECODER_WFT_DAUBECHIES_9_7:         return 4;
+  default:                                    return 14;
+  }
+}
 
 GetInvVTransform          get_invvtransform = NULL;
 GetInvHTranform           get_invhtransform = NULL;
 GetInvHTransformFinal     get_invhtransformfinal = NULL;
+GetInvVSubbandTransform      get_invvtransform_subbands = NULL;
+GetInvHSubbandTransform      get_invhtransform_subbands = NULL;
+GetInvHSubbandTransformFinal get_invhtransformfinal_subbands = NULL;
+GetInvVSubbandTransform      get_invvtransform_subbands_zero_high = NULL;
+GetInvHSubbandTransform      get_invhtransform_subbands_zero_high = NULL;
+GetInvHSubbandTransformFinal get_invhtransformfinal_subbands_zero_high = NULL;
 
 GetDequantiseFunctionFunc getDequantiseFunction = NULL;
+GetDequantiseFunctionFunc getSubbandDequantiseFunction = NULL;
 
 GetSliceDecoderFunc       get_slice_decoder = NULL;
+GetSliceDecoderFunc       get_wide_slice_decoder = NULL;
+GetFusedSliceDecoderFunc  get_fused_slice_decoder = NULL;
 
 static bool HAS_SSE4_2 = false;
 static bool HAS_AVX = false;
@@ -102,23 +166,65 @@ void detect_cpu_features() {
   get_invvtransform = get_invvtransform_c;
   get_invhtransform = get_invhtransform_c;
   get_invhtransformfinal = get_invhtransformfinal_c;
+  get_invvtransform_subbands = get_invvtransform_subbands_c;
+  get_invhtransform_subbands = get_invhtransform_subbands_c;
+  get_invhtransformfinal_subbands = get_invhtransformfinal_subbands_c;
+  get_invvtransform_subbands_zero_high = get_invvtransform_subbands_zero_high_c;
+  get_invhtransform_subbands_zero_high = get_invhtransform_subbands_zero_high_c;
+  get_invhtransformfinal_subbands_zero_high = get_invhtransformfinal_subbands_zero_high_c;
 
   getDequantiseFunction = getDequantiseFunction_c;
+  getSubbandDequantiseFunction = getSubbandDequantiseFunction_c;
 
   get_slice_decoder = get_slice_decoder_c;
+  get_wide_slice_decoder = get_slice_decoder_c;
 
 #ifndef NO_SSE4_2
   if (HAS_SSE4_2) {
     get_invvtransform = get_invvtransform_sse4_2;
     get_invhtransform = get_invhtransform_sse4_2;
     get_invhtransformfinal = get_invhtransformfinal_sse4_2;
+    get_invvtransform_subbands = get_invvtransform_subbands_sse4_2;
+    get_invhtransform_subbands = get_invhtransform_subbands_sse4_2;
+    get_invhtransformfinal_subbands = get_invhtransformfinal_subbands_sse4_2;
+    get_invvtransform_subbands_zero_high = get_invvtransform_subbands_zero_high_sse4_2;
+    get_invhtransform_subbands_zero_high = get_invhtransform_subbands_zero_high_sse4_2;
+    get_invhtransformfinal_subbands_zero_high = get_invhtransformfinal_subbands_zero_high_sse4_2;
 
     getDequantiseFunction = getDequantiseFunction_sse4_2;
+    getSubbandDequantiseFunction = getSubbandDequantiseFunction_sse4_2;
     get_slice_decoder = get_slice_decoder_sse4_2;
+    get_wide_slice_decoder = get_wide_slice_decoder_sse4_2;
+    get_fused_slice_decoder = get_fused_slice_decoder_sse4_2;
+  }
+#endif
+
+#ifndef NO_AVX2
+  if (HAS_AVX2) {
+    get_slice_decoder = get_slice_decoder_avx2;
+    get_wide_slice_decoder = get_wide_slice_decoder_avx2;
   }
 #endif
 }
 
+static ThreadPool *SHARED_POOL = NULL;
+static std::mutex SHARED_POOL_MUTEX;
+
+bool create_shared_pool(int threads, int numa_first_node, int spin_us) {
+  std::lock_guard<std::mutex> lock(SHARED_POOL_MUTEX);
+  if (SHARED_POOL != NULL || threads < 1)
+    return false;
+
+  writelog(LOG_INFO, "Creating shared pool of %d threads", threads);
+  SHARED_POOL = new ThreadPool(threads, numa_first_node, (spin_us != 0) ? spin_us : THREADPOOL_DEFAULT_SPIN_US);
+  return true;
+}
+
+ThreadPool *shared_pool() {
+  std::lock_guard<std::mutex> lock(SHARED_POOL_MUTEX);
+  return SHARED_POOL;
+}
+
 #ifdef DEBUG_P_BLOCK
 void __debug_print_slice(JobData *job, int sample_size) {
   if (sample_size == 2) {
@@ -227,7 +333,7 @@ char *VC2Decoder::FindNextParseInfo(char *_idata, int ilength) {
   return idata + offset;
 }
 
-VC2DecoderSequenceResult VC2Decoder::sequenceDecodeOnePicture(char **_idata, int ilength, uint16_t **odata, int *ostride, bool skip_aux) {
+VC2DecoderSequenceResult VC2Decoder::sequenceDecodeOnePicture(char **_idata, int ilength, uint16_t **odata, int *ostride, bool skip_aux, bool wait) {
   VC2DecoderParseSegment pi;
   char *idata = *_idata;
   char *iend = *_idata + ilength;
@@ -267,7 +373,7 @@ VC2DecoderSequenceResult VC2Decoder::sequenceDecodeOnePicture(char **_idata, int
 
       case VC2DECODER_PARSE_CODE_HQ_PICTURE:
         {
-          uint64_t length = decodeFrame(pi.data, iend - pi.data, odata, ostride);
+          uint64_t length = decodeFrame(pi.data, iend - pi.data, odata, ostride, wait);
           if (pi.next_header != NULL) {
             *_idata = pi.next_header;
           }
@@ -279,7 +385,7 @@ VC2DecoderSequenceResult VC2Decoder::sequenceDecodeOnePicture(char **_idata, int
 
       case VC2DECODER_PARSE_CODE_HQ_FRAGMENT:
         {
-          bool full_pic = handleFragment(pi.data, iend - pi.data, odata, ostride);
+          bool full_pic = handleFragment(pi.data, iend - pi.data, odata, ostride, wait);
           if (pi.next_header != NULL) {
             *_idata = pi.next_header;
           }
@@ -477,6 +583,15 @@ bool VC2Decoder::parseSeqHeader(char *_idata, const char *_iend) {
 void VC2Decoder::setUserParams(VC2DecoderParamsUser &params) {
   mParams.threads = params.threads;
   mParams.numa_first_node = params.numa_first_node;
+  mParams.thread_spin_us = params.thread_spin_us;
+  mParams.pipeline_depth = params.pipeline_depth;
+  mParams.picture_threads = params.picture_threads;
+  mParams.use_shared_pool = params.use_shared_pool;
+  mParams.numa_split_picture = params.numa_split_picture;
+  mParams.global_transform = params.global_transform;
+  mParams.sticky_jobs = params.sticky_jobs;
+  mParams.fused_dequantise = params.fused_dequantise;
+  mParams.subband_layout = params.subband_layout;
 
   mParams.colourise = params.colourise_quantiser || params.colourise_padding || params.colourise_unpadded;
   mParams.colourise_quantiser = params.colourise_quantiser;
@@ -622,6 +737,8 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
   ASSERTPARAM(params.slice_prefix_bytes >= 0, "Slice Prefix is negative");
   ASSERTPARAM(params.slice_size_scalar >= 0, "Slice Size Scaler is negative");
   ASSERTPARAM(params.threads >= 0, "Number of threads is negative");
+  ASSERTPARAM(params.pipeline_depth >= 0, "Pipeline depth is negative");
+  ASSERTPARAM(params.picture_threads >= 0, "Number of threads per picture is negative");
 
   ASSERTPARAM(params.video_format.base_video_format >= VC2DECODER_BVF_CUSTOM && params.video_format.base_video_format <= VC2DECODER_BVF_SDPRO486, "Unknown base video format: %d", params.video_format.base_video_format);
   ASSERTPARAM(params.video_format.base_video_format >= VC2DECODER_BVF_CUSTOM && params.video_format.base_video_format <= VC2DECODER_BVF_SDPRO486, "Unknown base video format: %d", params.video_format.base_video_format);
@@ -644,6 +761,7 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
   ASSERTPARAM(params.transform_params.wavelet_index >= VC2DECODER_WFT_DESLAURIERS_DUBUC_9_7 && params.transform_params.wavelet_index <= VC2DECODER_WFT_DAUBECHIES_9_7,
               "Invalid wavelet kernel specified");
   ASSERTPARAM(params.transform_params.wavelet_depth >= 1, "Wavelet Depth must be at least 1");
+  ASSERTPARAM(params.transform_params.wavelet_depth <= MAX_DWT_DEPTH, "Wavelet Depth must be at most %d", MAX_DWT_DEPTH);
   ASSERTPARAM(params.transform_params.slices_x > 0 && params.transform_params.slices_y > 0, "Must have at least one slice");
   } catch(VC2DecoderResult &r) {
     writelog(LOG_ERROR, "Error: %d", (int)r);
@@ -661,32 +779,103 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
   mSlicesY = params.transform_params.slices_y;
 
 
-  if (mJobs) {
-    for (int i = 0; i < mJobsX*mJobsY; i++) {
-      delete mJobs[i];
-    }
-    delete[] mJobs;
+  if (mPictures) {
+    WaitAllPictures();
+    for (int i = 0; i < mNumPictures; i++)
+      delete mPictures[i];
+    delete[] mPictures;
+    mPictures = NULL;
+    mJobs = NULL;
+  }
+
+  if (mJobWorker) {
+    delete[] mJobWorker;
+    mJobWorker = NULL;
+  }
+
+  if (mJobNode) {
+    delete[] mJobNode;
+    mJobNode = NULL;
   }
 
   if (mSliceJobLUTX) {
     delete[] mSliceJobLUTX;
+    mSliceJobLUTX = NULL;
   }
 
   if (mSliceJobLUTY) {
     delete[] mSliceJobLUTY;
+    mSliceJobLUTY = NULL;
+  }
+
+  if (params.use_shared_pool && shared_pool() == NULL) {
+    writelog(LOG_ERROR, "%s:%d:  Shared pool requested but vc2decode_init_shared_pool has not been called", __FILE__, __LINE__);
+    throw VC2DECODER_BADPARAMS;
   }
 
 #ifndef DEBUG_ONE_JOB
   int n_threads = params.threads;
-  int n_jobs = 1;
-  for (n_jobs = 1; n_jobs < 4 * n_threads; n_jobs <<= 1);
+  if (params.use_shared_pool && n_threads == 0)
+    n_threads = shared_pool()->size();
+  int n_jobs = (n_threads > 0) ? 4*n_threads : 1;
+
+  /* When pictures are decoded in parallel each one is only split over its own share of the threads */
+  mPictureThreads = n_threads;
+  if (params.picture_threads > 0 && params.picture_threads < n_threads) {
+    mPictureThreads = params.picture_threads;
+    n_jobs = (mPictureThreads > 1) ? 4*mPictureThreads : 1;
+  }
+
+  /* A global transform decodes each picture as a single job with no overlaps, which its threads then share */
+  mGlobalTransform = params.global_transform && !params.colourise && mPictureThreads > 1;
+  if (mGlobalTransform)
+    n_jobs = 1;
 #else
   int n_threads = 1;
   int n_jobs = 1;
+  mPictureThreads = 1;
 #endif
 
-  mJobs = new JobData*[n_jobs];
-  writelog(LOG_INFO, "Configuring for %d threads, %d jobs", n_threads, n_jobs);
+  if (mPool) {
+    if (mSharedPool) {
+      mPool->detach(mPoolClient);
+    } else {
+      mPool->stop();
+      delete mPool;
+    }
+    mPool = NULL;
+  }
+
+  mSharedPool = params.use_shared_pool;
+  if (mSharedPool) {
+    ThreadPool *pool = shared_pool();
+    mPoolClient = pool->attach();
+    if (mPoolClient < 0) {
+      writelog(LOG_ERROR, "%s:%d:  Too many decoders are using the shared pool", __FILE__, __LINE__);
+      throw VC2DECODER_BADTHREAD;
+    }
+    mPool = pool;
+    mThreads = mPool->size();
+  } else {
+    mPoolClient = 0;
+    mThreads = n_threads;
+    if (mThreads > 1)
+      mPool = new ThreadPool(mThreads, params.numa_first_node,
+                             (params.thread_spin_us != 0) ? params.thread_spin_us : THREADPOOL_DEFAULT_SPIN_US);
+  }
+
+  /* The NUMA nodes the workers run on, in order of first appearance */
+  int n_nodes = 0;
+  int node_ids[MAX_NUMA_NODES];
+  for (int w = 0; mPool && w < mThreads; w++) {
+    int k = 0;
+    while (k < n_nodes && node_ids[k] != mPool->node(w))
+      k++;
+    if (k == n_nodes && n_nodes < MAX_NUMA_NODES)
+      node_ids[n_nodes++] = mPool->node(w);
+  }
+  mNumaSplit = params.numa_split_picture && n_nodes > 1 && !mGlobalTransform;
+  mNumNodes = mNumaSplit ? n_nodes : 1;
 
   mWidth = mVideoFormat.frame_width;
   mHeight = mVideoFormat.frame_height;
@@ -704,6 +893,21 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
   int slice_width = (padded_width / params.transform_params.slices_x);
   int slice_height = (padded_height / params.transform_params.slices_y);
 
+  /* Pictures are only held a subband at a time where there are transforms for it, and where every slice of
+     every component covers a whole number of samples of the lowest level */
+  mSubbandLayout = false;
+  if (params.subband_layout) {
+    const int unit = 1 << params.transform_params.wavelet_depth;
+    if (get_invvtransform_subbands(params.transform_params.wavelet_index, sample_size) == NULL)
+      writelog(LOG_INFO, "The subband layout is not supported for this wavelet, so is not used");
+    else if (slice_width%(2*unit) != 0 || slice_height%unit != 0)
+      writelog(LOG_INFO, "The slices are too small for the subband layout, so it is not used");
+    else if (params.fused_dequantise && get_fused_slice_decoder)
+      writelog(LOG_INFO, "The subband layout is not used with fused dequantisation");
+    else
+      mSubbandLayout = true;
+  }
+
   {
 #ifdef DEBUG_P_BLOCK
     DEBUG_P_JOB = 0;
@@ -711,41 +915,8 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
     DEBUG_P_SLICE_X = DEBUG_P_BLOCK_X;
 #endif
 
-    switch (n_jobs) {
-    case 1:
-      mJobsX = 1;
-      mJobsY = 1;
-      break;
-    case 2:
-      mJobsX = 2;
-      mJobsY = 1;
-      break;
-    case 4:
-      mJobsX = 2;
-      mJobsY = 2;
-      break;
-    case 8:
-      mJobsX = 4;
-      mJobsY = 2;
-      break;
-    case 16:
-      mJobsX = 4;
-      mJobsY = 4;
-      break;
-    case 32:
-      mJobsX = 8;
-      mJobsY = 4;
-      break;
-    case 64:
-      mJobsX = 8;
-      mJobsY = 8;
-      break;
-    default:
-      writelog(LOG_ERROR, "%s:%d:  Invalid number of jobs, only 1, 2, 4, 8, 16, 32, and 64 are currently supported\n", __FILE__, __LINE__);
-      throw VC2DECODER_NOTIMPLEMENTED;
-    }
-    mSliceJobLUTX = new uint8_t[mSlicesX];
-    mSliceJobLUTY = new uint8_t[mSlicesY];
+    mSliceJobLUTX = new uint16_t[mSlicesX];
+    mSliceJobLUTY = new uint16_t[mSlicesY];
 
     int slice_skip_x = 0;
     int slice_skip_y = 0;
@@ -770,47 +941,129 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
     }
 
 
-    int spj_x = (slices_in_output_x + mJobsX - 1) / mJobsX;
-    int spj_y = (slices_in_output_y + mJobsY - 1) / mJobsY;
-
-    mOverlapX = 32 / slice_width;
+    /* The final transforms write out 16 samples at a time, so jobs are split horizontally
+       only on multiples of 32 luma samples to keep them from writing over each other. The
+       transforms also need every job to be a whole number of 1 << depth samples in height */
+    int align_x = 1;
+    while ((align_x*slice_width)%32 != 0)
+      align_x++;
+    int align_y = 1;
+    while ((align_y*slice_height)%(1 << params.transform_params.wavelet_depth) != 0)
+      align_y++;
+
+    /* Each level of the transform spreads errors from a job's edges a further reach samples
+       at its own resolution, so after depth levels they reach reach*(2^depth - 1) samples in.
+       The overlaps are the fewest whole alignment units which cover that, and are twice as
+       wide as they are high because the colour difference components are half width */
+    const int halo = wavelet_reach(params.transform_params.wavelet_index)*((1 << params.transform_params.wavelet_depth) - 1);
+    mOverlapX = (((2*halo + slice_width - 1)/slice_width + align_x - 1)/align_x)*align_x;
+    mOverlapY = (((halo + slice_height - 1)/slice_height + align_y - 1)/align_y)*align_y;
+
+    int units_x = slices_in_output_x / align_x;
+    int units_y = slices_in_output_y / align_y;
+
+    choose_job_layout(n_jobs,
+                      units_x, units_y,
+                      (mOverlapX > 0) ? 2*mOverlapX/align_x : 1,
+                      (mOverlapY > 0) ? 2*mOverlapY/align_y : 1,
+                      align_x*slice_width, align_y*slice_height,
+                      mJobsX, mJobsY);
+
+    mNumPictures = (params.pipeline_depth > 1) ? params.pipeline_depth : 1;
+    mPictures = new PictureData*[mNumPictures];
+    for (int p = 0; p < mNumPictures; p++)
+      mPictures[p] = new PictureData(mJobsX*mJobsY);
+    mPictureHead = 0;
+    mPicturesInFlight = 0;
+    mJobs = mPictures[0]->jobs;
+    writelog(LOG_INFO, "Configuring for %d threads (%d per picture), %d jobs (%d x %d), %d pictures in flight", n_threads, mPictureThreads, mJobsX*mJobsY, mJobsX, mJobsY, mNumPictures);
+    if (mNumaSplit)
+      writelog(LOG_INFO, "Splitting each picture between %d NUMA nodes", mNumNodes);
+    if (mGlobalTransform)
+      writelog(LOG_INFO, "Sharing each transform level between %d threads", mPictureThreads);
+
+    /* Transform strips must start on whole SIMD vectors and on whole samples of the lowest level */
+    mStripAlign = 32;
+    while (mStripAlign < (1 << params.transform_params.wavelet_depth))
+      mStripAlign *= 2;
+
+    /* Choose the worker each job is posted to, so that its memory can be allocated on that worker's node */
+    mJobWorker = new int[mNumPictures*mJobsX*mJobsY];
+    mJobNode = new int[mJobsX*mJobsY];
+    for (int n = 0; n < mJobsX*mJobsY; n++) {
+      /* When splitting across nodes each node takes a band of job rows */
+      mJobNode[n] = (n/mJobsX)*mNumNodes/mJobsY;
+      for (int p = 0; p < mNumPictures; p++)
+        mJobWorker[p*mJobsX*mJobsY + n] = 0;
+    }
+    for (int p = 0; mPool && p < mNumPictures; p++) {
+      const int groups = (mThreads > mPictureThreads) ? mThreads/mPictureThreads : 1;
+      for (int n = 0; n < mJobsX*mJobsY; n++) {
+        int w = ((p%groups)*mPictureThreads + n%mPictureThreads)%mThreads;
+        if (mNumaSplit) {
+          const int k = mJobNode[n];
+          const int first_job = ((k*mJobsY + mNumNodes - 1)/mNumNodes)*mJobsX;
+          int node_workers = 0;
+          for (int i = 0; i < mThreads; i++)
+            if (mPool->node(i) == node_ids[k])
+              node_workers++;
+          int i = (n - first_job)%node_workers;
+          for (w = 0; mPool->node(w) != node_ids[k] || i > 0; w++)
+            if (mPool->node(w) == node_ids[k])
+              i--;
+        }
+        mJobWorker[p*mJobsX*mJobsY + n] = w;
+      }
+    }
+    for (int k = 0; k < mNumNodes; k++) {
+      mNodeWorker[k] = 0;
+      for (int n = mJobsX*mJobsY - 1; n >= 0; n--)
+        if (mJobNode[n] == k)
+          mNodeWorker[k] = mJobWorker[n];
+    }
 
     for (int y = 0; y < mJobsY; y++) {
-      int s_y = (y < mJobsY - 1) ? spj_y : slices_in_output_y - y*spj_y;
-      int pad_yz = ((y < mJobsY - 1) ? 1 : 0);
-      int pad_ya = ((y > 0) ? 1 : 0);
+      int start_y = (y*units_y/mJobsY)*align_y;
+      int s_y = ((y < mJobsY - 1) ? ((y + 1)*units_y/mJobsY)*align_y : slices_in_output_y) - start_y;
+      int pad_yz = ((y < mJobsY - 1) ? mOverlapY : 0);
+      int pad_ya = ((y > 0) ? mOverlapY : 0);
 
-      int PADY_PRE = ((y > 0) ? (slice_height) : (pixel_margin_pre_y));
+      int PADY_PRE = ((y > 0) ? (mOverlapY*slice_height) : (pixel_margin_pre_y));
       int PADY_POST = ((y < mJobsY - 1) ? 0 : pixel_margin_post_y + pixel_margin_pre_y);
       for (int x = 0; x < mJobsX; x++) {
-        int s_x = (x < mJobsX - 1) ? spj_x : slices_in_output_x - x*spj_x;
+        int start_x = (x*units_x/mJobsX)*align_x;
+        int s_x = ((x < mJobsX - 1) ? ((x + 1)*units_x/mJobsX)*align_x : slices_in_output_x) - start_x;
         int pad_xz = ((x < mJobsX - 1) ? mOverlapX : 0);
         int pad_xa = ((x > 0) ? mOverlapX : 0);
 
         int PADX_PRE = ((x > 0) ? (mOverlapX*slice_width) : (pixel_margin_pre_x));
         int PADX_POST = ((x < mJobsX - 1) ? 0 : pixel_margin_post_x + pixel_margin_pre_x);
-        int tgt_x = (x*spj_x)*slice_width;
-        int tgt_y = (y*spj_y)*slice_height;
+        int tgt_x = start_x*slice_width;
+        int tgt_y = start_y*slice_height;
         int output_w = MIN(s_x*slice_width - PADX_POST, mWidth - tgt_x);
         int output_h = MIN(s_y*slice_height - PADY_POST, mHeight - tgt_y);
-        mJobs[y*mJobsX + x] = new JobData(y*mJobsX + x,
-          (pad_xa + s_x + pad_xz)*slice_width,
-          (pad_ya + s_y + pad_yz)*slice_height,
-          mVideoFormat.frame_height,
-          (pad_xa + s_x + pad_xz), (pad_ya + s_y + pad_yz),
-          PADX_PRE,
-          PADY_PRE,
-          output_w, output_h,
-          tgt_x, tgt_y,
-          x*spj_x - pad_xa, y*spj_y - pad_ya,
-          sample_size);
+        for (int p = 0; p < mNumPictures; p++)
+          mPictures[p]->jobs[y*mJobsX + x] = new JobData(y*mJobsX + x,
+            (pad_xa + s_x + pad_xz)*slice_width,
+            (pad_ya + s_y + pad_yz)*slice_height,
+            mVideoFormat.frame_height,
+            (pad_xa + s_x + pad_xz), (pad_ya + s_y + pad_yz),
+            PADX_PRE,
+            PADY_PRE,
+            output_w, output_h,
+            tgt_x, tgt_y,
+            start_x - pad_xa, start_y - pad_ya,
+            sample_size,
+            mJobWorker[p*mJobsX*mJobsY + y*mJobsX + x],
+            mPool ? mPool->node(mJobWorker[p*mJobsX*mJobsY + y*mJobsX + x]) : -1,
+            mSubbandLayout ? params.transform_params.wavelet_depth : 0);
 
 #ifdef DEBUG_P_BLOCK
-        if (DEBUG_P_BLOCK_Y >= spj_y*y && DEBUG_P_BLOCK_Y < spj_y*y + s_y &&
-          DEBUG_P_BLOCK_X >= spj_x*x && DEBUG_P_BLOCK_X < spj_x*x + s_x) {
+        if (DEBUG_P_BLOCK_Y >= start_y && DEBUG_P_BLOCK_Y < start_y + s_y &&
+          DEBUG_P_BLOCK_X >= start_x && DEBUG_P_BLOCK_X < start_x + s_x) {
           DEBUG_P_JOB = y*mJobsX + x;
-          DEBUG_P_SLICE_Y = DEBUG_P_BLOCK_Y - spj_y*y + pad_ya;
-          DEBUG_P_SLICE_X = DEBUG_P_BLOCK_X - spj_x*x + pad_xa;
+          DEBUG_P_SLICE_Y = DEBUG_P_BLOCK_Y - start_y + pad_ya;
+          DEBUG_P_SLICE_X = DEBUG_P_BLOCK_X - start_x + pad_xa;
         }
 #endif
       }
@@ -819,84 +1072,104 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
     {
       int Y = 0;
       for (int y = 0; y < slice_skip_y; y++) {
-        mSliceJobLUTY[Y++] = 0x00;
+        mSliceJobLUTY[Y++] = 0;
       }
       if (mJobsY == 1) {
         for (int y = 0; y < mJobs[0]->slices_y; y++) {
-          mSliceJobLUTY[Y++] = 0x80;
+          mSliceJobLUTY[Y++] = JOBLUT_ACTIVE;
         }
       }
       else {
-        for (int y = 0; y < mJobs[0]->slices_y - 2; y++) {
-          mSliceJobLUTY[Y++] = 0x80;
+        for (int y = 0; y < mJobs[0]->slices_y - 2 * mOverlapY; y++) {
+          mSliceJobLUTY[Y++] = JOBLUT_ACTIVE;
+        }
+        for (int y = 0; y < 2 * mOverlapY; y++) {
+          mSliceJobLUTY[Y++] = JOBLUT_OVERLAP;
         }
-        mSliceJobLUTY[Y++] = 0xC0;
-        mSliceJobLUTY[Y++] = 0xC0;
         for (int jy = 1; jy < mJobsY - 1; jy++) {
-          for (int y = 2; y < mJobs[jy*mJobsX]->slices_y - 2; y++) {
-            mSliceJobLUTY[Y++] = 0x80 | (jy & 0x3F);
+          for (int y = 2 * mOverlapY; y < mJobs[jy*mJobsX]->slices_y - 2 * mOverlapY; y++) {
+            mSliceJobLUTY[Y++] = JOBLUT_ACTIVE | jy;
+          }
+          for (int y = 0; y < 2 * mOverlapY; y++) {
+            mSliceJobLUTY[Y++] = JOBLUT_OVERLAP | jy;
           }
-          mSliceJobLUTY[Y++] = 0xC0 | (jy & 0x3F);
-          mSliceJobLUTY[Y++] = 0xC0 | (jy & 0x3F);
         }
-        for (int y = 2; y < mJobs[(mJobsY - 1)*mJobsX]->slices_y; y++) {
-          mSliceJobLUTY[Y++] = 0x80 | ((mJobsY - 1) & 0x3F);
+        for (int y = 2 * mOverlapY; y < mJobs[(mJobsY - 1)*mJobsX]->slices_y; y++) {
+          mSliceJobLUTY[Y++] = JOBLUT_ACTIVE | (mJobsY - 1);
         }
       }
       while (Y < mSlicesY) {
-        mSliceJobLUTY[Y++] = 0x00;
+        mSliceJobLUTY[Y++] = 0;
       }
     }
 
     {
       int X = 0;
       for (int x = 0; x < slice_skip_x; x++) {
-        mSliceJobLUTX[X++] = 0x00;
+        mSliceJobLUTX[X++] = 0;
       }
       if (mJobsX == 1) {
         for (int x = 0; x < mJobs[0]->slices_x; x++) {
-          mSliceJobLUTX[X++] = 0x80;
+          mSliceJobLUTX[X++] = JOBLUT_ACTIVE;
         }
       }
       else {
         for (int x = 0; x < mJobs[0]->slices_x - 2 * mOverlapX; x++) {
-          mSliceJobLUTX[X++] = 0x80;
+          mSliceJobLUTX[X++] = JOBLUT_ACTIVE;
         }
         for (int x = 0; x < 2 * mOverlapX; x++) {
-          mSliceJobLUTX[X++] = 0xC0;
+          mSliceJobLUTX[X++] = JOBLUT_OVERLAP;
         }
         for (int jx = 1; jx < mJobsX - 1; jx++) {
           for (int x = 2 * mOverlapX; x < mJobs[jx]->slices_x - 2 * mOverlapX; x++) {
-            mSliceJobLUTX[X++] = 0x80 | (jx & 0x3F);
+            mSliceJobLUTX[X++] = JOBLUT_ACTIVE | jx;
           }
           for (int x = 0; x < 2 * mOverlapX; x++) {
-            mSliceJobLUTX[X++] = 0xC0 | (jx & 0x3F);
+            mSliceJobLUTX[X++] = JOBLUT_OVERLAP | jx;
           }
         }
         for (int x = 2 * mOverlapX; x < mJobs[(mJobsX - 1)]->slices_x; x++) {
-          mSliceJobLUTX[X++] = 0x80 | ((mJobsX - 1) & 0x3F);
+          mSliceJobLUTX[X++] = JOBLUT_ACTIVE | (mJobsX - 1);
         }
       }
       while (X < mSlicesX) {
-        mSliceJobLUTX[X++] = 0x00;
+        mSliceJobLUTX[X++] = 0;
       }
     }
   }
 
+  /* The new matrices are taken before the old ones are released so that an unchanged matrix stays cached */
+  QuantisationMatrix *matrices = get_quantisation_matrices(params.transform_params, 256);
   if (mMatrices)
-    delete_matrices(mMatrices);
+    release_quantisation_matrices(mMatrices);
+  mMatrices = matrices;
 
-  mMatrices = quantisation_matrices(params.transform_params.wavelet_index, params.transform_params.wavelet_depth, 256);
+  if (mScratch) {
+    for (int i = 0; i < 3*VLC_SCRATCH_SLICES*mNumScratch; i++)
+      delete mScratch[i];
+    delete[] mScratch;
+  }
 
-  if (mPool) {
-    mPool->stop();
-    delete mPool;
-    mPool = NULL;
+  mNumScratch = (mThreads > 1) ? mThreads : 1;
+  mScratch = new DecodedSlice*[3*VLC_SCRATCH_SLICES*mNumScratch];
+  for (int i = 0; i < VLC_SCRATCH_SLICES*mNumScratch; i++) {
+    const int node = mPool ? mPool->node(i/VLC_SCRATCH_SLICES) : -1;
+    mScratch[3*i + 0] = new DecodedSlice(slice_width*slice_height, node);
+    mScratch[3*i + 1] = new DecodedSlice(slice_width/2*slice_height, node);
+    mScratch[3*i + 2] = new DecodedSlice(slice_width/2*slice_height, node);
   }
 
-  mThreads = n_threads;
-  if (mThreads > 1)
-    mPool = new ThreadPool(mThreads, params.numa_first_node);
+  /* Have each worker touch its own jobs and scratch space first, so that they start out in its cache */
+  mStickyJobs = params.sticky_jobs && mPool != NULL;
+  if (mStickyJobs) {
+    std::atomic<int> remaining(mNumPictures*mJobsX*mJobsY + mThreads);
+    for (int p = 0; p < mNumPictures; p++)
+      for (int n = 0; n < mJobsX*mJobsY; n++)
+        Post(mPictures[p]->jobs[n]->worker, std::bind(&VC2Decoder::FirstTouch, this, mPictures[p]->jobs[n], 0, &remaining, std::placeholders::_1));
+    for (int w = 0; w < mThreads; w++)
+      Post(w, std::bind(&VC2Decoder::FirstTouch, this, (JobData *)NULL, w, &remaining, std::placeholders::_1));
+    mPool->wait([&remaining]{ return remaining == 0; });
+  }
 
   mParams = params;
 
@@ -923,11 +1196,56 @@ void VC2Decoder::setParams(VC2DecoderParamsInternal &params) {
   for (int l = 0; l < (int)params.transform_params.wavelet_depth; l++)
     transforms_v[l] = get_invvtransform(params.transform_params.wavelet_index, l, params.transform_params.wavelet_depth, sample_size);
 
-  mDequant[0] = getDequantiseFunction(slice_width, slice_height, mParams.transform_params.wavelet_depth, sample_size);
-  mDequant[1] = getDequantiseFunction(slice_width / 2, slice_height, mParams.transform_params.wavelet_depth, sample_size);
-  mDequant[2] = getDequantiseFunction(slice_width / 2, slice_height, mParams.transform_params.wavelet_depth, sample_size);
+  GetDequantiseFunctionFunc get_dequant = mSubbandLayout ? getSubbandDequantiseFunction : getDequantiseFunction;
+  mDequant[0] = get_dequant(slice_width, slice_height, mParams.transform_params.wavelet_depth, sample_size);
+  mDequant[1] = get_dequant(slice_width / 2, slice_height, mParams.transform_params.wavelet_depth, sample_size);
+  mDequant[2] = get_dequant(slice_width / 2, slice_height, mParams.transform_params.wavelet_depth, sample_size);
+
+  for (int c = 0; c < 3; c++) {
+    delete[] mBandsCoded[c];
+    mBandsCoded[c] = NULL;
+    mBandsCodedMax[c] = 0;
+  }
+  if (mSubbandLayout) {
+    transforms_v_subbands = get_invvtransform_subbands(params.transform_params.wavelet_index, sample_size);
+    transforms_h_subbands = get_invhtransform_subbands(params.transform_params.wavelet_index, sample_size);
+    transforms_final_subbands = get_invhtransformfinal_subbands(params.transform_params.wavelet_index, active_bits, sample_size);
+    transforms_v_subbands_zero_high = get_invvtransform_subbands_zero_high(params.transform_params.wavelet_index, sample_size);
+    transforms_h_subbands_zero_high = get_invhtransform_subbands_zero_high(params.transform_params.wavelet_index, sample_size);
+    transforms_final_subbands_zero_high = get_invhtransformfinal_subbands_zero_high(params.transform_params.wavelet_index, active_bits, sample_size);
+
+    const int depth = mParams.transform_params.wavelet_depth;
+    for (int c = 0; c < 3; c++) {
+      const int w = (c == 0) ? slice_width : slice_width/2;
+      int start[3*MAX_DWT_DEPTH + 1];
+      start[0] = 0;
+      for (int b = 1; b < 3*depth + 1; b++) {
+        const int shift = (b == 1) ? depth : depth - (b + 1)/3 + 1;
+        start[b] = start[b - 1] + (w >> shift)*(slice_height >> shift);
+      }
+      mBandsCodedMax[c] = start[3*depth]/8 + 1;
+      mBandsCoded[c] = new uint8_t[mBandsCodedMax[c] + 1];
+      for (int n = 0; n <= mBandsCodedMax[c]; n++) {
+        int b = 0;
+        while (b < 3*depth + 1 && start[b] < 8*n)
+          b++;
+        mBandsCoded[c][n] = b;
+      }
+    }
+  }
 
   mSliceDecoder = get_slice_decoder(sample_size);
+  mWideSliceDecoder = get_wide_slice_decoder(sample_size);
+  mFusedSliceDecoder = (params.fused_dequantise && get_fused_slice_decoder) ? get_fused_slice_decoder(sample_size) : NULL;
+  for (int c = 0; c < 3; c++) {
+    delete mFusedPlacement[c];
+    mFusedPlacement[c] = NULL;
+    if (mFusedSliceDecoder)
+      mFusedPlacement[c] = new FusedPlacement((c == 0) ? slice_width : slice_width/2, slice_height, mParams.transform_params.wavelet_depth);
+  }
+  mWideVLCBytes = (uint64_t)mSlicesX*mSlicesY*2*slice_width*slice_height*WIDE_VLC_MIN_BITS/8;
+  mFusedVLCBytes = (uint64_t)mSlicesX*mSlicesY*2*slice_width*slice_height*FUSED_VLC_MAX_BITS/8;
+  wide_vlc_lut();
 
   mSampleSize = sample_size;
 
@@ -948,6 +1266,10 @@ int VC2Decoder::processTransformParams(uint8_t *_idata, int ilength)  throw (VC2
     VC2DecoderTransformParams transform_params;
     transform_params.wavelet_index = read_uint(idata, bits, iend);
     transform_params.wavelet_depth = read_uint(idata, bits, iend);
+    if (transform_params.wavelet_depth > MAX_DWT_DEPTH) {
+      writelog(LOG_ERROR, "%s:%d: Wavelet depth %d is greater than the maximum of %d", __FILE__, __LINE__, transform_params.wavelet_depth, MAX_DWT_DEPTH);
+      throw VC2DECODER_BADSTREAM;
+    }
     if (mMajorVersion >= 3) {
       transform_params.asym_transform_index_flag = read_bool(idata, bits, iend);
       if (transform_params.asym_transform_index_flag) {
@@ -970,7 +1292,7 @@ int VC2Decoder::processTransformParams(uint8_t *_idata, int ilength)  throw (VC2
     transform_params.custom_quant_matrix_flag = read_bool(idata, bits, iend);
     if (transform_params.custom_quant_matrix_flag) {
       transform_params.quant_matrix_LL = read_uint(idata, bits, iend);
-      for (int l = 0; l < (int)transform_params.wavelet_depth - 1; l++) {
+      for (int l = 0; l < (int)transform_params.wavelet_depth; l++) {
         transform_params.quant_matrix_HL[l] = read_uint(idata, bits, iend);
         transform_params.quant_matrix_LH[l] = read_uint(idata, bits, iend);
         transform_params.quant_matrix_HH[l] = read_uint(idata, bits, iend);
@@ -1023,7 +1345,7 @@ int VC2Decoder::processTransformParams(uint8_t *_idata, int ilength)  throw (VC2
   return idata - _idata;
 }
 
-uint64_t VC2Decoder::decodeFrame(char *_idata, int ilength, uint16_t **odata, int *ostride) {
+uint64_t VC2Decoder::decodeFrame(char *_idata, int ilength, uint16_t **odata, int *ostride, bool wait) {
   uint8_t *idata = (uint8_t *)_idata;
 
   // Start by parsing picture header and transform parameters
@@ -1044,28 +1366,17 @@ uint64_t VC2Decoder::decodeFrame(char *_idata, int ilength, uint16_t **odata, in
   int preamble = idata - (uint8_t*)_idata;
 
   // Now decode the frame
+  BeginPicture(wait);
   uint64_t length = SliceInput((char *)idata, ilength - preamble, mJobs);
+  mPictureBytes = length;
 
-#ifndef DEBUG
-  if (mThreads > 1) {
-    mPool->ready();
-    for (int n = 0; n < mJobsX*mJobsY; n++)
-      mPool->post(std::bind(&VC2Decoder::Decode, this, mJobs[n], odata, ostride));
-    if (mPool->execute())
-      throw VC2DECODER_DECODE_FAILED;
-  }
-  else
-#endif /*DEBUG*/
-  {
-    for (int n = 0; n < mJobsX*mJobsY; n++)
-      Decode(mJobs[n], odata, ostride);
-  }
+  DecodeJobs(odata, ostride, wait);
   mSequenceInfo.pictures_decoded++;
 
   return length;
 }
 
-bool VC2Decoder::handleFragment(char *_idata, int ilength, uint16_t **odata, int *ostride) {
+bool VC2Decoder::handleFragment(char *_idata, int ilength, uint16_t **odata, int *ostride, bool wait) {
   uint8_t *idata = (uint8_t *)_idata;
 
   // Start by parsing picture header and fragment header
@@ -1084,7 +1395,9 @@ bool VC2Decoder::handleFragment(char *_idata, int ilength, uint16_t **odata, int
 
     idata += processTransformParams(idata, fragment_data_length);
 
+    BeginPicture(wait);
     mSlicesSlicedFromFragments = 0;
+    mPictureBytes = 0;
 
     return false;
   } else {
@@ -1092,24 +1405,11 @@ bool VC2Decoder::handleFragment(char *_idata, int ilength, uint16_t **odata, int
                                   (idata[9] << 0));
     uint32_t fragment_y_offset = ((idata[10] << 8) |
                                   (idata[11] << 0));
-    SliceInputFragment((char *)(idata + 12), ilength - 12, fragment_slice_count, fragment_x_offset, fragment_y_offset, mJobs);
+    mPictureBytes += SliceInputFragment((char *)(idata + 12), ilength - 12, fragment_slice_count, fragment_x_offset, fragment_y_offset, mJobs);
     mSlicesSlicedFromFragments += fragment_slice_count;
 
     if (mSlicesSlicedFromFragments >= mSlicesX*mSlicesY) {
-#ifndef DEBUG
-      if (mThreads > 1) {
-        mPool->ready();
-        for (int n = 0; n < mJobsX*mJobsY; n++)
-          mPool->post(std::bind(&VC2Decoder::Decode, this, mJobs[n], odata, ostride));
-        if (mPool->execute())
-          throw VC2DECODER_DECODE_FAILED;
-      }
-      else
-#endif /*DEBUG*/
-        {
-          for (int n = 0; n < mJobsX*mJobsY; n++)
-            Decode(mJobs[n], odata, ostride);
-        }
+      DecodeJobs(odata, ostride, wait);
       mSequenceInfo.pictures_decoded++;
       return true;
     }
@@ -1126,8 +1426,8 @@ uint64_t VC2Decoder::SliceInputFragment(char *_idata, int ilength, int n_slices,
   int sx = x_offset;
 
   while (slice_num < n_slices && sy < mSlicesY) {
-    if (((mSliceJobLUTY[sy] & 0x80) == 0) ||
-        ((mSliceJobLUTX[sx] & 0x80) == 0)) {
+    if (((mSliceJobLUTY[sy] & JOBLUT_ACTIVE) == 0) ||
+        ((mSliceJobLUTX[sx] & JOBLUT_ACTIVE) == 0)) {
       idata += lastlength + 1;
       int length = (int)(*((uint8_t *)idata++))*mParams.slice_size_scalar;
       idata += length;
@@ -1144,7 +1444,7 @@ uint64_t VC2Decoder::SliceInputFragment(char *_idata, int ilength, int n_slices,
       writelog(LOG_INFO, "  skip   %6d\n", lastlength - mParams.slice_prefix_bytes);
 #endif
     } else {
-      JobData *job = jobs[(mSliceJobLUTY[sy] & 0x3F)*mJobsX + (mSliceJobLUTX[sx] & 0x3f)];
+      JobData *job = jobs[(mSliceJobLUTY[sy] & JOBLUT_INDEX)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX)];
       const int n = (sy - job->slice_start_y)*job->slices_x + (sx - job->slice_start_x);
 
       idata += lastlength;
@@ -1190,25 +1490,25 @@ uint64_t VC2Decoder::SliceInputFragment(char *_idata, int ilength, int n_slices,
 
       lastlength = job->coded_slices[n].length[2] + mParams.slice_prefix_bytes;
 
-      if ((mSliceJobLUTX[sx] & 0xC0) == 0xC0) {
-        JobData *njob_x = jobs[(mSliceJobLUTY[sy] & 0x3F)*mJobsX + (mSliceJobLUTX[sx] & 0x3f) + 1];
+      if ((mSliceJobLUTX[sx] & JOBLUT_FLAGS) == JOBLUT_OVERLAP) {
+        JobData *njob_x = jobs[(mSliceJobLUTY[sy] & JOBLUT_INDEX)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX) + 1];
         const int nn_x = (sy - njob_x->slice_start_y)*njob_x->slices_x + (sx - njob_x->slice_start_x);
         memcpy((char *)&njob_x->coded_slices[nn_x],
                (char *)&job->coded_slices[n],
                sizeof(CodedSlice));
       }
 
-      if ((mSliceJobLUTY[sy] & 0xC0) == 0xC0) {
-        JobData *njob_y = jobs[((mSliceJobLUTY[sy] & 0x3F) + 1)*mJobsX + (mSliceJobLUTX[sx] & 0x3f)];
+      if ((mSliceJobLUTY[sy] & JOBLUT_FLAGS) == JOBLUT_OVERLAP) {
+        JobData *njob_y = jobs[((mSliceJobLUTY[sy] & JOBLUT_INDEX) + 1)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX)];
         const int nn_y = (sy - njob_y->slice_start_y)*njob_y->slices_x + (sx - njob_y->slice_start_x);
         memcpy((char *)&njob_y->coded_slices[nn_y],
                (char *)&job->coded_slices[n],
                sizeof(CodedSlice));
       }
 
-      if (((mSliceJobLUTX[sx] & 0xC0) == 0xC0) &&
-          ((mSliceJobLUTY[sy] & 0xC0) == 0xC0)){
-        JobData *njob_xy = jobs[((mSliceJobLUTY[sy] & 0x3F) + 1)*mJobsX + (mSliceJobLUTX[sx] & 0x3f) + 1];
+      if (((mSliceJobLUTX[sx] & JOBLUT_FLAGS) == JOBLUT_OVERLAP) &&
+          ((mSliceJobLUTY[sy] & JOBLUT_FLAGS) == JOBLUT_OVERLAP)){
+        JobData *njob_xy = jobs[((mSliceJobLUTY[sy] & JOBLUT_INDEX) + 1)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX) + 1];
         const int nn_xy = (sy - njob_xy->slice_start_y)*njob_xy->slices_x + (sx - njob_xy->slice_start_x);
         memcpy((char *)&njob_xy->coded_slices[nn_xy],
                (char *)&job->coded_slices[n],
@@ -1232,7 +1532,7 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
   char *idata = _idata;
 
   for (int sy = 0; sy < mSlicesY; sy++) {
-    if ((mSliceJobLUTY[sy] & 0x80) == 0) {
+    if ((mSliceJobLUTY[sy] & JOBLUT_ACTIVE) == 0) {
       for (int sx = 0; sx < mSlicesX; sx++) {
         idata += lastlength + 1;
         int length = (int)(*((uint8_t *)idata++))*mParams.slice_size_scalar;
@@ -1251,10 +1551,10 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
 #endif
       }
     }
-    else if ((mSliceJobLUTY[sy] & 0xC0) == 0x80) {
+    else if ((mSliceJobLUTY[sy] & JOBLUT_FLAGS) == JOBLUT_ACTIVE) {
 
       for (int sx = 0; sx < mSlicesX; sx++) {
-        if ((mSliceJobLUTX[sx] & 0x80) == 0x00) {
+        if ((mSliceJobLUTX[sx] & JOBLUT_ACTIVE) == 0) {
           idata += lastlength + 1;
           int length = (int)(*((uint8_t *)idata++))*mParams.slice_size_scalar;
           idata += length;
@@ -1271,7 +1571,7 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
           writelog(LOG_INFO, "  skip   %6d\n", lastlength - mParams.slice_prefix_bytes);
 #endif
         }	else {
-          JobData *job = jobs[(mSliceJobLUTY[sy] & 0x3F)*mJobsX + (mSliceJobLUTX[sx] & 0x3f)];
+          JobData *job = jobs[(mSliceJobLUTY[sy] & JOBLUT_INDEX)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX)];
           const int n = (sy - job->slice_start_y)*job->slices_x + (sx - job->slice_start_x);
 
           idata += lastlength;
@@ -1317,8 +1617,8 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
 
           lastlength = job->coded_slices[n].length[2] + mParams.slice_prefix_bytes;
 
-          if ((mSliceJobLUTX[sx] & 0xC0) == 0xC0) {
-            JobData *njob_x = jobs[(mSliceJobLUTY[sy] & 0x3F)*mJobsX + (mSliceJobLUTX[sx] & 0x3f) + 1];
+          if ((mSliceJobLUTX[sx] & JOBLUT_FLAGS) == JOBLUT_OVERLAP) {
+            JobData *njob_x = jobs[(mSliceJobLUTY[sy] & JOBLUT_INDEX)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX) + 1];
             const int nn_x = (sy - njob_x->slice_start_y)*njob_x->slices_x + (sx - njob_x->slice_start_x);
             memcpy((char *)&njob_x->coded_slices[nn_x],
               (char *)&job->coded_slices[n],
@@ -1330,7 +1630,7 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
     }	else {
 
       for (int sx = 0; sx < mSlicesX; sx++) {
-        if ((mSliceJobLUTX[sx] & 0x80) == 0x00) {
+        if ((mSliceJobLUTX[sx] & JOBLUT_ACTIVE) == 0) {
           idata += lastlength + 1;
           int length = (int)(*((uint8_t *)idata++))*mParams.slice_size_scalar;
           idata += length;
@@ -1348,10 +1648,10 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
 #endif
         } else {
 
-          JobData *job = jobs[(mSliceJobLUTY[sy] & 0x3F)*mJobsX + (mSliceJobLUTX[sx] & 0x3f)];
+          JobData *job = jobs[(mSliceJobLUTY[sy] & JOBLUT_INDEX)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX)];
           const int n = (sy - job->slice_start_y)*job->slices_x + (sx - job->slice_start_x);
 
-          JobData *njob_y = jobs[((mSliceJobLUTY[sy] & 0x3F) + 1)*mJobsX + (mSliceJobLUTX[sx] & 0x3f)];
+          JobData *njob_y = jobs[((mSliceJobLUTY[sy] & JOBLUT_INDEX) + 1)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX)];
           const int nn_y = (sy - njob_y->slice_start_y)*njob_y->slices_x + (sx - njob_y->slice_start_x);
 
           idata += lastlength;
@@ -1401,10 +1701,10 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
             (char *)&job->coded_slices[n],
             sizeof(CodedSlice));
 
-          if ((mSliceJobLUTX[sx] & 0xC0) == 0xC0) {
-            JobData *njob_x = jobs[(mSliceJobLUTY[sy] & 0x3F)*mJobsX + (mSliceJobLUTX[sx] & 0x3f) + 1];
+          if ((mSliceJobLUTX[sx] & JOBLUT_FLAGS) == JOBLUT_OVERLAP) {
+            JobData *njob_x = jobs[(mSliceJobLUTY[sy] & JOBLUT_INDEX)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX) + 1];
             const int nn_x = (sy - njob_x->slice_start_y)*njob_x->slices_x + (sx - njob_x->slice_start_x);
-            JobData *njob_xy = jobs[((mSliceJobLUTY[sy] & 0x3F) + 1)*mJobsX + (mSliceJobLUTX[sx] & 0x3f) + 1];
+            JobData *njob_xy = jobs[((mSliceJobLUTY[sy] & JOBLUT_INDEX) + 1)*mJobsX + (mSliceJobLUTX[sx] & JOBLUT_INDEX) + 1];
             const int nn_xy = (sy - njob_xy->slice_start_y)*njob_xy->slices_x + (sx - njob_xy->slice_start_x);
             memcpy((char *)&njob_x->coded_slices[nn_x],
               (char *)&job->coded_slices[n],
@@ -1454,19 +1754,271 @@ uint64_t VC2Decoder::SliceInput(char *_idata, int ilength, JobData **jobs) {
   return (((uint64_t)idata) + 1 + lastlength) - ((uint64_t)_idata);
 }
 
-void VC2Decoder::Decode(JobData *job, uint16_t **_odata, int *_ostride) {
-  int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX;
-  int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
+void VC2Decoder::BeginPicture(bool wait) {
+  if (wait)
+    WaitAllPictures();
+  else if (mPicturesInFlight == mNumPictures)
+    WaitPicture(true);
 
-  mSliceDecoder(mMatrices,
-    job->coded_slices,
-    job->decoded_slice,
-    job->slices_x, job->slices_y,
-    job->video_data,
-    slice_width,
-    slice_height,
-    mParams.transform_params.wavelet_depth,
-    mDequant);
+  mJobs = mPictures[(mPictureHead + mPicturesInFlight)%mNumPictures]->jobs;
+}
+
+void VC2Decoder::DecodeJobs(uint16_t **odata, int *ostride, bool wait) {
+  const int p = (mPictureHead + mPicturesInFlight)%mNumPictures;
+  PictureData *picture = mPictures[p];
+  picture->odata[0] = odata[0];
+  picture->odata[1] = odata[1];
+  picture->odata[2] = odata[2];
+  picture->failed = false;
+  picture->wide_vlc = (mPictureBytes >= mWideVLCBytes);
+  picture->fused_vlc = (mFusedSliceDecoder != NULL && mPictureBytes < mFusedVLCBytes);
+
+#ifndef DEBUG
+  if (mThreads > 1) {
+    int C = mParams.colourise ? 1 : 3;
+    picture->transforms_remaining = C*mJobsX*mJobsY;
+    picture->first_worker = mJobWorker[p*mJobsX*mJobsY];
+    for (int n = 0; n < mJobsX*mJobsY; n++)
+      SetOutput(mJobs[n], odata, ostride);
+
+    if (mNumaSplit) {
+      for (int k = 0; k < mNumNodes; k++)
+        Post(mNodeWorker[k], std::bind(&VC2Decoder::CopyInput, this, picture, k, std::placeholders::_1));
+    } else {
+      for (int n = 0; n < mJobsX*mJobsY; n++)
+        PostJob(picture, n);
+    }
+    mPicturesInFlight++;
+
+    if (wait)
+      WaitPicture(false);
+  }
+  else
+#endif /*DEBUG*/
+  {
+    for (int n = 0; n < mJobsX*mJobsY; n++)
+      Decode(mJobs[n], odata, ostride, picture->wide_vlc, picture->fused_vlc);
+
+    if (!wait) {
+      DecodedPicture d = { { odata[0], odata[1], odata[2] }, false };
+      mCompleted.push_back(d);
+    }
+  }
+}
+
+void VC2Decoder::PostJob(PictureData *picture, int n) {
+  JobData *job = picture->jobs[n];
+  const int rows = (SLICES_PER_UNIT + job->slices_x - 1)/job->slices_x;
+  const int w = job->worker;
+
+  job->rows_remaining = job->slices_y;
+  for (int i = 0, y = 0; y < job->slices_y; i++, y += rows)
+    Post(mGlobalTransform ? (w + i%mPictureThreads)%mThreads : w,
+         std::bind(&VC2Decoder::DecodeRows, this, picture, job, y, MIN(rows, job->slices_y - y), std::placeholders::_1));
+}
+
+/* Copies the coded data for the jobs in band k of a picture onto the node which decodes them */
+void VC2Decoder::CopyInput(PictureData *picture, int k, int w) {
+  char *lo = NULL;
+  char *hi = NULL;
+  for (int n = 0; n < mJobsX*mJobsY; n++) {
+    if (mJobNode[n] != k)
+      continue;
+    JobData *job = picture->jobs[n];
+    for (int i = 0; i < job->slices_x*job->slices_y; i++) {
+      for (int c = 0; c < 3; c++) {
+        CodedSlice &slice = job->coded_slices[i];
+        if (slice.data[c] == NULL)
+          continue;
+        if (lo == NULL || slice.data[c] < lo)
+          lo = slice.data[c];
+        if (hi == NULL || slice.data[c] + slice.length[c] > hi)
+          hi = slice.data[c] + slice.length[c];
+      }
+    }
+  }
+
+  const size_t size = hi - lo;
+  if (lo != NULL && size > 0) {
+    if (size > picture->input_size[k] || picture->input_node[k] != mPool->node(w)) {
+      if (picture->input[k])
+        NODE_FREE(picture->input_node[k], picture->input[k], picture->input_size[k]);
+      picture->input_node[k] = mPool->node(w);
+      picture->input_size[k] = size;
+      picture->input[k] = (char *)NODE_ALLOC(picture->input_node[k], size);
+    }
+    memcpy(picture->input[k], lo, size);
+
+    for (int n = 0; n < mJobsX*mJobsY; n++) {
+      if (mJobNode[n] != k)
+        continue;
+      JobData *job = picture->jobs[n];
+      for (int i = 0; i < job->slices_x*job->slices_y; i++)
+        for (int c = 0; c < 3; c++)
+          if (job->coded_slices[i].data[c] != NULL)
+            job->coded_slices[i].data[c] = picture->input[k] + (job->coded_slices[i].data[c] - lo);
+    }
+  }
+
+  for (int n = 0; n < mJobsX*mJobsY; n++)
+    if (mJobNode[n] == k)
+      PostJob(picture, n);
+}
+
+/* Waits for the oldest picture in flight, which is kept for collectPicture if keep is set */
+void VC2Decoder::WaitPicture(bool keep) {
+  PictureData *picture = mPictures[mPictureHead];
+  mPool->wait([picture]{ return picture->transforms_remaining == 0; });
+
+  mPictureHead = (mPictureHead + 1)%mNumPictures;
+  mPicturesInFlight--;
+
+  if (keep) {
+    DecodedPicture d = { { picture->odata[0], picture->odata[1], picture->odata[2] }, picture->failed };
+    mCompleted.push_back(d);
+  } else if (picture->failed) {
+    throw VC2DECODER_DECODE_FAILED;
+  }
+}
+
+void VC2Decoder::WaitAllPictures() {
+  while (mPicturesInFlight > 0)
+    WaitPicture(true);
+}
+
+bool VC2Decoder::collectPicture(uint16_t **odata) {
+  if (mCompleted.empty()) {
+    if (mPicturesInFlight == 0)
+      return false;
+    WaitPicture(true);
+  }
+
+  DecodedPicture d = mCompleted.front();
+  mCompleted.pop_front();
+  odata[0] = d.odata[0];
+  odata[1] = d.odata[1];
+  odata[2] = d.odata[2];
+
+  if (d.failed) {
+    writelog(LOG_ERROR, "%s:%d: Error whilst decoding picture", __FILE__, __LINE__);
+    throw VC2DECODER_DECODE_FAILED;
+  }
+
+  return true;
+}
+
+void VC2Decoder::DecodeRows(PictureData *picture, JobData *job, int y, int h, int w) {
+  try {
+    DecodeSlices(job, y, h, &mScratch[3*VLC_SCRATCH_SLICES*w], picture->wide_vlc, picture->fused_vlc);
+  } catch(...) {
+    picture->failed = true;
+  }
+
+  /* The last row of a job to finish queues up its transforms, which may then be stolen */
+  if ((job->rows_remaining -= h) == 0) {
+    if (mSubbandLayout)
+      SummariseCodedBands(job);
+    int C = mParams.colourise ? 1 : 3;
+    for (int c = 0; c < C; c++) {
+      if (mGlobalTransform)
+        PostTransformStage(picture, job, c, ComponentIsZero(job, c) ? 2*mParams.transform_params.wavelet_depth - 1 : 0);
+      else
+        Post(mStickyJobs ? job->worker : w, std::bind(&VC2Decoder::TransformComponent, this, picture, job, c, std::placeholders::_1));
+    }
+  }
+}
+
+void VC2Decoder::TransformComponent(PictureData *picture, JobData *job, int c, int) {
+  try {
+    Transform(job, c);
+    if (mParams.colourise)
+      Colourise(job);
+  } catch(...) {
+    picture->failed = true;
+  }
+  --picture->transforms_remaining;
+}
+
+/* Splits one transform stage of a component between the picture's workers. Even stages are the vertical
+   transform of a level, which is split into columns, and odd stages the horizontal one, split into rows */
+void VC2Decoder::PostTransformStage(PictureData *picture, JobData *job, int c, int stage) {
+  int extent = (stage%2 == 0) ? job->video_data[c]->width : job->video_data[c]->height;
+  if (mSubbandLayout)
+    extent >>= mParams.transform_params.wavelet_depth - stage/2 - 1;
+  int strip = ((extent/mPictureThreads + mStripAlign - 1)/mStripAlign)*mStripAlign;
+  if (strip == 0)
+    strip = mStripAlign;
+  const int n = (extent + strip - 1)/strip;
+
+  picture->strips_remaining[c] = n;
+  for (int i = 0; i < n; i++)
+    Post((picture->first_worker + i)%mThreads,
+         std::bind(&VC2Decoder::TransformStrip, this, picture, job, c, stage, i*strip, MIN((i + 1)*strip, extent), std::placeholders::_1));
+}
+
+void VC2Decoder::TransformStrip(PictureData *picture, JobData *job, int c, int stage, int start, int end, int) {
+  const int l = stage/2;
+  const int depth = mParams.transform_params.wavelet_depth;
+  VideoPlane *plane = job->video_data[c];
+
+  try {
+    if (mSubbandLayout) {
+      SubbandTransformStage(job, c, stage, start, end, stage == 2*depth - 1 && ComponentIsZero(job, c));
+    } else if (stage%2 == 0) {
+      transforms_v[l]((char *)plane->data + start*mSampleSize, plane->stride, end - start, plane->height);
+    } else if (l < depth - 1) {
+      transforms_h[l]((char *)plane->data + start*plane->stride*mSampleSize, plane->stride, plane->width, end - start);
+    } else {
+      /* The final transform is given the whole plane, but only the output rows in the strip */
+      const int y0 = (start > job->output_y[c]) ? start : job->output_y[c];
+      const int y1 = MIN(end, job->output_y[c] + job->output_h[c]);
+      if (y1 > y0)
+        transforms_final(plane->data, plane->stride,
+                         job->odata[c] + (y0 - job->output_y[c])*job->ostride[c]*2,
+                         job->ostride[c],
+                         plane->width, plane->height,
+                         job->output_x[c], y0,
+                         job->output_w[c], y1 - y0);
+    }
+  } catch(...) {
+    picture->failed = true;
+  }
+
+  /* The last strip of a stage to finish starts the next one */
+  if (--picture->strips_remaining[c] == 0) {
+    if (stage < 2*depth - 1)
+      PostTransformStage(picture, job, c, stage + 1);
+    else
+      --picture->transforms_remaining;
+  }
+}
+
+void VC2Decoder::Post(int w, ThreadPool::Task task) {
+  if (mStickyJobs)
+    mPool->post_pinned(mPoolClient, w, task);
+  else
+    mPool->post(mPoolClient, w, task);
+}
+
+/* Clears a job's planes, or worker w's scratch space if job is NULL */
+void VC2Decoder::FirstTouch(JobData *job, int w, std::atomic<int> *remaining, int) {
+  if (job) {
+    for (int c = 0; c < 3; c++) {
+      memset(job->video_data[c]->data, 0, job->video_data[c]->allocsize);
+      if (job->video_data[c]->lowpass)
+        memset(job->video_data[c]->lowpass, 0, job->video_data[c]->lowpass_allocsize);
+    }
+  } else {
+    for (int i = 3*VLC_SCRATCH_SLICES*w; i < 3*VLC_SCRATCH_SLICES*(w + 1); i++)
+      memset(mScratch[i]->data, 0, mScratch[i]->size*sizeof(int32_t));
+  }
+  --*remaining;
+}
+
+void VC2Decoder::Decode(JobData *job, uint16_t **_odata, int *_ostride, bool wide, bool fused) {
+  DecodeSlices(job, 0, job->slices_y, mScratch, wide, fused);
+  if (mSubbandLayout)
+    SummariseCodedBands(job);
 
 #ifdef DEBUG_OP_TRANSFORMED
   {
@@ -1484,13 +2036,7 @@ void VC2Decoder::Decode(JobData *job, uint16_t **_odata, int *_ostride) {
   }
 #endif /* DEBUG_OP_TRANSFORMED */
 
-  job->ostride[0] = _ostride[0];
-  job->ostride[1] = _ostride[1];
-  job->ostride[2] = _ostride[2];
-
-  job->odata[0] = (char *)(_odata[0] + job->ostride[0] * job->target_y[0] + job->target_x[0]);
-  job->odata[1] = (char *)(_odata[1] + job->target_y[1] * job->ostride[1] + job->target_x[1]);
-  job->odata[2] = (char *)(_odata[2] + job->target_y[2] * job->ostride[2] + job->target_x[2]);
+  SetOutput(job, _odata, _ostride);
 
 #ifdef DEBUG_P_BLOCK
   if (job->number == DEBUG_P_JOB) {
@@ -1502,173 +2048,412 @@ void VC2Decoder::Decode(JobData *job, uint16_t **_odata, int *_ostride) {
   }
 #endif
   int C = mParams.colourise ? 1 : 3;
-  for (int c = 0; c < C; c++) {
-    int l;
-    for (l = 0; l < (int)mParams.transform_params.wavelet_depth - 1; l++) {
-      transforms_v[l](job->video_data[c]->data,
-        job->video_data[c]->stride,
-        job->video_data[c]->width,
-        job->video_data[c]->height);
+  for (int c = 0; c < C; c++)
+    Transform(job, c);
 
-#ifdef DEBUG_P_BLOCK
-      if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
-        printf("-----------------------------------------------------------------\n");
-        printf("Transform V%d\n", l);
-        printf("-----------------------------------------------------------------\n");
-        __debug_print_slice(job, mSampleSize);
-        printf("-----------------------------------------------------------------\n");
+  if (mParams.colourise)
+    Colourise(job);
+}
+
+/* The last eight bytes of data of the given length, the last in the top byte, with any missing read as all
+   ones, and nothing outside the data read, as it may be all of a buffer */
+static inline uint64_t tail_word(const uint8_t *data, int length) {
+  uint64_t w;
+  if (length >= 8) {
+    memcpy(&w, data + length - 8, 8);
+    return w;
+  }
+  w = ~(uint64_t)0;
+  if (length & 1) {
+    w = (w >> 8) | ((uint64_t)data[0] << 56);
+    data += 1;
+  }
+  if (length & 2) {
+    uint16_t v;
+    memcpy(&v, data, 2);
+    w = (w >> 16) | ((uint64_t)v << 48);
+    data += 2;
+  }
+  if (length & 4) {
+    uint32_t v;
+    memcpy(&v, data, 4);
+    w = (w >> 32) | ((uint64_t)v << 32);
+  }
+  return w;
+}
+
+void VC2Decoder::DecodeSlices(JobData *job, int y, int h, DecodedSlice **scratch, bool wide, bool fused) {
+  int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX;
+  int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
+
+  VideoPlane plane0(job->video_data[0], y*slice_height, h*slice_height, mSampleSize);
+  VideoPlane plane1(job->video_data[1], y*slice_height, h*slice_height, mSampleSize);
+  VideoPlane plane2(job->video_data[2], y*slice_height, h*slice_height, mSampleSize);
+  VideoPlane *planes[3] = { &plane0, &plane1, &plane2 };
+
+  if (fused) {
+    mFusedSliceDecoder(mMatrices,
+      &job->coded_slices[y*job->slices_x],
+      job->slices_x, h,
+      planes,
+      slice_width,
+      slice_height,
+      mParams.transform_params.wavelet_depth,
+      mFusedPlacement);
+    return;
+  }
+
+  (wide ? mWideSliceDecoder : mSliceDecoder)(mMatrices,
+    &job->coded_slices[y*job->slices_x],
+    scratch,
+    job->slices_x, h,
+    planes,
+    slice_width,
+    slice_height,
+    mParams.transform_params.wavelet_depth,
+    mDequant);
+
+  /* Every coefficient takes at least a bit, and the padding at the end of a slice decodes as zeros, so all the
+     subbands starting after the last byte before the padding are zero, which the transforms can make use of. This
+     is done after the slices are decoded, whilst their ends are still in the cache */
+  if (mSubbandLayout) {
+    for (int n = y*job->slices_x; n < (y + h)*job->slices_x; n++) {
+      CodedSlice *slice = &job->coded_slices[n];
+      for (int c = 0; c < 3; c++) {
+        const uint8_t *data = (const uint8_t *)slice->data[c];
+        int length = slice->length[c];
+        int coded = 0;
+        /* Finds the last byte which isn't padding a word at a time */
+        while (length > 0) {
+          const uint64_t tail = ~tail_word(data, length);
+          if (tail) {
+            coded = length - 8 + (63 - __builtin_clzll(tail))/8 + 1;
+            break;
+          }
+          length -= 8;
+        }
+        slice->coded_bands[c] = mBandsCoded[c][MIN(coded, mBandsCodedMax[c])];
       }
-#endif
+    }
+  }
+}
 
-      transforms_h[l](job->video_data[c]->data,
-        job->video_data[c]->stride,
-        job->video_data[c]->width,
-        job->video_data[c]->height);
+void VC2Decoder::SetOutput(JobData *job, uint16_t **_odata, int *_ostride) {
+  job->ostride[0] = _ostride[0];
+  job->ostride[1] = _ostride[1];
+  job->ostride[2] = _ostride[2];
 
-#ifdef DEBUG_P_BLOCK
-      if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
-        printf("-----------------------------------------------------------------\n");
-        printf("Transform H%d\n", l);
-        printf("-----------------------------------------------------------------\n");
-        __debug_print_slice(job, mSampleSize);
-        printf("-----------------------------------------------------------------\n");
+  job->odata[0] = (char *)(_odata[0] + job->ostride[0] * job->target_y[0] + job->target_x[0]);
+  job->odata[1] = (char *)(_odata[1] + job->target_y[1] * job->ostride[1] + job->target_x[1]);
+  job->odata[2] = (char *)(_odata[2] + job->target_y[2] * job->ostride[2] + job->target_x[2]);
+}
+
+/* A component with no coded data in any of its slices is all zeros after dequantisation, and stays so through
+   every level of lifting, so only the final level which applies the offset and writes the output is needed */
+bool VC2Decoder::ComponentIsZero(JobData *job, int c) {
+  for (int n = 0; n < job->slices_x*job->slices_y; n++)
+    if (job->coded_slices[n].length[c] != 0)
+      return false;
+  return true;
+}
+
+/* Once every slice of a job is decoded, the subbands coded in each are gathered into the columns and rows of
+   slices which the subband transform stages work along */
+void VC2Decoder::SummariseCodedBands(JobData *job) {
+  for (int c = 0; c < 3; c++) {
+    for (int X = 0; X < job->slices_x; X++)
+      job->column_bands[c][X] = 0;
+    for (int Y = 0; Y < job->slices_y; Y++) {
+      job->row_bands[c][Y] = 0;
+      for (int X = 0; X < job->slices_x; X++) {
+        const int coded = job->coded_slices[Y*job->slices_x + X].coded_bands[c];
+        job->row_bands[c][Y]    = MAX(job->row_bands[c][Y], coded);
+        job->column_bands[c][X] = MAX(job->column_bands[c][X], coded);
       }
+    }
+  }
+}
+
+void VC2Decoder::Transform(JobData *job, int c) {
+  const bool zero = ComponentIsZero(job, c);
+  int l;
+
+  if (mSubbandLayout) {
+    const int depth = mParams.transform_params.wavelet_depth;
+    for (l = zero ? depth - 1 : 0; l < depth; l++) {
+      if (!zero)
+        SubbandTransformStage(job, c, 2*l, 0, job->video_data[c]->width >> (depth - l - 1), zero);
+      SubbandTransformStage(job, c, 2*l + 1, 0, job->video_data[c]->height >> (depth - l - 1), zero);
+    }
+    return;
+  }
+
+  for (l = 0; l < (int)mParams.transform_params.wavelet_depth - 1 && !zero; l++) {
+    transforms_v[l](job->video_data[c]->data,
+      job->video_data[c]->stride,
+      job->video_data[c]->width,
+      job->video_data[c]->height);
+
+#ifdef DEBUG_P_BLOCK
+    if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
+      printf("-----------------------------------------------------------------\n");
+      printf("Transform V%d\n", l);
+      printf("-----------------------------------------------------------------\n");
+      __debug_print_slice(job, mSampleSize);
+      printf("-----------------------------------------------------------------\n");
+    }
 #endif
+
+    transforms_h[l](job->video_data[c]->data,
+      job->video_data[c]->stride,
+      job->video_data[c]->width,
+      job->video_data[c]->height);
+
+#ifdef DEBUG_P_BLOCK
+    if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
+      printf("-----------------------------------------------------------------\n");
+      printf("Transform H%d\n", l);
+      printf("-----------------------------------------------------------------\n");
+      __debug_print_slice(job, mSampleSize);
+      printf("-----------------------------------------------------------------\n");
     }
+#endif
+  }
 
-    {
+  l = mParams.transform_params.wavelet_depth - 1;
+  {
+    if (!zero)
       transforms_v[l](job->video_data[c]->data,
         job->video_data[c]->stride,
         job->video_data[c]->width,
         job->video_data[c]->height);
 
 #ifdef DEBUG_P_BLOCK
-      if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
-        printf("-----------------------------------------------------------------\n");
-        printf("Transform V%d\n", l);
-        printf("-----------------------------------------------------------------\n");
-        __debug_print_slice(job, mSampleSize);
-        printf("-----------------------------------------------------------------\n");
-      }
+    if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
+      printf("-----------------------------------------------------------------\n");
+      printf("Transform V%d\n", l);
+      printf("-----------------------------------------------------------------\n");
+      __debug_print_slice(job, mSampleSize);
+      printf("-----------------------------------------------------------------\n");
+    }
 #endif
 
-      transforms_final(job->video_data[c]->data,
-        job->video_data[c]->stride,
-        job->odata[c],
-        job->ostride[c],
-        job->video_data[c]->width,
-        job->video_data[c]->height,
-        job->output_x[c],
-        job->output_y[c],
-        job->output_w[c],
-        job->output_h[c]);
+    transforms_final(job->video_data[c]->data,
+      job->video_data[c]->stride,
+      job->odata[c],
+      job->ostride[c],
+      job->video_data[c]->width,
+      job->video_data[c]->height,
+      job->output_x[c],
+      job->output_y[c],
+      job->output_w[c],
+      job->output_h[c]);
 
 #ifdef DEBUG_P_BLOCK
-      if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
-        printf("-----------------------------------------------------------------\n");
-        printf("Transform H%d\n", l);
-        printf("-----------------------------------------------------------------\n");
-        for (int y = DEBUG_P_SLICE_Y*DEBUG_P_SLICE_H; y < DEBUG_P_SLICE_Y*DEBUG_P_SLICE_H + DEBUG_P_SLICE_H; y++) {
-          int16_t *D = (int16_t *)&job->odata[DEBUG_P_COMP][2 * (y*job->ostride[DEBUG_P_COMP] + DEBUG_P_SLICE_X*DEBUG_P_SLICE_W - job->output_x[DEBUG_P_COMP])];
-          printf("  ");
-          for (int x = 0; x < DEBUG_P_SLICE_W; x++)
-            printf("%+6d ", D[x]);
-          printf("\n");
-        }
-        printf("-----------------------------------------------------------------\n");
+    if (job->number == DEBUG_P_JOB && c == DEBUG_P_COMP) {
+      printf("-----------------------------------------------------------------\n");
+      printf("Transform H%d\n", l);
+      printf("-----------------------------------------------------------------\n");
+      for (int y = DEBUG_P_SLICE_Y*DEBUG_P_SLICE_H; y < DEBUG_P_SLICE_Y*DEBUG_P_SLICE_H + DEBUG_P_SLICE_H; y++) {
+        int16_t *D = (int16_t *)&job->odata[DEBUG_P_COMP][2 * (y*job->ostride[DEBUG_P_COMP] + DEBUG_P_SLICE_X*DEBUG_P_SLICE_W - job->output_x[DEBUG_P_COMP])];
+        printf("  ");
+        for (int x = 0; x < DEBUG_P_SLICE_W; x++)
+          printf("%+6d ", D[x]);
+        printf("\n");
       }
+      printf("-----------------------------------------------------------------\n");
+    }
 #endif
+  }
+}
+
+/* How many of the high pass subbands of level l may be nonzero in slice column n, or for rows in slice rows n - 1
+   to n + 1, which is as far as the vertical transform reaches: 0 for none, 1 for HL, 2 for HL and LH, 3 for all */
+int VC2Decoder::LevelBandsCoded(JobData *job, int c, int l, bool rows, int n) {
+  int coded = 0;
+  if (rows) {
+    for (int Y = MAX(n - 1, 0); Y <= MIN(n + 1, job->slices_y - 1); Y++)
+      coded = MAX(coded, job->row_bands[c][Y]);
+  } else {
+    coded = job->column_bands[c][n];
+  }
+  return MIN(MAX(coded - 3*l - 1, 0), 3);
+}
+
+/* The end of the run of whole slices of level l from column (or row) start, up to end, over which LevelBandsCoded
+   is the same, and what it is */
+int VC2Decoder::LevelBandsCodedRun(JobData *job, int c, int l, bool rows, int start, int end, int *coded) {
+  const int depth = mParams.transform_params.wavelet_depth;
+  VideoPlane *plane = job->video_data[c];
+  const int size = (rows ? plane->height/job->slices_y : plane->width/job->slices_x) >> (depth - l);
+  int n = start/size;
+  *coded = LevelBandsCoded(job, c, l, rows, n);
+  for (n++; n*size < end && LevelBandsCoded(job, c, l, rows, n) == *coded; n++);
+  return MIN(n*size, end);
+}
+
+/* One stage of the transform of a plane held a subband at a time. Even stages lift the columns [start, end) of
+   the level against each other, and odd stages interleave the subbands into the rows [start, end) of the level's
+   output, which for every level but the last is the low pass input to the next. Runs of slices where the high pass
+   subbands are zero use the zero_high transforms, or skip the lifting of subbands which are all zero */
+void VC2Decoder::SubbandTransformStage(JobData *job, int c, int stage, int start, int end, bool zero) {
+  const int l = stage/2;
+  const int depth = mParams.transform_params.wavelet_depth;
+  const int ss = mSampleSize;
+  VideoPlane *plane = job->video_data[c];
+  const int stride = plane->stride;
+  const int w = plane->width  >> (depth - l);
+  const int h = plane->height >> (depth - l);
+
+  /* The low pass input is the lowest subband for the first level, and the output of the previous one after that,
+     but a component which is all zeros has zeros where the lower levels are in the plane which can stand in for it */
+  char *ll = (char *)plane->data;
+  int llstride = stride;
+  if (l > 0 && !zero) {
+    ll = plane->lowpass_level(l, ss);
+    llstride = plane->lowpass_stride;
+  }
+  char *hl = (char *)plane->data + w*ss;
+  char *lh = (char *)plane->data + h*stride*ss;
+  char *hh = lh + w*ss;
+
+  int coded;
+  if (stage%2 == 0) {
+    for (int x0 = start, x1; x0 < MIN(end, w); x0 = x1) {
+      x1 = LevelBandsCodedRun(job, c, l, false, x0, MIN(end, w), &coded);
+      (coded >= 2 ? transforms_v_subbands : transforms_v_subbands_zero_high)(ll + x0*ss, llstride, lh + x0*ss, stride, x1 - x0, h);
+    }
+    for (int x0 = MAX(start, w) - w, x1; x0 < end - w; x0 = x1) {
+      x1 = LevelBandsCodedRun(job, c, l, false, x0, end - w, &coded);
+      if (coded == 3)
+        transforms_v_subbands(hl + x0*ss, stride, hh + x0*ss, stride, x1 - x0, h);
+      else if (coded > 0)
+        transforms_v_subbands_zero_high(hl + x0*ss, stride, hh + x0*ss, stride, x1 - x0, h);
+    }
+  } else if (l < depth - 1) {
+    char *odata = plane->lowpass_level(l + 1, ss);
+    const int ostride = plane->lowpass_stride;
+    const int e0 = (start + 1)/2, e1 = (end + 1)/2;
+    const int o0 = start/2, o1 = end/2;
+    for (int y0 = e0, y1; y0 < e1; y0 = y1) {
+      y1 = LevelBandsCodedRun(job, c, l, true, y0, e1, &coded);
+      (coded > 0 ? transforms_h_subbands : transforms_h_subbands_zero_high)(ll + y0*llstride*ss, llstride, hl + y0*stride*ss, stride,
+                                                                           odata + 2*y0*ostride*ss, 2*ostride, w, y1 - y0);
+    }
+    for (int y0 = o0, y1; y0 < o1; y0 = y1) {
+      y1 = LevelBandsCodedRun(job, c, l, true, y0, o1, &coded);
+      (coded > 0 ? transforms_h_subbands : transforms_h_subbands_zero_high)(lh + y0*stride*ss, stride, hh + y0*stride*ss, stride,
+                                                                           odata + (2*y0 + 1)*ostride*ss, 2*ostride, w, y1 - y0);
+    }
+  } else {
+    /* Only the rows in the job's output are written */
+    const int y0 = (start > job->output_y[c]) ? start : job->output_y[c];
+    const int y1 = MIN(end, job->output_y[c] + job->output_h[c]);
+    const int e0 = (y0 + 1)/2, e1 = (y1 + 1)/2;
+    const int o0 = y0/2, o1 = y1/2;
+    for (int r0 = e0, r1; r0 < e1; r0 = r1) {
+      r1 = LevelBandsCodedRun(job, c, l, true, r0, e1, &coded);
+      (coded > 0 ? transforms_final_subbands : transforms_final_subbands_zero_high)(ll + r0*llstride*ss, llstride, hl + r0*stride*ss, stride,
+                                                                                   job->odata[c] + (2*r0 - job->output_y[c])*job->ostride[c]*2, 2*job->ostride[c],
+                                                                                   w, r1 - r0, job->output_x[c], job->output_w[c]);
+    }
+    for (int r0 = o0, r1; r0 < o1; r0 = r1) {
+      r1 = LevelBandsCodedRun(job, c, l, true, r0, o1, &coded);
+      (coded > 0 ? transforms_final_subbands : transforms_final_subbands_zero_high)(lh + r0*stride*ss, stride, hh + r0*stride*ss, stride,
+                                                                                   job->odata[c] + (2*r0 + 1 - job->output_y[c])*job->ostride[c]*2, 2*job->ostride[c],
+                                                                                   w, r1 - r0, job->output_x[c], job->output_w[c]);
     }
   }
-  if (mParams.colourise) {
-    if (mParams.colourise_quantiser) {
-      int min_q, max_q;
-      min_q = 255;
-      max_q = 0;
-      for (int N = 0; N < job->slices_y*job->slices_x; N++) {
-        if (job->coded_slices[N].qindex > max_q)
-          max_q = job->coded_slices[N].qindex;
-        if (job->coded_slices[N].qindex < min_q)
-          min_q = job->coded_slices[N].qindex;
-      }
+}
+
+void VC2Decoder::Colourise(JobData *job) {
+  if (mParams.colourise_quantiser) {
+    int min_q, max_q;
+    min_q = 255;
+    max_q = 0;
+    for (int N = 0; N < job->slices_y*job->slices_x; N++) {
+      if (job->coded_slices[N].qindex > max_q)
+        max_q = job->coded_slices[N].qindex;
+      if (job->coded_slices[N].qindex < min_q)
+        min_q = job->coded_slices[N].qindex;
+    }
 
 #ifdef DEBUG
-      writelog(LOG_INFO, "Quantisers: [%d, %d]\n", min_q, max_q);
+    writelog(LOG_INFO, "Quantisers: [%d, %d]\n", min_q, max_q);
 #endif
 
-      int q_mult_fact = ((1 << 10) - 1) / (max_q - min_q);
-
-      for (int c = 1; c < 3; c++) {
-        int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX / 2;
-        int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
-        for (int Y = 0; Y < job->slices_y; Y++) {
-          for (int X = 0; X < job->slices_x; X++) {
-            CodedSlice *slice = &job->coded_slices[Y*job->slices_x + X];
-            for (int y = 0; y < slice_height; y++) {
-              for (int x = 0; x < slice_width; x++) {
-                int yy = (Y*slice_height + y) - job->output_y[c];
-                int xx = (X*slice_width + x) - job->output_x[c];
-                if (yy >= 0 && yy < job->output_h[c] && xx >= 0 && xx < job->output_w[c])
-                  ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (slice->qindex - min_q)*q_mult_fact;
-              }
+    int q_mult_fact = ((1 << 10) - 1) / (max_q - min_q);
+
+    for (int c = 1; c < 3; c++) {
+      int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX / 2;
+      int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
+      for (int Y = 0; Y < job->slices_y; Y++) {
+        for (int X = 0; X < job->slices_x; X++) {
+          CodedSlice *slice = &job->coded_slices[Y*job->slices_x + X];
+          for (int y = 0; y < slice_height; y++) {
+            for (int x = 0; x < slice_width; x++) {
+              int yy = (Y*slice_height + y) - job->output_y[c];
+              int xx = (X*slice_width + x) - job->output_x[c];
+              if (yy >= 0 && yy < job->output_h[c] && xx >= 0 && xx < job->output_w[c])
+                ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (slice->qindex - min_q)*q_mult_fact;
             }
           }
         }
       }
     }
-    else if (mParams.colourise_padding) {
-      int min_p, max_p;
-      min_p = 255 * mParams.slice_size_scalar;
-      max_p = 0;
-      for (int N = 0; N < job->slices_y*job->slices_x; N++) {
-        if (job->coded_slices[N].padding > max_p)
-          max_p = job->coded_slices[N].padding;
-        if (job->coded_slices[N].padding < min_p)
-          min_p = job->coded_slices[N].padding;
-      }
+  }
+  else if (mParams.colourise_padding) {
+    int min_p, max_p;
+    min_p = 255 * mParams.slice_size_scalar;
+    max_p = 0;
+    for (int N = 0; N < job->slices_y*job->slices_x; N++) {
+      if (job->coded_slices[N].padding > max_p)
+        max_p = job->coded_slices[N].padding;
+      if (job->coded_slices[N].padding < min_p)
+        min_p = job->coded_slices[N].padding;
+    }
 
 #ifdef DEBUG
-      writelog(LOG_INFO, "Padding: [%d, %d]\n", min_p, max_p);
+    writelog(LOG_INFO, "Padding: [%d, %d]\n", min_p, max_p);
 #endif
 
-      int p_mult_fact = ((1 << 10) - 1) / (max_p - min_p);
-
-      for (int c = 1; c < 3; c++) {
-        int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX / 2;
-        int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
-        for (int Y = 0; Y < job->slices_y; Y++) {
-          for (int X = 0; X < job->slices_x; X++) {
-            CodedSlice *slice = &job->coded_slices[Y*job->slices_x + X];
-            for (int y = 0; y < slice_height; y++) {
-              for (int x = 0; x < slice_width; x++) {
-                int yy = (Y*slice_height + y) - job->output_y[c];
-                int xx = (X*slice_width + x) - job->output_x[c];
-                if (yy >= 0 && yy < job->output_h[c] && xx >= 0 && xx < job->output_w[c])
-                  ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (slice->padding - min_p)*p_mult_fact;
-              }
+    int p_mult_fact = ((1 << 10) - 1) / (max_p - min_p);
+
+    for (int c = 1; c < 3; c++) {
+      int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX / 2;
+      int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
+      for (int Y = 0; Y < job->slices_y; Y++) {
+        for (int X = 0; X < job->slices_x; X++) {
+          CodedSlice *slice = &job->coded_slices[Y*job->slices_x + X];
+          for (int y = 0; y < slice_height; y++) {
+            for (int x = 0; x < slice_width; x++) {
+              int yy = (Y*slice_height + y) - job->output_y[c];
+              int xx = (X*slice_width + x) - job->output_x[c];
+              if (yy >= 0 && yy < job->output_h[c] && xx >= 0 && xx < job->output_w[c])
+                ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (slice->padding - min_p)*p_mult_fact;
             }
           }
         }
       }
     }
-    else if (mParams.colourise_unpadded) {
-      for (int c = 1; c < 3; c++) {
-        int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX / 2;
-        int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
-        for (int Y = 0; Y < job->slices_y; Y++) {
-          for (int X = 0; X < job->slices_x; X++) {
-            CodedSlice *slice = &job->coded_slices[Y*job->slices_x + X];
-            for (int y = 0; y < slice_height; y++) {
-              for (int x = 0; x < slice_width; x++) {
-                int yy = (Y*slice_height + y) - job->output_y[c];
-                int xx = (X*slice_width + x) - job->output_x[c];
-                if (yy >= 0 && yy < job->output_h[c] && xx >= 0 && xx < job->output_w[c]) {
-                  if (slice->padding == 0) {
-                    ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (1 << 10) - 1;
-                  }
-                  else {
-                    ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (1 << 9);
-                  }
+  }
+  else if (mParams.colourise_unpadded) {
+    for (int c = 1; c < 3; c++) {
+      int slice_width = (mWidth + mParams.transform_params.slices_x - 1) / mSlicesX / 2;
+      int slice_height = (mHeight + mParams.transform_params.slices_y - 1) / mSlicesY;
+      for (int Y = 0; Y < job->slices_y; Y++) {
+        for (int X = 0; X < job->slices_x; X++) {
+          CodedSlice *slice = &job->coded_slices[Y*job->slices_x + X];
+          for (int y = 0; y < slice_height; y++) {
+            for (int x = 0; x < slice_width; x++) {
+              int yy = (Y*slice_height + y) - job->output_y[c];
+              int xx = (X*slice_width + x) - job->output_x[c];
+              if (yy >= 0 && yy < job->output_h[c] && xx >= 0 && xx < job->output_w[c]) {
+                if (slice->padding == 0) {
+                  ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (1 << 10) - 1;
+                }
+                else {
+                  ((uint16_t *)job->odata[c])[yy*job->ostride[c] + xx] = (1 << 9);
                 }
               }
             }
@@ -1676,12 +2461,12 @@ void VC2Decoder::Decode(JobData *job, uint16_t **_odata, int *_ostride) {
         }
       }
     }
-    else {
-      for (int c = 1; c < 3; c++) {
-        for (int y = 0; y < job->output_h[c]; y++)
-          for (int x = 0; x < job->output_w[c]; x++)
-            ((uint16_t *)job->odata[c])[y*job->ostride[c] + x] = (1 << 9);
-      }
+  }
+  else {
+    for (int c = 1; c < 3; c++) {
+      for (int y = 0; y < job->output_h[c]; y++)
+        for (int x = 0; x < job->output_w[c]; x++)
+          ((uint16_t *)job->odata[c])[y*job->ostride[c] + x] = (1 << 9);
     }
   }
 }
@@ -27,6 +27,7 @@
 #define __VC2DECODER_HPP__
 
 #include <stdlib.h>
+#include <deque>
 
 #include "internal.h"
 #include "VideoFormat.hpp"
@@ -38,6 +39,23 @@
 
 void detect_cpu_features();
 
+/* The pool shared by decoders with use_shared_pool set, created once per process */
+bool create_shared_pool(int threads, int numa_first_node, int spin_us);
+ThreadPool *shared_pool();
+
+/* Entries in the slice to job lookup tables */
+#define JOBLUT_ACTIVE  0x8000 /* Slice is decoded by a job */
+#define JOBLUT_OVERLAP 0xC000 /* Slice is also needed by the following job */
+#define JOBLUT_FLAGS   0xC000
+#define JOBLUT_INDEX   0x3FFF
+
+/* Pictures with at least this many coded bits per coefficient use the wide VLC table */
+#define WIDE_VLC_MIN_BITS 4
+
+/* With fused_dequantise set, pictures with fewer than this many coded bits per coefficient are
+   decoded with the fused decoder, which only wins where most coefficients are zero */
+#define FUSED_VLC_MAX_BITS 1
+
 class VC2Decoder {
 public:
   VC2Decoder() {
@@ -48,9 +66,26 @@ public:
     mJobsX = 0;
     mJobsY = 0;
     mJobs = NULL;
+    mPictures = NULL;
+    mNumPictures = 0;
+    mPictureHead = 0;
+    mPicturesInFlight = 0;
+    mPictureThreads = 0;
+    mJobWorker = NULL;
+    mJobNode = NULL;
+    mNumaSplit = false;
+    mNumNodes = 1;
+    mGlobalTransform = false;
+    mStripAlign = 1;
+    mStickyJobs = false;
     mPool = NULL;
+    mSharedPool = false;
+    mPoolClient = 0;
     mThreads = 0;
 
+    mScratch = NULL;
+    mNumScratch = 0;
+
     mTransformParamsEncoded = NULL;
     mTransformParamsEncodedLength = 0;
     mSeqHeaderEncoded = NULL;
@@ -60,11 +95,29 @@ public:
 
     transforms_h = NULL;
     transforms_v = NULL;
+    mSubbandLayout = false;
+    transforms_v_subbands = NULL;
+    transforms_h_subbands = NULL;
+    transforms_final_subbands = NULL;
+    transforms_v_subbands_zero_high = NULL;
+    transforms_h_subbands_zero_high = NULL;
+    transforms_final_subbands_zero_high = NULL;
     mDequant[0] = NULL;
     mDequant[1] = NULL;
     mDequant[2] = NULL;
 
     mSliceDecoder = NULL;
+    mWideSliceDecoder = NULL;
+    mFusedSliceDecoder = NULL;
+    mFusedPlacement[0] = NULL;
+    mFusedPlacement[1] = NULL;
+    mFusedPlacement[2] = NULL;
+    mBandsCoded[0] = NULL;
+    mBandsCoded[1] = NULL;
+    mBandsCoded[2] = NULL;
+    mWideVLCBytes = 0;
+    mFusedVLCBytes = 0;
+    mPictureBytes = 0;
 
     mSliceJobLUTX = NULL;
     mSliceJobLUTY = NULL;
@@ -79,17 +132,32 @@ public:
   }
 
   ~VC2Decoder() {
-    if (mJobs) {
-      for (int i = 0; i < mJobsX*mJobsY; i++)
-        if (mJobs[i])
-          delete mJobs[i];
-      delete[] mJobs;
+    if (mPictures) {
+      try {
+        WaitAllPictures();
+      } catch(...) {}
+      for (int i = 0; i < mNumPictures; i++)
+        delete mPictures[i];
+      delete[] mPictures;
     }
     if (mMatrices)
-      delete_matrices(mMatrices);
+      release_quantisation_matrices(mMatrices);
+    for (int c = 0; c < 3; c++) {
+      delete mFusedPlacement[c];
+      delete[] mBandsCoded[c];
+    }
     if (mPool) {
-      mPool->stop();
-      delete mPool;
+      if (mSharedPool) {
+        mPool->detach(mPoolClient);
+      } else {
+        mPool->stop();
+        delete mPool;
+      }
+    }
+    if (mScratch) {
+      for (int i = 0; i < 3*VLC_SCRATCH_SLICES*mNumScratch; i++)
+        delete mScratch[i];
+      delete[] mScratch;
     }
     if (mTransformParamsEncoded) {
       delete[] mTransformParamsEncoded;
@@ -102,6 +170,11 @@ public:
       delete[] mSliceJobLUTX;
     }
 
+    if (mJobWorker)
+      delete[] mJobWorker;
+    if (mJobNode)
+      delete[] mJobNode;
+
     if (mSliceJobLUTY) {
       delete[] mSliceJobLUTY;
     }
@@ -120,8 +193,8 @@ public:
   bool parseSeqHeader(char *_idata, const char *end);
   VC2DecoderOutputFormat getOutputFormat() { return mOutputFormat; }
 
-  uint64_t decodeFrame(char *idata, int ilength, uint16_t **odata, int *ostride);
-  bool handleFragment(char *idata, int ilength, uint16_t **odata, int *ostride);
+  uint64_t decodeFrame(char *idata, int ilength, uint16_t **odata, int *ostride, bool wait = true);
+  bool handleFragment(char *idata, int ilength, uint16_t **odata, int *ostride, bool wait = true);
 
   char *FindNextParseInfo(char *_idata, int ilength);
   /*
@@ -129,7 +202,12 @@ public:
      seaks through stream, finds Sequence Header, processes. Advances idata.
    */
   VC2DecoderSequenceResult sequenceSynchronise(char **idata, int ilength, bool skip_aux);
-  VC2DecoderSequenceResult sequenceDecodeOnePicture(char **idata, int ilength, uint16_t **odata, int *ostride, bool skip_aux);
+  VC2DecoderSequenceResult sequenceDecodeOnePicture(char **idata, int ilength, uint16_t **odata, int *ostride, bool skip_aux, bool wait = true);
+  /*
+     returns the oldest picture started by sequenceDecodeOnePicture without waiting,
+     waiting for it to complete if need be. Returns false if there are none.
+   */
+  bool collectPicture(uint16_t **odata);
   int sequenceExtractAux(char **idata, int ilength, uint8_t **odata);
 
 protected:
@@ -138,7 +216,29 @@ protected:
   uint64_t SliceInput(char *idata, int ilength, JobData **jobs);
   uint64_t SliceInputFragment(char *idata, int ilength, int n_slices, int x_offset, int y_offset, JobData **jobs);
 
-  void Decode(JobData *, uint16_t **odata, int *ostride);
+  void BeginPicture(bool wait);
+  void DecodeJobs(uint16_t **odata, int *ostride, bool wait);
+  void WaitPicture(bool keep);
+  void WaitAllPictures();
+  void PostJob(PictureData *, int n);
+  void CopyInput(PictureData *, int k, int worker);
+  void DecodeRows(PictureData *, JobData *, int y, int h, int worker);
+  void TransformComponent(PictureData *, JobData *, int c, int worker);
+  void PostTransformStage(PictureData *, JobData *, int c, int stage);
+  void TransformStrip(PictureData *, JobData *, int c, int stage, int start, int end, int worker);
+  void Post(int worker, ThreadPool::Task task);
+  void FirstTouch(JobData *, int w, std::atomic<int> *remaining, int worker);
+
+  void Decode(JobData *, uint16_t **odata, int *ostride, bool wide, bool fused);
+  void DecodeSlices(JobData *, int y, int h, DecodedSlice **scratch, bool wide, bool fused);
+  void SetOutput(JobData *, uint16_t **odata, int *ostride);
+  bool ComponentIsZero(JobData *, int c);
+  void SummariseCodedBands(JobData *);
+  void Transform(JobData *, int c);
+  void SubbandTransformStage(JobData *, int c, int stage, int start, int end, bool zero);
+  int LevelBandsCoded(JobData *, int c, int l, bool rows, int n);
+  int LevelBandsCodedRun(JobData *, int c, int l, bool rows, int start, int end, int *coded);
+  void Colourise(JobData *);
 
   VC2DecoderParamsInternal mParams;
   vc2::VideoFormat mVideoFormat;
@@ -146,17 +246,47 @@ protected:
   int mSlicesX;
   int mSlicesY;
 
+  /* The jobs of the picture currently being sliced, one of mPictures */
   JobData **mJobs;
   int mJobsX;
   int mJobsY;
 
   int mOverlapX;
+  int mOverlapY;
+
+  /* Ring of pictures, mPicturesInFlight of which starting at mPictureHead are being decoded */
+  PictureData **mPictures;
+  int mNumPictures;
+  int mPictureHead;
+  int mPicturesInFlight;
+  std::deque<DecodedPicture> mCompleted;
+  int mPictureThreads;
+
+  /* The worker each job of each picture is posted to, and the NUMA node band each job is in */
+  int *mJobWorker;
+  int *mJobNode;
+  bool mNumaSplit;
+  int mNumNodes;
+  int mNodeWorker[MAX_NUMA_NODES];
+
+  /* Each picture is decoded into a single plane and every transform level is shared between the workers */
+  bool mGlobalTransform;
+  int mStripAlign;
+
+  /* Work for each job is pinned to the job's worker rather than being open to stealing */
+  bool mStickyJobs;
 
   QuantisationMatrix *mMatrices;
 
   ThreadPool *mPool;
+  bool mSharedPool;
+  int mPoolClient;
   int mThreads;
 
+  /* Per-thread scratch space for slice decoding, three components per thread */
+  DecodedSlice **mScratch;
+  int mNumScratch;
+
   uint8_t *mTransformParamsEncoded;
   int mTransformParamsEncodedLength;
 
@@ -171,11 +301,30 @@ protected:
   InplaceTransform *transforms_v;
   InplaceTransformFinal transforms_final;
 
+  /* Each picture is held a subband at a time, and transformed with these instead */
+  bool mSubbandLayout;
+  SubbandTransformV transforms_v_subbands;
+  SubbandTransformH transforms_h_subbands;
+  SubbandTransformFinal transforms_final_subbands;
+  SubbandTransformV transforms_v_subbands_zero_high;
+  SubbandTransformH transforms_h_subbands_zero_high;
+  SubbandTransformFinal transforms_final_subbands_zero_high;
+  /* For each component, how many subbands start within each number of bytes of coded data in a slice, up to
+     mBandsCodedMax bytes past which all of them do */
+  uint8_t *mBandsCoded[3];
+  int mBandsCodedMax[3];
+
   DequantiseFunction mDequant[3];
   SliceDecoderFunc mSliceDecoder;
-
-  uint8_t *mSliceJobLUTX;
-  uint8_t *mSliceJobLUTY;
+  SliceDecoderFunc mWideSliceDecoder;
+  FusedSliceDecoderFunc mFusedSliceDecoder;
+  FusedPlacement *mFusedPlacement[3];
+  uint64_t mWideVLCBytes;  /* Coded size above which a picture is decoded with the wide table */
+  uint64_t mFusedVLCBytes; /* Coded size below which a picture is decoded with the fused decoder */
+  uint64_t mPictureBytes;  /* Coded size of the picture being sliced */
+
+  uint16_t *mSliceJobLUTX;
+  uint16_t *mSliceJobLUTY;
 
   bool mInterlaced;
 
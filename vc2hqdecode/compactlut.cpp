@@ -0,0 +1,50 @@
+/*****************************************************************************
+ * compactlut.cpp : Compact Variable Length Decoding table
+ *****************************************************************************
+ * Copyright (C) 2014-2015 BBC
+ *
+ * Authors: James P. Weaver <james.barrett@bbc.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at ipstudio@bbc.co.uk.
+ *****************************************************************************/
+
+#include "lut.hpp"
+
+ALIGNED(64) static CompactLUTEntry COMPACTVLCLUT[4*256];
+
+static bool build_compact_vlc_lut() {
+  for (int i = 0; i < 4*256; i++) {
+    const LUTEntry &E = VLCLUT[i];
+    CompactLUTEntry &C = COMPACTVLCLUT[i];
+    C.state        = E.state;
+    C.preshift_sgn = E.preshift | ((E.sgn & 0x3) << 6);
+    C.val0         = E.val0;
+    C.N_V          = E.N | (E.V << 4);
+    C.val[0]       = E.val1;
+    C.val[1]       = E.val2;
+    C.val[2]       = E.val3;
+    C.val[3]       = E.val4;
+  }
+  return true;
+}
+
+const CompactLUTEntry *compact_vlc_lut() {
+  static const bool built = build_compact_vlc_lut();
+  (void)built;
+  return COMPACTVLCLUT;
+}
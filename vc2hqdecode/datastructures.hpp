@@ -32,8 +32,13 @@
 
 #include <cstring>
 
+#include <atomic>
+
 #include "platform_variant.hpp"
 
+/* The most NUMA nodes a single picture will be split between */
+#define MAX_NUMA_NODES 8
+
 struct CodedSlice {
 public:
   CodedSlice() {
@@ -43,56 +48,145 @@ public:
     length[0] = 0;
     length[1] = 0;
     length[2] = 0;
+    coded_bands[0] = 0;
+    coded_bands[1] = 0;
+    coded_bands[2] = 0;
   }
 
 
   char *data[3];
   int length[3];
+  /* With the subband layout, how many of the subbands from the DC one on may have nonzero coefficients,
+     all those after being coded only with padding */
+  int coded_bands[3];
   int qindex;
   int padding;
 };
 
 class DecodedSlice {
 public:
-  DecodedSlice(int S) {
+  DecodedSlice(int S, int node = -1) {
     size = S;
     const int PAD = 8;
     const int alloc_size = ((S + PAD + 15)/16)*16;
-    mAllocatedData = ALIGNED_ALLOC(16, sizeof(uint32_t)*alloc_size);
+    mNode          = node;
+    mAllocatedSize = sizeof(uint32_t)*alloc_size;
+    mAllocatedData = NODE_ALLOC(mNode, mAllocatedSize);
     data           = (int32_t *)mAllocatedData;
   }
 
   ~DecodedSlice() {
-    ALIGNED_FREE(mAllocatedData);
+    NODE_FREE(mNode, mAllocatedData, mAllocatedSize);
   }
 
+  /* Coefficients are held at the sample size of the planes they are decoded into, so
+     there is room for size of them at 32 bits even when they are held at 16 */
+  template <class T> T *as() { return (T*)data; }
+
   int size;
   int32_t *data;
 
 protected:
   void *mAllocatedData;
+  size_t mAllocatedSize;
+  int mNode;
 };
 
+/* A plane of samples. Normally the coefficients of every level of the transform are interleaved in place
+   within it, but it can instead be held a subband at a time, with depth levels: the DC subband at the top
+   left, and subband s of level l in the quadrant s of the region twice its size, so that each level can be
+   undone with dense sweeps along the rows of its subbands. The low pass output of each level but the last
+   is then written to one of two alternating regions of a separate low pass buffer. */
 struct VideoPlane {
-  VideoPlane(int w, int h, int sample_size) {
+  VideoPlane(int w, int h, int sample_size, int _node = -1, int _depth = 0) {
     width  = w;
     height = h;
     int align_size = 64/sample_size;
     stride = (((w + align_size - 1)/align_size)*align_size); // Integer number of cache lines
-    int allocsize = 2*stride*height*sample_size;
-    data = (void *)ALIGNED_ALLOC(16, allocsize);
+    allocsize = 2*stride*height*sample_size;
+    node = _node;
+    data = (void *)NODE_ALLOC(node, allocsize);
+    owned = true;
+    y_offset = 0;
+    whole_width  = w;
+    whole_height = h;
+
+    depth = _depth;
+    lowpass = NULL;
+    lowpass_stride = 0;
+    lowpass_allocsize = 0;
+    if (depth > 0) {
+      lowpass_stride = (((w/2 + align_size - 1)/align_size)*align_size);
+      lowpass_allocsize = lowpass_stride*height*sample_size;
+      lowpass = (void *)NODE_ALLOC(node, lowpass_allocsize);
+    }
+  }
+
+  /* A view onto rows [y, y + h) of another plane, does not own its data */
+  VideoPlane(const VideoPlane *parent, int y, int h, int sample_size) {
+    width  = parent->width;
+    height = h;
+    stride = parent->stride;
+    data   = (void *)(((char *)parent->data) + y*stride*sample_size);
+    allocsize = 0;
+    node   = parent->node;
+    owned  = false;
+    y_offset = parent->y_offset + y;
+    whole_width  = parent->whole_width;
+    whole_height = parent->whole_height;
+
+    depth = parent->depth;
+    lowpass = parent->lowpass;
+    lowpass_stride = parent->lowpass_stride;
+    lowpass_allocsize = 0;
   }
 
   ~VideoPlane() {
-    ALIGNED_FREE(data);
+    if (owned) {
+      NODE_FREE(node, data, allocsize);
+      if (lowpass)
+        NODE_FREE(node, lowpass, lowpass_allocsize);
+    }
   }
 
   template <class T> T *as() { return (T*)data; }
 
+  /* Where subband b starts in a plane held a subband at a time, with the subbands numbered in the order they
+     are coded, so subband 0 is the DC subband and 3*(l - 1) + s is subband s of level l */
+  template <class T> T *subband(int b) {
+    T *origin = ((T *)data) - y_offset*stride;
+    if (b == 0)
+      return origin;
+    const int l = (b + 2)/3;
+    const int s = (b - 1)%3 + 1;
+    const int x = (s != 2) ? (whole_width  >> (depth - l + 1)) : 0;
+    const int y = (s >= 2) ? (whole_height >> (depth - l + 1)) : 0;
+    return &origin[y*stride + x];
+  }
+
+  /* Where the low pass input to level l > 0 is held */
+  char *lowpass_level(int l, int sample_size) {
+    return ((char *)lowpass) + ((l - 1)%2)*(whole_height/2)*lowpass_stride*sample_size;
+  }
+
   void *data;
   int stride;
   int height;
   int width;
+  size_t allocsize;
+  int node;
+  bool owned;
+
+  /* The first row of the whole plane which a view starts at, and the size of the whole plane */
+  int y_offset;
+  int whole_width;
+  int whole_height;
+
+  /* The number of levels when the plane is held a subband at a time, otherwise zero */
+  int depth;
+  void *lowpass;
+  int lowpass_stride;
+  size_t lowpass_allocsize;
 };
 
 struct JobData {
@@ -103,8 +197,9 @@ struct JobData {
            int outw,  int outh,
            int tgt_x, int tgt_y,
            int _slice_start_x, int _slice_start_y,
-           int sample_size) {
+           int sample_size, int _worker = 0, int node = -1, int subband_depth = 0) {
     number = n;
+    worker = _worker;
     width[0] = _width;
     width[1] = _width/2;
     width[2] = _width/2;
@@ -145,12 +240,14 @@ struct JobData {
     odata[2] = NULL;
 
     coded_slices  = new CodedSlice[slices_x*slices_y];
-    decoded_slice[0] = new DecodedSlice(width[0]*height[0]/_slices_x/_slices_y);
-    decoded_slice[1] = new DecodedSlice(width[1]*height[1]/_slices_x/_slices_y);
-    decoded_slice[2] = new DecodedSlice(width[2]*height[2]/_slices_x/_slices_y);
-    video_data[0] = new VideoPlane(width[0], height[0], sample_size);
-    video_data[1] = new VideoPlane(width[1], height[1], sample_size);
-    video_data[2] = new VideoPlane(width[2], height[2], sample_size);
+    video_data[0] = new VideoPlane(width[0], height[0], sample_size, node, subband_depth);
+    video_data[1] = new VideoPlane(width[1], height[1], sample_size, node, subband_depth);
+    video_data[2] = new VideoPlane(width[2], height[2], sample_size, node, subband_depth);
+
+    for (int c = 0; c < 3; c++) {
+      column_bands[c] = (subband_depth > 0) ? new int[slices_x] : NULL;
+      row_bands[c]    = (subband_depth > 0) ? new int[slices_y] : NULL;
+    }
 
     target_x[0] = tgt_x;
     target_x[1] = tgt_x/2;
@@ -161,24 +258,36 @@ struct JobData {
 
     slice_start_x = _slice_start_x;
     slice_start_y = _slice_start_y;
+
+    rows_remaining = 0;
   }
 
   ~JobData() {
     delete[] coded_slices;
-    delete decoded_slice[0];
-    delete decoded_slice[1];
-    delete decoded_slice[2];
     delete video_data[0];
     delete video_data[1];
     delete video_data[2];
+    for (int c = 0; c < 3; c++) {
+      delete[] column_bands[c];
+      delete[] row_bands[c];
+    }
   }
   
   CodedSlice *coded_slices;
-  DecodedSlice *decoded_slice[3];
   VideoPlane *video_data[3];
 
+  /* With the subband layout, the most subbands coded in any slice of each column and row of slices */
+  int *column_bands[3];
+  int *row_bands[3];
+
+  /* Slice rows still to be decoded before the transforms can start */
+  std::atomic<int> rows_remaining;
+
   int number;
 
+  /* The worker the job is posted to */
+  int worker;
+
   int slice_start_x;
   int slice_start_y;
 
@@ -200,4 +309,73 @@ struct JobData {
   int target_y[3];
 };
 
+/* The jobs making up one picture and where it is to be written. When pipelining
+   there are several of these, so one picture can be sliced whilst others decode */
+struct PictureData {
+  PictureData(int n) {
+    n_jobs = n;
+    jobs = new JobData*[n_jobs];
+    for (int i = 0; i < n_jobs; i++)
+      jobs[i] = NULL;
+
+    odata[0] = NULL;
+    odata[1] = NULL;
+    odata[2] = NULL;
+
+    transforms_remaining = 0;
+    failed = false;
+    first_worker = 0;
+    wide_vlc = false;
+    fused_vlc = false;
+    for (int c = 0; c < 3; c++)
+      strips_remaining[c] = 0;
+
+    for (int k = 0; k < MAX_NUMA_NODES; k++) {
+      input[k] = NULL;
+      input_size[k] = 0;
+      input_node[k] = -1;
+    }
+  }
+
+  ~PictureData() {
+    for (int i = 0; i < n_jobs; i++)
+      if (jobs[i])
+        delete jobs[i];
+    delete[] jobs;
+    for (int k = 0; k < MAX_NUMA_NODES; k++)
+      if (input[k])
+        NODE_FREE(input_node[k], input[k], input_size[k]);
+  }
+
+  JobData **jobs;
+  int n_jobs;
+
+  uint16_t *odata[3];
+
+  /* Transforms still to run before the picture is complete */
+  std::atomic<int> transforms_remaining;
+  std::atomic<bool> failed;
+
+  /* When transforming the whole picture as one plane, the strips of the current
+     transform stage of each component which are still to run, and the first of
+     the workers the picture is shared between */
+  std::atomic<int> strips_remaining[3];
+  int first_worker;
+
+  /* Whether the picture is dense enough to be decoded through the wide VLC table */
+  bool wide_vlc;
+  bool fused_vlc;
+
+  /* Copies of the coded data made on each node when a picture is split across NUMA nodes */
+  char *input[MAX_NUMA_NODES];
+  size_t input_size[MAX_NUMA_NODES];
+  int input_node[MAX_NUMA_NODES];
+};
+
+/* A picture which has finished decoding but has not yet been collected */
+struct DecodedPicture {
+  uint16_t *odata[3];
+  bool failed;
+};
+
 #endif /* __DATA_STRUCTURES_HPP__ */
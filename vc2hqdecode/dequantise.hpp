@@ -44,8 +44,16 @@ struct QuantisationMatrix {
 VC2HQDECODE_API QuantisationMatrix *quantisation_matrices(uint32_t wavelet_index, int depth, int qindex_max);
 void delete_matrices(QuantisationMatrix *matrix);
 
+/* Shared matrices for the wavelet, depth and (custom or default) quantisation matrix in params,
+   each call must be matched by a call to release_quantisation_matrices */
+QuantisationMatrix *get_quantisation_matrices(const VC2DecoderTransformParams &params, int qindex_max);
+void release_quantisation_matrices(QuantisationMatrix *matrices);
+
+/* The coefficients in idata are the same size as the samples in odata. For planes held a subband at a
+   time odata is instead an array of pointers to where the slice goes in each of its 3*depth + 1 subbands,
+   in the order they are coded, all with the stride ostride. */
 typedef void (*DequantiseFunction)(QuantisationMatrix *matrix,
-                                   int32_t *idata,
+                                   void *idata,
                                    void *odata,
                                    int ostride,
                                    int slice_width,
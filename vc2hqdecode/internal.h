@@ -44,6 +44,15 @@ typedef struct _VC2DecoderParamsInternal {
   int slice_size_scalar;
   int threads;
   int numa_first_node;
+  int thread_spin_us;
+  int pipeline_depth;
+  int picture_threads;
+  bool use_shared_pool;
+  bool numa_split_picture;
+  bool global_transform;
+  bool sticky_jobs;
+  bool fused_dequantise;
+  bool subband_layout;
 
   bool colourise;
   bool colourise_quantiser;
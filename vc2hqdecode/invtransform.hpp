@@ -48,4 +48,40 @@ typedef InplaceTransform (*GetInvVTransform)(int wavelet_index, int level, int d
 typedef InplaceTransform (*GetInvHTranform)(int wavelet_index, int level, int depth, int sample_size);
 typedef InplaceTransformFinal (*GetInvHTransformFinal)(int wavelet_index, int active_bits, int sample_size);
 
+/* Transforms for planes held a subband at a time. The vertical transform lifts the rows of a low pass
+   subband against those of the high pass subband below it in place. The horizontal transforms take
+   rows of a low and a high pass subband and write rows of twice the width with the two interleaved,
+   either as samples for the next level or clipped and offset into the output at [ooffset_x, ooffset_x + owidth).
+   The zero_high variants of each are for where the high pass subband is all zeros, and never read it. */
+typedef void (*SubbandTransformV)(void *ldata,
+                                  const int lstride,
+                                  void *hdata,
+                                  const int hstride,
+                                  const int width,
+                                  const int height);
+
+typedef void (*SubbandTransformH)(const void *ldata,
+                                  const int lstride,
+                                  const void *hdata,
+                                  const int hstride,
+                                  void *odata,
+                                  const int ostride,
+                                  const int width,
+                                  const int height);
+
+typedef void (*SubbandTransformFinal)(const void *ldata,
+                                      const int lstride,
+                                      const void *hdata,
+                                      const int hstride,
+                                      const char *odata,
+                                      const int ostride,
+                                      const int width,
+                                      const int height,
+                                      const int ooffset_x,
+                                      const int owidth);
+
+typedef SubbandTransformV (*GetInvVSubbandTransform)(int wavelet_index, int sample_size);
+typedef SubbandTransformH (*GetInvHSubbandTransform)(int wavelet_index, int sample_size);
+typedef SubbandTransformFinal (*GetInvHSubbandTransformFinal)(int wavelet_index, int active_bits, int sample_size);
+
 #endif /* __INVTRANSFORM_HPP__ */
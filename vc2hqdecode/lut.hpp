@@ -1079,4 +1079,38 @@ const LUTEntry VLCLUT[] = {
         { STATE_DATA,   0, -1, 1,  1, 7, 0x00, 0x00,  +0,  +0,  +0,  +0,  +0,  +0,  +0,  +0},  //STATE_SIGN    0xfe
         { STATE_START,  0, -1, 1,  0, 8, 0x00, 0x00,  +0,  +0,  +0,  +0,  +0,  +0,  +0,  +0}   //STATE_SIGN    0xff
     };
+
+/* The wide table is indexed by the state and the next twelve bits, so two lookups take
+   three bytes, and each entry has room for the up to twelve coefficients they can hold.
+   It is too large to list here so it is built the first time it is asked for. */
+const int WIDE_VLC_BITS = 12;
+
+ALIGNED(32) struct WideLUTEntry {
+    uint8_t state;
+    uint8_t preshift;
+    int8_t  sgn;
+    int8_t  term;
+    uint8_t V;
+    int8_t  N;
+    uint8_t _pad0;
+    uint8_t _pad1;
+    int8_t  val[16];
+};
+
+const WideLUTEntry *wide_vlc_lut();
+
+/* The same table as VLCLUT packed into eight bytes an entry, so it takes half the cache. Only
+   the first five values of an entry are ever nonzero and the rest of the fields are small, so
+   sgn is kept in the top two bits of preshift and V in the top four of N. term isn't needed as
+   it is set exactly when N is nonzero. */
+struct CompactLUTEntry {
+    uint8_t state;
+    uint8_t preshift_sgn;
+    uint8_t val0;
+    uint8_t N_V;
+    int8_t  val[4];
+};
+
+const CompactLUTEntry *compact_vlc_lut();
+
 #endif /*__LUT_HPP__*/
@@ -49,7 +49,36 @@ static __inline void *vc2_align_malloc(int align, size_t size)
   #define ALIGNED(N)
 #endif
 
-/* __builtin_clz doesn't exist on windows */
+/* Allocation on a given NUMA node, a negative node means anywhere */
+#if !defined _WIN32 && !defined __CYGWIN__
+  #include "config.h"
+#endif
+
+#ifdef VC2_USE_NUMA
+#include <numa.h>
+
+static __inline void *vc2_node_malloc(int node, size_t size)
+{
+    if (node < 0 || numa_available() < 0)
+        return ALIGNED_ALLOC(64, size);
+    return numa_alloc_onnode(size, node);
+}
+
+static __inline void vc2_node_free(int node, void *ptr, size_t size)
+{
+    if (node < 0 || numa_available() < 0)
+        ALIGNED_FREE(ptr);
+    else
+        numa_free(ptr, size);
+}
+  #define NODE_ALLOC(node, size) vc2_node_malloc(node, size)
+  #define NODE_FREE(node, ptr, size) vc2_node_free(node, ptr, size)
+#else
+  #define NODE_ALLOC(node, size) ALIGNED_ALLOC(64, size)
+  #define NODE_FREE(node, ptr, size) ALIGNED_FREE(ptr)
+#endif
+
+/* __builtin_clz, __builtin_clzll, __builtin_ctz and __builtin_bswap64 don't exist on windows */
 #ifdef _WIN32
 #include <intrin.h>
 #include <cstdint>
@@ -59,15 +88,32 @@ static uint32_t __inline __builtin_clz(uint32_t x) {
 	_BitScanReverse(&r, x);
 	return (31 - r);
 }
+
+static uint32_t __inline __builtin_clzll(uint64_t x) {
+	unsigned long r = 0;
+	_BitScanReverse64(&r, x);
+	return (63 - r);
+}
+
+static uint32_t __inline __builtin_ctz(uint32_t x) {
+	unsigned long r = 0;
+	_BitScanForward(&r, x);
+	return r;
+}
+
+static uint64_t __inline __builtin_bswap64(uint64_t x) {
+	return _byteswap_uint64(x);
+}
 #endif
 
+/* The AVX2 code also uses BMI2, which every processor with AVX2 has had so far, so both are needed */
 static void __inline __detect_cpu_features(bool &HAS_SSE4_2, bool &HAS_AVX, bool &HAS_AVX2) {
 #ifdef __GNUC__
   __builtin_cpu_init();
 
   HAS_SSE4_2 = __builtin_cpu_supports("sse4.2");
   HAS_AVX    = __builtin_cpu_supports("avx");
-  HAS_AVX2   = __builtin_cpu_supports("avx2");
+  HAS_AVX2   = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
 #elif _WIN32
   {
     int cpuinfo[4];
@@ -81,7 +127,7 @@ static void __inline __detect_cpu_features(bool &HAS_SSE4_2, bool &HAS_AVX, bool
 
       if (HAS_AVX && nids >= 7) {
         __cpuid(cpuinfo, 7);
-        HAS_AVX2 = ((cpuinfo[1] & (1 << 5)) != 0);
+        HAS_AVX2 = ((cpuinfo[1] & (1 << 5)) != 0) && ((cpuinfo[1] & (1 << 8)) != 0);
       }
     }
   }
@@ -28,6 +28,8 @@
 #include "dequantise.hpp"
 
 #include "platform_variant.hpp"
+#include <string.h>
+#include <mutex>
 
 int32_t quant_factor(int i) {
 	int b = 1 << (i / 4);
@@ -320,12 +322,9 @@ const int DEFAULT_QUANTISATION_MATRIX_ADJUSTMENTS[VC2DECODER_WFT_NUM][5][5][4] =
 };
 
 
-VC2HQDECODE_API QuantisationMatrix *quantisation_matrices(uint32_t wavelet_index, int depth, int qindex_max) {
-	if (depth > 4) {
-		writelog(LOG_ERROR, "%s:%d:  Could not form quantisation matrices, depth greater than 4 not supported\n", __FILE__, __LINE__);
-		throw VC2DECODER_NOTIMPLEMENTED;
-	}
-
+/* Builds matrices for qindex 0 to qindex_max from per level and subband adjustments laid
+   out as in DEFAULT_QUANTISATION_MATRIX_ADJUSTMENTS, level 0 holding only LL in subband 0 */
+static QuantisationMatrix *build_matrices(const int adjust[][4], int depth, int qindex_max) {
 	QuantisationMatrix *matrix = new QuantisationMatrix[qindex_max + 1];
 
 	__m128i **pointers_qf_1 = new __m128i*[(depth + 1)*(qindex_max + 1)];
@@ -342,7 +341,7 @@ VC2HQDECODE_API QuantisationMatrix *quantisation_matrices(uint32_t wavelet_index
 			matrix[q].qoffset[l] = &pointers_qo_2[4 * ((depth + 1)*q + l)];
 
 			for (int s = 0; s < 4; s++) {
-				int qi = (q > DEFAULT_QUANTISATION_MATRIX_ADJUSTMENTS[wavelet_index][depth][l][s]) ? (q - DEFAULT_QUANTISATION_MATRIX_ADJUSTMENTS[wavelet_index][depth][l][s]) : 0;
+				int qi = (q > adjust[l][s]) ? (q - adjust[l][s]) : 0;
 				matrix[q].qfactor[l][s] = _mm_set1_epi32(quant_factor(qi));
 				matrix[q].qoffset[l][s] = _mm_set1_epi32(quant_offset(qi) + 2);
 			}
@@ -352,6 +351,15 @@ VC2HQDECODE_API QuantisationMatrix *quantisation_matrices(uint32_t wavelet_index
 	return matrix;
 }
 
+VC2HQDECODE_API QuantisationMatrix *quantisation_matrices(uint32_t wavelet_index, int depth, int qindex_max) {
+	if (depth > 4) {
+		writelog(LOG_ERROR, "%s:%d:  Could not form quantisation matrices, no default matrix for depth greater than 4\n", __FILE__, __LINE__);
+		throw VC2DECODER_NOTIMPLEMENTED;
+	}
+
+	return build_matrices(DEFAULT_QUANTISATION_MATRIX_ADJUSTMENTS[wavelet_index][depth], depth, qindex_max);
+}
+
 void delete_matrices(QuantisationMatrix *matrix) {
 	ALIGNED_FREE(matrix[0].qfactor[0]);
 	ALIGNED_FREE(matrix[0].qoffset[0]);
@@ -359,3 +367,89 @@ void delete_matrices(QuantisationMatrix *matrix) {
 	delete[] matrix[0].qoffset;
 	delete[] matrix;
 }
+
+/* Matrices are shared between all decoders in the process, keyed on the matrix in use rather than
+   on where it came from, so a custom matrix equal to the default shares its entry. An entry is
+   built the first time it is asked for and a few are kept after their last user is gone, so that
+   switching between a small number of configurations doesn't rebuild them each time. */
+struct QuantisationMatrixCacheEntry {
+	int depth;
+	int qindex_max;
+	int adjust[MAX_DWT_DEPTH + 1][4];
+	QuantisationMatrix *matrices;
+	int users;
+	QuantisationMatrixCacheEntry *next;
+};
+
+#define QUANTISATION_MATRIX_CACHE_UNUSED 4
+
+static QuantisationMatrixCacheEntry *MATRIX_CACHE = NULL;
+static std::mutex MATRIX_CACHE_MUTEX;
+
+QuantisationMatrix *get_quantisation_matrices(const VC2DecoderTransformParams &params, int qindex_max) {
+	const int depth = params.wavelet_depth;
+	if (depth < 0 || depth > MAX_DWT_DEPTH) {
+		writelog(LOG_ERROR, "%s:%d:  Could not form quantisation matrices, depth greater than %d not supported\n", __FILE__, __LINE__, MAX_DWT_DEPTH);
+		throw VC2DECODER_NOTIMPLEMENTED;
+	}
+
+	int adjust[MAX_DWT_DEPTH + 1][4];
+	memset(adjust, 0, sizeof(adjust));
+	if (params.custom_quant_matrix_flag) {
+		/* Any adjustment of qindex_max or more takes every qindex down to 0 */
+		adjust[0][0] = (params.quant_matrix_LL < (uint32_t)qindex_max) ? params.quant_matrix_LL : qindex_max;
+		for (int l = 1; l <= depth; l++) {
+			adjust[l][1] = (params.quant_matrix_HL[l - 1] < (uint32_t)qindex_max) ? params.quant_matrix_HL[l - 1] : qindex_max;
+			adjust[l][2] = (params.quant_matrix_LH[l - 1] < (uint32_t)qindex_max) ? params.quant_matrix_LH[l - 1] : qindex_max;
+			adjust[l][3] = (params.quant_matrix_HH[l - 1] < (uint32_t)qindex_max) ? params.quant_matrix_HH[l - 1] : qindex_max;
+		}
+	} else {
+		if (params.wavelet_index >= VC2DECODER_WFT_NUM || depth > 4) {
+			writelog(LOG_ERROR, "%s:%d:  Could not form quantisation matrices, no default matrix for wavelet %d at depth %d\n", __FILE__, __LINE__, params.wavelet_index, depth);
+			throw VC2DECODER_NOTIMPLEMENTED;
+		}
+		memcpy(adjust, DEFAULT_QUANTISATION_MATRIX_ADJUSTMENTS[params.wavelet_index][depth], (depth + 1)*sizeof(adjust[0]));
+	}
+
+	std::lock_guard<std::mutex> lock(MATRIX_CACHE_MUTEX);
+	QuantisationMatrixCacheEntry **p = &MATRIX_CACHE;
+	while (*p && ((*p)->depth != depth || (*p)->qindex_max != qindex_max || memcmp((*p)->adjust, adjust, sizeof(adjust))))
+		p = &(*p)->next;
+
+	QuantisationMatrixCacheEntry *entry = *p;
+	if (entry) {
+		*p = entry->next;
+	} else {
+		writelog(LOG_INFO, "Building quantisation matrices for depth %d", depth);
+		entry = new QuantisationMatrixCacheEntry;
+		entry->depth = depth;
+		entry->qindex_max = qindex_max;
+		memcpy(entry->adjust, adjust, sizeof(adjust));
+		entry->matrices = build_matrices(entry->adjust, depth, qindex_max);
+		entry->users = 0;
+	}
+
+	/* Most recently used entries are kept at the front */
+	entry->users++;
+	entry->next = MATRIX_CACHE;
+	MATRIX_CACHE = entry;
+	return entry->matrices;
+}
+
+void release_quantisation_matrices(QuantisationMatrix *matrices) {
+	std::lock_guard<std::mutex> lock(MATRIX_CACHE_MUTEX);
+	int unused = 0;
+	QuantisationMatrixCacheEntry **p = &MATRIX_CACHE;
+	while (*p) {
+		QuantisationMatrixCacheEntry *entry = *p;
+		if (entry->matrices == matrices)
+			entry->users--;
+		if (entry->users == 0 && ++unused > QUANTISATION_MATRIX_CACHE_UNUSED) {
+			*p = entry->next;
+			delete_matrices(entry->matrices);
+			delete entry;
+		} else {
+			p = &entry->next;
+		}
+	}
+}
@@ -42,6 +42,17 @@ void vc2decode_init() {
   detect_cpu_features();
 }
 
+VC2DecoderResult vc2decode_init_shared_pool(int threads, int numa_first_node, int spin_us) {
+  try {
+    if (!create_shared_pool(threads, numa_first_node, spin_us))
+      return VC2DECODER_BADPARAMS;
+    return VC2DECODER_OK;
+
+  } catch (...) {
+    return VC2DECODER_UNKNOWN_ERROR;
+  }
+}
+
 VC2DecoderHandle vc2decode_create() {
    VC2Decoder *decoder = new VC2Decoder();
   return (VC2DecoderHandle)decoder;
@@ -119,6 +130,24 @@ VC2DecoderResult vc2decode_decode_one_picture(VC2DecoderHandle handle, char **id
   VC2DECODER_END
 }
 
+VC2DecoderResult vc2decode_start_one_picture(VC2DecoderHandle handle, char **idata, int ilength, uint16_t **odata, int *ostride, int skip_aux) {
+  VC2DECODER_BEGIN
+
+  return (VC2DecoderResult)decoder->sequenceDecodeOnePicture(idata, ilength, odata, ostride, (bool)skip_aux, false);
+
+  VC2DECODER_END
+}
+
+VC2DecoderResult vc2decode_finish_one_picture(VC2DecoderHandle handle, uint16_t **odata) {
+  VC2DECODER_BEGIN
+
+  if (decoder->collectPicture(odata))
+    return VC2DECODER_OK_PICTURE;
+  return VC2DECODER_OK;
+
+  VC2DECODER_END
+}
+
 VC2DecoderResult vc2decode_sequence_info(VC2DecoderHandle handle, VC2DecoderSequenceInfo *info)  {
   VC2DECODER_BEGIN
 
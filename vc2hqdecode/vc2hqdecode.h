@@ -54,7 +54,7 @@ extern "C" {
 /**
  * This constant will change when the API in this header file changes.
  */
-#define VC2DECODER_API_VERSION 2
+#define VC2DECODER_API_VERSION 11
 
 /*
  This forces a link error if trying to link to an incompatible version of the code,
@@ -74,12 +74,12 @@ typedef void * VC2DecoderHandle;
  */
 typedef struct VC2DecoderParamsUser {
   /**
-   * set the number of threads the decoder will use internally. The current implementation does not support
-   * numbers of threads greater than 16. The decoded is aggressively multithreaded and will distribute work
-   * over as many threads as it is given. It is generally extremely efficient at doing so, but more threads
-   * does increase the total workload needed to decode a frame (due to some duplication being needed) and
-   * so it is recommended that the number of threads be kept as low as will work -- which may require some
-   * experimentation to determine.
+   * set the number of threads the decoder will use internally. Any number of threads is supported, though
+   * small pictures may not be divisible into enough work to keep very many threads busy. The decoded is
+   * aggressively multithreaded and will distribute work over as many threads as it is given. It is generally
+   * extremely efficient at doing so, but more threads does increase the total workload needed to decode a
+   * frame (due to some duplication being needed) and so it is recommended that the number of threads be kept
+   * as low as will work -- which may require some experimentation to determine.
    */
   int threads;
 
@@ -88,6 +88,76 @@ typedef struct VC2DecoderParamsUser {
    */
   int numa_first_node;
 
+  /**
+   * Idle decoder threads busy-wait for up to this many microseconds for more work before going to sleep.
+   * This keeps the cost of starting work on each picture or fragment low, at the expense of some CPU time.
+   * Zero selects the default of 50us, and a negative value makes idle threads sleep straight away.
+   */
+  int thread_spin_us;
+
+  /**
+   * The maximum number of pictures started with vc2decode_start_one_picture which may be decoding at once.
+   * Values of zero or one mean that each picture must finish before the next one is started.
+   */
+  int pipeline_depth;
+
+  /**
+   * If this is non-zero and less than threads then each picture is only split up over this many threads, and
+   * consecutive pictures are given to different groups of threads. Set pipeline_depth to at least threads/picture_threads
+   * and use vc2decode_start_one_picture to keep every group busy. This scales better than splitting each
+   * picture over all of the threads when there are many threads and the pictures are small.
+   */
+  int picture_threads;
+
+  /**
+   * If this is non-zero then the decoder does not create threads of its own, but runs on the pool created by
+   * vc2decode_init_shared_pool, which must already have been called. The pool's threads take turns between the
+   * decoders using them, so that many streams can be decoded at once without more threads than cores. In this
+   * case threads only sets how many pieces each picture is split into, and zero means the size of the pool.
+   * thread_spin_us and numa_first_node are taken from the pool.
+   */
+  int use_shared_pool;
+
+  /**
+   * If this is non-zero and the decoder's threads are spread over more than one NUMA node, then each picture is split
+   * between the nodes in horizontal bands. Each band is decoded only by threads on its own node, into memory on that
+   * node, from a copy of its part of the coded picture which is made on that node. This is intended for very large
+   * pictures, such as 8K, on machines with more than one processor socket.
+   */
+  int numa_split_picture;
+
+  /**
+   * If this is non-zero then each picture is decoded into a single plane rather than into overlapping pieces, so no
+   * part of it is decoded twice. The threads share out the slices, and then share out each level of the inverse
+   * transform in turn, waiting for each other between levels. This avoids the extra work done in the overlaps, which
+   * grows with the number of threads. It has no effect with a single thread, or when colourising the output.
+   * numa_split_picture is ignored when this is set.
+   */
+  int global_transform;
+
+  /**
+   * If this is non-zero then each piece of a picture is always decoded by the same thread, and threads do not take
+   * work from each other. Each thread then finds the buffers for its pieces already in its own cache when decoding
+   * a run of pictures of the same format, at the cost of balancing the load less evenly between the threads.
+   */
+  int sticky_jobs;
+
+  /**
+   * If this is non-zero then coefficients are dequantised and written into the picture as they are decoded, rather
+   * than being decoded into a scratch buffer and dequantised from there. This only pays where most coefficients are
+   * zero, so it is only done for pictures coded at less than one bit per coefficient, and other pictures are decoded
+   * as usual. This is ignored where the processor does not support SSE4.2.
+   */
+  int fused_dequantise;
+
+  /**
+   * If this is non-zero then each picture is held a subband at a time while it is decoded, rather than with the
+   * coefficients of each level interleaved in place, so every level of the inverse transform works along whole rows
+   * of contiguous samples. This is only done for the LeGall (5,3) and Haar wavelets, with slices whose height and
+   * half their width are multiples of 1 << wavelet_depth, and is ignored with fused_dequantise.
+   */
+  int subband_layout;
+
 
   /**
    * These are debugging settings which will recolourise the output based on properties of the stream.
@@ -457,6 +527,21 @@ VC2HQDECODE_API void vc2decode_init(void);
  */
 VC2HQDECODE_API void vc2decode_init_logging(VC2DecoderLoggers);
 
+/**
+ * This function creates a pool of threads which is shared by every decoder in the process which sets
+ * use_shared_pool in its parameters. It may be called only once, and the pool lasts until the process exits.
+ *
+ * Paramaters:
+ *   threads:         the number of threads in the pool, which is the most the decoders will use between them.
+ *   numa_first_node: as in VC2DecoderParamsUser.
+ *   spin_us:         as thread_spin_us in VC2DecoderParamsUser.
+ *
+ * Return Values:
+ *   VC2DECODER_OK: The pool has been created.
+ *   VC2DECODER_BADPARAMS: The pool already exists or threads is less than one.
+ */
+VC2HQDECODE_API VC2DecoderResult vc2decode_init_shared_pool(int threads, int numa_first_node, int spin_us);
+
 /**
  * This function is used by the host application to create a new decoder, which
  * will be represented by the opaque VC2DecoderHandle data type. A single
@@ -553,6 +638,32 @@ VC2HQDECODE_API VC2DecoderResult vc2decode_get_output_format(VC2DecoderHandle ha
  */
 VC2HQDECODE_API VC2DecoderResult vc2decode_decode_one_picture(VC2DecoderHandle handle, char **idata, int ilength, uint16_t **odata, int *ostride, int skip_aux);
 
+/**
+ * This function behaves in the same way as vc2decode_decode_one_picture except that when a picture is found
+ * it returns VC2DECODER_OK_PICTURE as soon as the picture has been handed over to the decoder's threads,
+ * rather than once it has been decoded. This lets the decoder parse the next picture in the stream whilst
+ * earlier ones are still being decoded. Up to pipeline_depth pictures may be in flight at once, and if another
+ * is started this function first waits for the oldest to complete.
+ *
+ * Decoded pictures must be collected with vc2decode_finish_one_picture. The input data and output buffers for
+ * a picture must remain valid until it has been collected.
+ */
+VC2HQDECODE_API VC2DecoderResult vc2decode_start_one_picture(VC2DecoderHandle handle, char **idata, int ilength, uint16_t **odata, int *ostride, int skip_aux);
+
+/**
+ * This function collects pictures started with vc2decode_start_one_picture in the order they were started,
+ * waiting for the oldest one to finish decoding if need be.
+ *
+ * Paramaters:
+ *   odata:    an array of three pointers which will be set to the output data pointers the picture was started with.
+ *
+ * Return Values:
+ *   VC2DECODER_OK_PICTURE: A picture has been succesfully decoded.
+ *   VC2DECODER_OK: There are no pictures left to collect.
+ *   VC2DECODER_DECODE_FAILED: The picture could not be decoded, odata is still set.
+ */
+VC2HQDECODE_API VC2DecoderResult vc2decode_finish_one_picture(VC2DecoderHandle handle, uint16_t **odata);
+
 /**
  * This function is used to extract metadata from the decoder, which will be accurate at the time it is extracted. This includes
  * all the information present in the most recent VC-2 Sequence Header.
@@ -28,6 +28,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "lut.hpp"
 #include "datastructures.hpp"
@@ -46,6 +47,106 @@ typedef void (*SliceDecoderFunc)(QuantisationMatrix *matrices,
 
 typedef SliceDecoderFunc (*GetSliceDecoderFunc)(int sample_size);
 
+/* Where each coefficient of a slice component goes, in the order they are coded, and the
+   coefficient after the last of each subband. Subband 0 is the DC band, subband 3*(l - 1) + s
+   is subband s of level l. Positions are kept as rows and columns since the planes of different
+   jobs have different strides, so one table serves every slice of the same shape. */
+struct FusedPlacement {
+  FusedPlacement(int slice_width, int slice_height, int depth) {
+    length = slice_width*slice_height;
+    x = new uint16_t[length];
+    y = new uint16_t[length];
+
+    int n = 0;
+    int skip = 1 << depth;
+    place(n, 0, 0, skip, slice_width, slice_height);
+    band_end[0] = n;
+
+    for (int l = 1; l <= depth; l++) {
+      place(n, skip/2, 0, skip, slice_width, slice_height);
+      band_end[3*(l - 1) + 1] = n;
+      place(n, 0, skip/2, skip, slice_width, slice_height);
+      band_end[3*(l - 1) + 2] = n;
+      place(n, skip/2, skip/2, skip, slice_width, slice_height);
+      band_end[3*(l - 1) + 3] = n;
+      skip /= 2;
+    }
+  }
+
+  ~FusedPlacement() {
+    delete[] x;
+    delete[] y;
+  }
+
+  uint16_t *x;
+  uint16_t *y;
+  int band_end[3*MAX_DWT_DEPTH + 1];
+  int length;
+
+private:
+  void place(int &n, int x0, int y0, int skip, int slice_width, int slice_height) {
+    for (int j = y0; j < slice_height; j += skip) {
+      for (int i = x0; i < slice_width; i += skip) {
+        x[n] = i;
+        y[n] = j;
+        n++;
+      }
+    }
+  }
+};
+
+/* Slice decoders which dequantise as they decode, so need no scratch space or dequantisers,
+   but are given the placement for each component's slices instead */
+typedef void (*FusedSliceDecoderFunc)(QuantisationMatrix *matrices,
+                                      CodedSlice * const input,
+                                      int n_slices_x,
+                                      int n_slices_y,
+                                      VideoPlane **video_data,
+                                      int slice_width,
+                                      int slice_height,
+                                      int depth,
+                                      FusedPlacement **placement);
+
+typedef FusedSliceDecoderFunc (*GetFusedSliceDecoderFunc)(int sample_size);
+
+/* Slice decoders are given scratch space for this many slices at once, component c
+   of the k-th in scratch[3*k + c], so that they can decode neighbouring slices together */
+#define VLC_SCRATCH_SLICES 2
+
+/* A slice component with no coded data decodes to all zeros, so its part of the plane is
+   cleared rather than being put through the VLC and dequantiser */
+template<class T> inline void clear_slice(T *odata, int ostride, int width, int height) {
+  for (int y = 0; y < height; y++)
+    memset(&odata[y*ostride], 0, width*sizeof(T));
+}
+
+/* Where the slice at (x, y) of a plane is written: the place in the plane itself, or for planes held a
+   subband at a time the array of places in each subband, filled in from bands */
+template<class T> inline void *slice_output(VideoPlane *plane, int x, int y, T **bands) {
+  if (plane->depth == 0)
+    return &plane->as<T>()[y*plane->stride + x];
+
+  y += plane->y_offset;
+  for (int b = 0; b < 3*plane->depth + 1; b++) {
+    const int shift = (b == 0) ? plane->depth : plane->depth - (b + 2)/3 + 1;
+    bands[b] = &plane->subband<T>(b)[(y >> shift)*plane->stride + (x >> shift)];
+  }
+  return bands;
+}
+
+template<class T> inline void clear_slice_output(VideoPlane *plane, void *optr, int width, int height) {
+  if (plane->depth == 0) {
+    clear_slice<T>((T *)optr, plane->stride, width, height);
+    return;
+  }
+
+  T **bands = (T **)optr;
+  for (int b = 0; b < 3*plane->depth + 1; b++) {
+    const int shift = (b == 0) ? plane->depth : plane->depth - (b + 2)/3 + 1;
+    clear_slice<T>(bands[b], plane->stride, width >> shift, height >> shift);
+  }
+}
+
 /* These are noddy implementations used only in decoding configuration data */
 inline bool     read_bool(uint8_t *&data, int &bitnum, const uint8_t *end) {
   if (data >= end)
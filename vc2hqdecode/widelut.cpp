@@ -0,0 +1,105 @@
+/*****************************************************************************
+ * widelut.cpp : Wide Variable Length Decoding table
+ *****************************************************************************
+ * Copyright (C) 2014-2015 BBC
+ *
+ * Authors: James P. Weaver <james.barrett@bbc.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at ipstudio@bbc.co.uk.
+ *****************************************************************************/
+
+#include "lut.hpp"
+#include <string.h>
+
+static WideLUTEntry WIDEVLCLUT[4 << WIDE_VLC_BITS];
+
+/* Works out the entry for the given state followed by the top bit first bits, in the
+   same form as the entries in VLCLUT. The first value is the end of the coefficient
+   in progress, whose bits so far are carried in V, the rest are whole coefficients. */
+static void build_lut_entry(uint8_t state, int bits, int nbits, WideLUTEntry &E) {
+  memset(&E, 0, sizeof(WideLUTEntry));
+  E.sgn = 1;
+
+  bool first = true;
+  int32_t V = 0;
+  int n = 0;
+  for (int i = nbits - 1; i >= 0; i--) {
+    const int bit = (bits >> i)&0x1;
+    switch (state) {
+    case STATE_START:
+      if (bit) {
+        if (first)
+          E.sgn = 0;
+        else
+          E.val[n] = 0;
+        first = false;
+        n++;
+        V = 0;
+      } else {
+        if (first) {
+          E.preshift++;
+          E.val[0] = 1;
+        } else {
+          V = 1;
+        }
+        state = STATE_DATA;
+      }
+      break;
+    case STATE_FOLLOW:
+      state = bit ? STATE_SIGN : STATE_DATA;
+      break;
+    case STATE_DATA:
+      if (first) {
+        E.preshift++;
+        E.val[0] = E.val[0]*2 + bit;
+      } else {
+        V = V*2 + bit;
+      }
+      state = STATE_FOLLOW;
+      break;
+    case STATE_SIGN:
+      if (first)
+        E.sgn = bit ? -1 : 1;
+      else
+        E.val[n] = (bit ? -1 : 1)*(V - 1);
+      first = false;
+      n++;
+      V = 0;
+      state = STATE_START;
+      break;
+    }
+  }
+
+  E.state = state;
+  E.term  = first ? 0 : 1;
+  E.V     = V;
+  E.N     = n;
+}
+
+static bool build_wide_vlc_lut() {
+  for (int state = 0; state < 4; state++)
+    for (int bits = 0; bits < (1 << WIDE_VLC_BITS); bits++)
+      build_lut_entry(state, bits, WIDE_VLC_BITS, WIDEVLCLUT[(state << WIDE_VLC_BITS) + bits]);
+  return true;
+}
+
+const WideLUTEntry *wide_vlc_lut() {
+  static const bool built = build_wide_vlc_lut();
+  (void)built;
+  return WIDEVLCLUT;
+}
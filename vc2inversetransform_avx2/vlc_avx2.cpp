@@ -0,0 +1,476 @@
+/*****************************************************************************
+ * vlc_avx2.cpp : Variable Length Decoding functions: AVX2 version
+ *****************************************************************************
+ * Copyright (C) 2014-2015 BBC
+ *
+ * Authors: James P. Weaver <james.barrett@bbc.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at ipstudio@bbc.co.uk.
+ *****************************************************************************/
+
+#include "logger.hpp"
+#include "internal.h"
+#include "vlc.hpp"
+#include "platform_variant.hpp"
+#include "../vc2inversetransform_c/vlc_c.hpp"
+#include <cstdio>
+#include <string.h>
+#include <immintrin.h>
+
+
+/* Writes out the eight coefficients of a LUT entry, with the first given separately. The values sit in
+   the top four bytes of the entry, so shifting it down three bytes lines them up behind the first, and
+   they're widened to the size of the plane's samples and written with a single store */
+template<class T> inline void store_step_avx2(T *odata, const CompactLUTEntry &E, int32_t first);
+
+template<> inline void store_step_avx2<int32_t>(int32_t *odata, const CompactLUTEntry &E, int32_t first) {
+  __m256i D = _mm256_cvtepi8_epi32(_mm_srli_epi64(_mm_loadl_epi64((__m128i *)&E), 24));
+  D = _mm256_blend_epi32(D, _mm256_castsi128_si256(_mm_cvtsi32_si128(first)), 0x01);
+  _mm256_storeu_si256((__m256i *)odata, D);
+}
+
+template<> inline void store_step_avx2<int16_t>(int16_t *odata, const CompactLUTEntry &E, int32_t first) {
+  __m128i D = _mm_cvtepi8_epi16(_mm_srli_epi64(_mm_loadl_epi64((__m128i *)&E), 24));
+  D = _mm_insert_epi16(D, first, 0);
+  _mm_storeu_si128((__m128i *)odata, D);
+}
+
+/* Writes out eight zero coefficients */
+template<class T> inline void store_zeros_avx2(T *odata);
+
+template<> inline void store_zeros_avx2<int32_t>(int32_t *odata) {
+  _mm256_storeu_si256((__m256i *)odata, _mm256_setzero_si256());
+}
+
+template<> inline void store_zeros_avx2<int16_t>(int16_t *odata) {
+  _mm_storeu_si128((__m128i *)odata, _mm_setzero_si128());
+}
+
+/* A single step of the state machine, consumes one byte and writes out up to eight coefficients */
+template<class T> inline void step_avx2(const CompactLUTEntry *LUT, const CompactLUTEntry *&next, uint8_t byte, int32_t &V, T *odata, int &ocounter) {
+  const CompactLUTEntry &E = *next;
+  next  = &LUT[(((int)E.state) << 8) + byte];
+
+  V <<= E.preshift_sgn & 0x1F;
+  V |=  E.val0;
+
+  store_step_avx2<T>(&odata[ocounter], E, (V - 1)*(((int8_t)E.preshift_sgn) >> 6));
+
+  if (E.N_V & 0xF)
+    V = E.N_V >> 4;
+  ocounter += E.N_V & 0xF;
+}
+
+/* Coded data which ends in 0xFF bytes decodes the same as if they were missing, since missing
+   bytes are read as all ones. Counts how many there are at the end, 32 bytes at a time. */
+inline int trailing_ones_avx2(uint8_t *idata, int ilength) {
+  const __m256i ONES = _mm256_set1_epi8(-1);
+  int n = ilength;
+  for (; n >= 32; n -= 32) {
+    const unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *)&idata[n - 32]), ONES));
+    if (mask != 0xFFFFFFFF)
+      return ilength - n + __builtin_clz(~mask);
+  }
+  while (n > 0 && idata[n - 1] == 0xFF)
+    n--;
+  return ilength - n;
+}
+
+/* Carries on decoding a component from part way through. Everything after the first coded
+   bytes is 0xFF, and once the state machine is back at the start each of those bytes is eight
+   zeros, so they are written out a byte's worth to a store rather than stepped through. */
+template<class T> inline int decode_avx2_from(const CompactLUTEntry *LUT, uint8_t *idata, int ilength, int coded, int icounter, T *odata, int olength, int ocounter, int32_t V, const CompactLUTEntry *next) {
+  int state;
+
+  while (icounter < coded && ocounter < olength)
+    step_avx2(LUT, next, idata[icounter++], V, odata, ocounter);
+
+  while (icounter < ilength && ocounter < olength && next != &LUT[0xFF])
+    step_avx2(LUT, next, idata[icounter++], V, odata, ocounter);
+
+  if (icounter < ilength && ocounter < olength) {
+    int run = (olength - ocounter + 7)/8;
+    if (run > ilength - icounter)
+      run = ilength - icounter;
+    for (int i = 0; i < run; i++)
+      store_zeros_avx2<T>(&odata[ocounter + 8*i]);
+    icounter += run;
+    ocounter += 8*run;
+  }
+
+  if (icounter < ilength) {
+    return ilength - icounter;
+  }
+
+  if (ocounter < olength) {
+    state = next->state;
+    step_avx2(LUT, next, 0, V, odata, ocounter);
+  }
+
+  if (ocounter < olength) {
+    int32_t last = 0;
+    switch (state) {
+    case STATE_DATA:
+      V <<= 1;
+      V += 1;
+    case STATE_FOLLOW:
+    case STATE_SIGN:
+      last = -(V - 1);
+    }
+    store_zeros_avx2<T>(&odata[ocounter]);
+    odata[ocounter] = last;
+    ocounter += 8;
+  }
+
+  for (; ocounter < olength; ocounter += 8)
+    store_zeros_avx2<T>(&odata[ocounter]);
+
+  return 0;
+}
+
+/* Decodes several components at once, stepping each in turn so that their LUT lookups
+   overlap instead of each waiting on the one before. A component drops out when it is finished. */
+template<class T> inline void decode_interleaved_avx2(const CompactLUTEntry *LUT, int n, uint8_t **idata, int *ilength, T **odata, int *olength, int *padding) {
+  int coded[3*VLC_SCRATCH_SLICES];
+  int icounter[3*VLC_SCRATCH_SLICES];
+  int ocounter[3*VLC_SCRATCH_SLICES];
+  int32_t V[3*VLC_SCRATCH_SLICES];
+  const CompactLUTEntry *next[3*VLC_SCRATCH_SLICES];
+  int live[3*VLC_SCRATCH_SLICES];
+
+  for (int j = 0; j < n; j++) {
+    _mm_prefetch((char *)idata[j], _MM_HINT_T0);
+    _mm_prefetch((char *)odata[j], _MM_HINT_T0);
+    coded[j]    = ilength[j] - trailing_ones_avx2(idata[j], ilength[j]);
+    icounter[j] = 1;
+    ocounter[j] = 0;
+    V[j]        = 0;
+    next[j]     = (ilength[j] > 0) ? &LUT[idata[j][0]] : &LUT[0xFF];
+    live[j]     = j;
+  }
+
+  while (n > 0) {
+    /* No component can run out of input or output within this many steps */
+    int steps = coded[live[0]];
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if (coded[j] - icounter[j] < steps)
+        steps = coded[j] - icounter[j];
+      if ((olength[j] - ocounter[j] + 7)/8 < steps)
+        steps = (olength[j] - ocounter[j] + 7)/8;
+    }
+
+    for (int s = 0; s < steps; s++) {
+      for (int k = 0; k < n; k++) {
+        const int j = live[k];
+        step_avx2(LUT, next[j], idata[j][icounter[j]++], V[j], odata[j], ocounter[j]);
+      }
+    }
+
+    int m = 0;
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if (icounter[j] < coded[j] && ocounter[j] < olength[j])
+        live[m++] = j;
+      else
+        padding[j] = decode_avx2_from(LUT, idata[j], ilength[j], coded[j], icounter[j], odata[j], olength[j], ocounter[j], V[j], next[j]);
+    }
+    n = m;
+  }
+}
+
+
+/* Writes out the twelve coefficients of a wide LUT entry, given as bytes, with the first given separately */
+template<class T> inline void store_wide_step_avx2(T *odata, __m128i X, int32_t first);
+
+template<> inline void store_wide_step_avx2<int32_t>(int32_t *odata, __m128i X, int32_t first) {
+  __m256i D = _mm256_cvtepi8_epi32(X);
+  D = _mm256_blend_epi32(D, _mm256_castsi128_si256(_mm_cvtsi32_si128(first)), 0x01);
+  _mm256_storeu_si256((__m256i *)&odata[0], D);
+  _mm_storeu_si128((__m128i *)&odata[8], _mm_cvtepi8_epi32(_mm_srli_si128(X, 8)));
+}
+
+template<> inline void store_wide_step_avx2<int16_t>(int16_t *odata, __m128i X, int32_t first) {
+  __m256i D = _mm256_cvtepi8_epi16(X);
+  D = _mm256_blend_epi32(D, _mm256_castsi128_si256(_mm_insert_epi16(_mm256_castsi256_si128(D), first, 0)), 0x01);
+  _mm256_storeu_si256((__m256i *)&odata[0], D);
+}
+
+/* A step through the wide table, which takes twelve bits and writes out up to twelve coefficients */
+template<class T> inline void wide_step_avx2(const WideLUTEntry *LUT, uint8_t &state, int bits, int32_t &V, T *odata, int &ocounter) {
+  const WideLUTEntry &E = LUT[(((int)state) << WIDE_VLC_BITS) + bits];
+
+  V <<= E.preshift;
+  V |=  E.val[0];
+
+  store_wide_step_avx2<T>(&odata[ocounter], _mm_loadu_si128((__m128i *)E.val), (V - 1)*E.sgn);
+
+  if (E.term)
+    V = E.V;
+  ocounter += E.N;
+  state = E.state;
+}
+
+/* Takes the next three bytes through the wide table */
+template<class T> inline void wide_steps_avx2(const WideLUTEntry *LUT, uint8_t &state, uint8_t *idata, int32_t &V, T *odata, int &ocounter) {
+  wide_step_avx2(LUT, state, (idata[0] << 4) | (idata[1] >> 4), V, odata, ocounter);
+  wide_step_avx2(LUT, state, ((idata[1]&0xF) << 8) | idata[2], V, odata, ocounter);
+}
+
+/* Carries on a byte at a time from where the wide table left off. A missing byte
+   is read as all ones, which is how the end of the coded data is treated anyway */
+template<class T> inline int decode_avx2_after_wide(uint8_t *idata, int ilength, int coded, int icounter, T *odata, int olength, int ocounter, int32_t V, uint8_t state) {
+  const CompactLUTEntry *LUT = compact_vlc_lut();
+  const CompactLUTEntry *next = &LUT[(((int)state) << 8) + ((icounter < ilength) ? idata[icounter] : 0xFF)];
+  return decode_avx2_from(LUT, idata, ilength, coded, icounter + 1, odata, olength, ocounter, V, next);
+}
+
+/* As decode_interleaved_avx2 but using the wide table, three bytes to a step. A component
+   only takes a step whilst the output can't fill up part way through it, so that the padding
+   comes out the same, and is finished off a byte at a time once it can't. */
+template<class T> inline void decode_interleaved_wide_avx2(const WideLUTEntry *LUT, int n, uint8_t **idata, int *ilength, T **odata, int *olength, int *padding) {
+  int coded[3*VLC_SCRATCH_SLICES];
+  int icounter[3*VLC_SCRATCH_SLICES];
+  int ocounter[3*VLC_SCRATCH_SLICES];
+  int32_t V[3*VLC_SCRATCH_SLICES];
+  uint8_t state[3*VLC_SCRATCH_SLICES];
+  int live[3*VLC_SCRATCH_SLICES];
+
+  for (int j = 0; j < n; j++) {
+    _mm_prefetch((char *)idata[j], _MM_HINT_T0);
+    _mm_prefetch((char *)odata[j], _MM_HINT_T0);
+    coded[j]    = ilength[j] - trailing_ones_avx2(idata[j], ilength[j]);
+    icounter[j] = 0;
+    ocounter[j] = 0;
+    V[j]        = 0;
+    state[j]    = STATE_START;
+    live[j]     = j;
+  }
+
+  while (n > 0) {
+    int steps = coded[live[0]];
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if ((coded[j] - icounter[j])/3 < steps)
+        steps = (coded[j] - icounter[j])/3;
+      if ((olength[j] - ocounter[j] - 1)/24 < steps)
+        steps = (olength[j] - ocounter[j] - 1)/24;
+    }
+
+    for (int s = 0; s < steps; s++) {
+      for (int k = 0; k < n; k++) {
+        const int j = live[k];
+        wide_steps_avx2(LUT, state[j], &idata[j][icounter[j]], V[j], odata[j], ocounter[j]);
+        icounter[j] += 3;
+      }
+    }
+
+    int m = 0;
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if (icounter[j] + 3 <= coded[j] && ocounter[j] + 24 < olength[j])
+        live[m++] = j;
+      else
+        padding[j] = decode_avx2_after_wide(idata[j], ilength[j], coded[j], icounter[j], odata[j], olength[j], ocounter[j], V[j], state[j]);
+    }
+    n = m;
+  }
+}
+
+/* The LUT takes a byte at a time, so a long code takes a step for every few bits of it. Where
+   the codes are long on average they are read a whole code at a time instead. The bits of a
+   code alternate between a follow bit, which is one on the last, and a data bit, so pext
+   splits them apart and the leading zeros of the follow bits give the length. */
+const int BITREADER_MIN_BITS = 10;
+
+/* The 64 bits of coded data from bit p on, the first of them in the top bit. Only the
+   top 57 are certain to be filled. Missing bytes are read as all ones. */
+inline uint64_t bits_at(uint8_t *idata, int ilength, int p) {
+  const int byte = p >> 3;
+  uint64_t w;
+  if (byte + 8 <= ilength) {
+    memcpy(&w, &idata[byte], 8);
+    w = __builtin_bswap64(w);
+  } else {
+    w = 0;
+    for (int i = 0; i < 8; i++)
+      w = (w << 8) | ((byte + i < ilength) ? idata[byte + i] : 0xFF);
+  }
+  return w << (p & 7);
+}
+
+/* Reads the code at bit p, and moves p on past it. A code with more than 28 data bits
+   doesn't fit in one read, so is taken 28 data bits at a time until its end turns up. */
+inline int32_t read_code(uint8_t *idata, int ilength, int &p) {
+  uint32_t V = 1;
+  bool long_code = false;
+  for (;;) {
+    const uint64_t w = bits_at(idata, ilength, p);
+    const uint32_t follow = (uint32_t)_pext_u64(w, 0xAAAAAAAAAAAAAAAAULL);
+    const uint32_t data   = (uint32_t)_pext_u64(w, 0x5555555555555555ULL);
+    if ((follow >> 4) == 0) {
+      V = (V << 28) | (data >> 4);
+      p += 56;
+      long_code = true;
+      continue;
+    }
+
+    /* Zero has no sign bit, and is told apart without a branch as it is too mixed in with the rest to predict */
+    const int k = __builtin_clz(follow);
+    V = (V << k) | (uint32_t)((uint64_t)data >> (32 - k));
+    const uint32_t nonzero = (k > 0) | long_code;
+    const uint32_t sign = (uint32_t)(w >> (62 - 2*k)) & nonzero;
+    p += 2*k + 1 + nonzero;
+    return (int32_t)(((V - 1) ^ (0 - sign)) + sign);
+  }
+}
+
+/* Decodes components a whole code at a time, taking a code from each in turn so that the
+   reads overlap. The padding is worked out from the byte the last coefficient ended in, so
+   comes out the same as it does going through the LUT. */
+template<class T> inline void decode_interleaved_bits_avx2(int n, uint8_t **idata, int *ilength, T **odata, int *olength, int *padding) {
+  int p[3*VLC_SCRATCH_SLICES];
+  int ocounter[3*VLC_SCRATCH_SLICES];
+
+  for (int j = 0; j < n; j++) {
+    _mm_prefetch((char *)idata[j], _MM_HINT_T0);
+    p[j]        = 0;
+    ocounter[j] = 0;
+  }
+
+  int steps = (n > 0) ? olength[0] : 0;
+  for (int j = 0; j < n; j++)
+    if (olength[j] < steps)
+      steps = olength[j];
+
+  for (int s = 0; s < steps; s++)
+    for (int j = 0; j < n; j++)
+      odata[j][ocounter[j]++] = read_code(idata[j], ilength[j], p[j]);
+
+  for (int j = 0; j < n; j++) {
+    while (ocounter[j] < olength[j] && p[j] < 8*ilength[j])
+      odata[j][ocounter[j]++] = read_code(idata[j], ilength[j], p[j]);
+
+    if (ocounter[j] < olength[j]) {
+      for (; ocounter[j] + 8 <= olength[j]; ocounter[j] += 8)
+        store_zeros_avx2<T>(&odata[j][ocounter[j]]);
+      for (; ocounter[j] < olength[j]; ocounter[j]++)
+        odata[j][ocounter[j]] = 0;
+      padding[j] = 0;
+    } else {
+      const int last = (p[j] - 1) >> 3;
+      padding[j] = (ilength[j] - last - 2 > 0) ? (ilength[j] - last - 2) : 0;
+    }
+  }
+}
+
+template<class T, bool WIDE> void decode_slices_avx2(QuantisationMatrix *matrices,
+                                          CodedSlice * const input,
+                                          DecodedSlice ** scratch,
+                                          int n_slices_x,
+                                          int n_slices_y,
+                                          VideoPlane **video_data,
+                                          int slice_width,
+                                          int slice_height,
+                                          int depth,
+                                          DequantiseFunction *dequant) {
+  const WideLUTEntry *LUT = WIDE ? wide_vlc_lut() : NULL;
+  const CompactLUTEntry *CLUT = compact_vlc_lut();
+  if (!WIDE) {
+    for (int i = 0; i < 4*256*(int)sizeof(CompactLUTEntry); i += 64)
+      _mm_prefetch(((char *)CLUT) + i, _MM_HINT_T0);
+  }
+  T *bands[3*MAX_DWT_DEPTH + 1];
+
+  for (int Y = 0; Y < n_slices_y; Y++) {
+    for (int X = 0; X < n_slices_x; X += VLC_SCRATCH_SLICES) {
+      const int K = (n_slices_x - X < VLC_SCRATCH_SLICES) ? (n_slices_x - X) : VLC_SCRATCH_SLICES;
+      uint8_t *idata[3*VLC_SCRATCH_SLICES];
+      int ilength[3*VLC_SCRATCH_SLICES];
+      T *odata[3*VLC_SCRATCH_SLICES];
+      int olength[3*VLC_SCRATCH_SLICES];
+      int padding[3*VLC_SCRATCH_SLICES + 1];
+      int slot[3*VLC_SCRATCH_SLICES];
+
+      /* Components going through the LUT are gathered at the front, those read a code at a time at the back.
+         Components with no coded data are left out, and given the spare slot at the end which has no padding. */
+      int m = 0;
+      int b = 3*K;
+      padding[3*VLC_SCRATCH_SLICES] = 0;
+      for (int k = 0; k < K; k++) {
+        const int n = Y*n_slices_x + X + k;
+        for (int c = 0; c < 3; c++) {
+          if (input[n].length[c] == 0) {
+            slot[3*k + c] = 3*VLC_SCRATCH_SLICES;
+            continue;
+          }
+          const int j = (input[n].length[c]*8 >= BITREADER_MIN_BITS*scratch[3*k + c]->size) ? --b : m++;
+          slot[3*k + c] = j;
+          idata[j]   = (uint8_t *)input[n].data[c];
+          ilength[j] = input[n].length[c];
+          odata[j]   = scratch[3*k + c]->as<T>();
+          olength[j] = scratch[3*k + c]->size;
+          padding[j] = 0;
+        }
+      }
+      if (WIDE)
+        decode_interleaved_wide_avx2(LUT, m, idata, ilength, odata, olength, padding);
+      else
+        decode_interleaved_avx2(CLUT, m, idata, ilength, odata, olength, padding);
+      decode_interleaved_bits_avx2<T>(3*K - b, &idata[b], &ilength[b], &odata[b], &olength[b], &padding[b]);
+
+      for (int k = 0; k < K; k++) {
+        const int n = Y*n_slices_x + X + k;
+        _mm_prefetch((char *)&matrices[input[n].qindex], _MM_HINT_T0);
+        for (int c = 0; c < 3; c++) {
+          const int w = (c == 0) ? slice_width : slice_width/2;
+          void *optr = slice_output<T>(video_data[c], (X + k)*w, Y*slice_height, bands);
+          if (input[n].length[c] == 0) {
+            clear_slice_output<T>(video_data[c], optr, w, slice_height);
+          } else {
+            _mm_prefetch((char *)optr, _MM_HINT_T0);
+            dequant[c](&matrices[input[n].qindex], scratch[3*k + c]->data, optr, video_data[c]->stride,
+                       w, slice_height, depth);
+          }
+        }
+
+        input[n].padding = padding[slot[3*k + 0]] + padding[slot[3*k + 1]] + padding[slot[3*k + 2]];
+      }
+    }
+  }
+}
+
+SliceDecoderFunc get_slice_decoder_avx2(int sample_size) {
+  if (sample_size == 4) {
+    return decode_slices_avx2<int32_t, false>;
+  } else if (sample_size == 2) {
+    return decode_slices_avx2<int16_t, false>;
+  }
+
+  return get_slice_decoder_c(sample_size);
+}
+
+SliceDecoderFunc get_wide_slice_decoder_avx2(int sample_size) {
+  if (sample_size == 4) {
+    return decode_slices_avx2<int32_t, true>;
+  } else if (sample_size == 2) {
+    return decode_slices_avx2<int16_t, true>;
+  }
+
+  return get_slice_decoder_c(sample_size);
+}
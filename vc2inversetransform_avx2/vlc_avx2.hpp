@@ -0,0 +1,36 @@
+/*****************************************************************************
+ * vlc_avx2.hpp : Variable Length Decoding header: AVX2 version
+ *****************************************************************************
+ * Copyright (C) 2014-2015 BBC
+ *
+ * Authors: James P. Weaver <james.barrett@bbc.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at ipstudio@bbc.co.uk.
+ *****************************************************************************/
+
+#ifndef __VLC_AVX2_HPP__
+#define __VLC_AVX2_HPP__
+
+#include "vlc.hpp"
+
+SliceDecoderFunc get_slice_decoder_avx2(int sample_size);
+SliceDecoderFunc get_wide_slice_decoder_avx2(int sample_size);
+
+
+
+#endif /* __VLC_AVX2_HPP__ */
@@ -33,10 +33,11 @@ template <int slice_width,
           int slice_height,
           int depth,
           class T> void dequantise_c(QuantisationMatrix *qmatrix,
-                                     int32_t *idata,
+                                     void *_idata,
                                      void *_odata,
                                      int ostride,
                                      int, int, int) {
+  const T *idata = (const T *)_idata;
   T *odata = (T *)_odata;
 
   const int Y = 0;
@@ -44,7 +45,7 @@ template <int slice_width,
   const int N = 0;
 
   T * const optr = &odata[Y*slice_height*ostride + X*slice_width];
-  const int32_t * iptr = &idata[N*slice_height*slice_width];
+  const T * iptr = &idata[N*slice_height*slice_width];
 
   int skip = 1 << depth;
   int32_t qf = *(int32_t *)&qmatrix->qfactor[0][0];
@@ -89,12 +90,13 @@ template <int slice_width,
 }
 
 template<class T> void dequantise_fallback_c(QuantisationMatrix *qmatrix,
-                                             int32_t *idata,
+                                             void *_idata,
                                              void *_odata,
                                              int ostride,
                                              int slice_width,
                                              int slice_height,
                                              int depth) {
+  const T *idata = (const T *)_idata;
   T *odata = (T *)_odata;
 
   const int Y = 0;
@@ -102,7 +104,7 @@ template<class T> void dequantise_fallback_c(QuantisationMatrix *qmatrix,
   const int N = 0;
 
   T * const optr = &odata[Y*slice_height*ostride + X*slice_width];
-  const int32_t * iptr = &idata[N*slice_height*slice_width];
+  const T * iptr = &idata[N*slice_height*slice_width];
 
   int skip = 1 << depth;
   int32_t qf = *(int32_t *)&qmatrix->qfactor[0][0];
@@ -146,6 +148,40 @@ template<class T> void dequantise_fallback_c(QuantisationMatrix *qmatrix,
   }
 }
 
+/* For planes held a subband at a time, so the coefficients of each subband are copied out to their own
+   place in the plane in the order they are coded */
+template<class T> void dequantise_subbands_c(QuantisationMatrix *qmatrix,
+                                             void *_idata,
+                                             void *_odata,
+                                             int ostride,
+                                             int slice_width,
+                                             int slice_height,
+                                             int depth) {
+  const T *iptr = (const T *)_idata;
+  T **bands = (T **)_odata;
+
+  int w = slice_width >> depth;
+  int h = slice_height >> depth;
+  for (int b = 0; b < 3*depth + 1; b++) {
+    const int l = (b + 2)/3;
+    const int s = (b == 0) ? 0 : (b - 1)%3 + 1;
+    const int32_t qf = *(int32_t *)&qmatrix->qfactor[l][s];
+    const int32_t qo = *(int32_t *)&qmatrix->qoffset[l][s];
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        int32_t D = *iptr++;
+        bands[b][y*ostride + x] = sgn(D)*(((abs(D)*qf) + qo) >> 2);
+      }
+    }
+
+    /* The subbands of each level after the first are twice the size of those before */
+    if (b > 0 && s == 3) {
+      w *= 2;
+      h *= 2;
+    }
+  }
+}
+
 DequantiseFunction getDequantiseFunction_c(int slice_width,
                                            int slice_height,
                                            int depth,
@@ -193,3 +229,16 @@ DequantiseFunction getDequantiseFunction_c(int slice_width,
   writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
   throw VC2DECODER_NOTIMPLEMENTED;
 }
+
+DequantiseFunction getSubbandDequantiseFunction_c(int,
+                                                  int,
+                                                  int,
+                                                  int sample_size) {
+  if (sample_size == 4)
+    return dequantise_subbands_c<int32_t>;
+  else if (sample_size == 2)
+    return dequantise_subbands_c<int16_t>;
+
+  writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
+  throw VC2DECODER_NOTIMPLEMENTED;
+}
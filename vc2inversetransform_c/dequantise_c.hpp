@@ -34,4 +34,8 @@ VC2EXPORT DequantiseFunction getDequantiseFunction_c(int slice_width,
                                                      int slice_height,
                                                      int depth,
                                                      int sample_size);
+VC2EXPORT DequantiseFunction getSubbandDequantiseFunction_c(int slice_width,
+                                                            int slice_height,
+                                                            int depth,
+                                                            int sample_size);
 #endif /* __DEQUANTISE_C_CPP__ */
@@ -24,6 +24,8 @@
  * For more information, contact us at ipstudio@bbc.co.uk.
  *****************************************************************************/
 
+#include <string.h>
+
 #define MIN(A,B) (((A)>(B))?(B):(A))
 #define MAX(A,B) (((A)<(B))?(B):(A))
 
@@ -107,3 +109,156 @@ template<int shift, int active_bits, class T> void Haar_invtransform_H_final_1(v
     }
   }
 }
+
+/* The subband layout versions of the above. The even rows or columns are those of the low pass subband
+   and the odd ones those of the high pass subband. */
+template<class T>void Haar_invtransform_V_subbands(void *_ldata,
+                                                   const int lstride,
+                                                   void *_hdata,
+                                                   const int hstride,
+                                                   const int width,
+                                                   const int height) {
+  for (int y = 0; y < height; y++) {
+    T *L = &((T *)_ldata)[y*lstride];
+    T *H = &((T *)_hdata)[y*hstride];
+    for (int x = 0; x < width; x++) {
+      int32_t X   = L[x] - (( H[x] + 1 ) >> 1 );
+      int32_t Xp1 = H[x] + X;
+
+      L[x] = X;
+      H[x] = Xp1;
+    }
+  }
+}
+
+/* The same transforms where the high pass subband is known to be zero, which is never read */
+template<class T>void Haar_invtransform_V_subbands_zero_high(void *_ldata,
+                                                             const int lstride,
+                                                             void *_hdata,
+                                                             const int hstride,
+                                                             const int width,
+                                                             const int height) {
+  for (int y = 0; y < height; y++)
+    memcpy(&((T *)_hdata)[y*hstride], &((const T *)_ldata)[y*lstride], width*sizeof(T));
+}
+
+template<int shift, class T>void Haar_invtransform_H_subbands_zero_high(const void *_ldata,
+                                                                        const int lstride,
+                                                                        const void *,
+                                                                        const int,
+                                                                        void *_odata,
+                                                                        const int ostride,
+                                                                        const int width,
+                                                                        const int height) {
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    T *odata = &((T *)_odata)[y*ostride];
+    for (int x = 0; x < width; x++) {
+      int32_t X = L[x];
+
+      if (shift != 0) {
+        X   +=  (1 << (shift - 1));
+        X   >>= shift;
+      }
+
+      odata[2*x + 0] = X;
+      odata[2*x + 1] = X;
+    }
+  }
+}
+
+template<int shift, class T>void Haar_invtransform_H_subbands(const void *_ldata,
+                                                              const int lstride,
+                                                              const void *_hdata,
+                                                              const int hstride,
+                                                              void *_odata,
+                                                              const int ostride,
+                                                              const int width,
+                                                              const int height) {
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    const T *H = &((const T *)_hdata)[y*hstride];
+    T *odata = &((T *)_odata)[y*ostride];
+    for (int x = 0; x < width; x++) {
+      int32_t X   = L[x] - (( H[x] + 1 ) >> 1 );
+      int32_t Xp1 = H[x] + X;
+
+      if (shift != 0) {
+        X   +=  (1 << (shift - 1));
+        X   >>= shift;
+        Xp1 +=  (1 << (shift - 1));
+        Xp1 >>= shift;
+      }
+
+      odata[2*x + 0] = X;
+      odata[2*x + 1] = Xp1;
+    }
+  }
+}
+
+template<int shift, int active_bits, class T> void Haar_invtransform_H_subbands_final(const void *_ldata,
+                                                                                      const int lstride,
+                                                                                      const void *_hdata,
+                                                                                      const int hstride,
+                                                                                      const char *odata,
+                                                                                      const int ostride,
+                                                                                      const int,
+                                                                                      const int height,
+                                                                                      const int ooffset_x,
+                                                                                      const int owidth) {
+  const int32_t clip = (1 << active_bits) - 1;
+  const int32_t offset = 1 << (active_bits - 1);
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    const T *H = &((const T *)_hdata)[y*hstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride];
+    for (int x = ooffset_x/2; 2*x < ooffset_x + owidth; x++) {
+      int32_t X   = L[x] - (( H[x] + 1 ) >> 1 );
+      int32_t Xp1 = H[x] + X;
+
+      if (shift != 0) {
+        X   +=  (1 << (shift - 1));
+        X   >>= shift;
+        Xp1 +=  (1 << (shift - 1));
+        Xp1 >>= shift;
+      }
+
+      if (2*x >= ooffset_x)
+        optr[2*x - ooffset_x + 0] = (uint16_t)MIN(MAX((X + offset), 0), clip);
+      if (2*x + 1 < ooffset_x + owidth)
+        optr[2*x - ooffset_x + 1] = (uint16_t)MIN(MAX((Xp1 + offset), 0), clip);
+    }
+  }
+}
+
+template<int shift, int active_bits, class T> void Haar_invtransform_H_subbands_final_zero_high(const void *_ldata,
+                                                                                                const int lstride,
+                                                                                                const void *,
+                                                                                                const int,
+                                                                                                const char *odata,
+                                                                                                const int ostride,
+                                                                                                const int,
+                                                                                                const int height,
+                                                                                                const int ooffset_x,
+                                                                                                const int owidth) {
+  const int32_t clip = (1 << active_bits) - 1;
+  const int32_t offset = 1 << (active_bits - 1);
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride];
+    for (int x = ooffset_x/2; 2*x < ooffset_x + owidth; x++) {
+      int32_t X = L[x];
+
+      if (shift != 0) {
+        X   +=  (1 << (shift - 1));
+        X   >>= shift;
+      }
+
+      X = MIN(MAX((X + offset), 0), clip);
+      if (2*x >= ooffset_x)
+        optr[2*x - ooffset_x + 0] = (uint16_t)X;
+      if (2*x + 1 < ooffset_x + owidth)
+        optr[2*x - ooffset_x + 1] = (uint16_t)X;
+    }
+  }
+}
@@ -436,3 +436,150 @@ InplaceTransformFinal get_invhtransformfinal_c(int wavelet_index, int active_bit
   writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
   throw VC2DECODER_NOTIMPLEMENTED;
 }
+
+/* The subband layout transforms are only provided for some wavelets, and NULL is returned for the others */
+template<class T> static SubbandTransformV invvtransform_subbands_c(int wavelet_index) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    return LeGall_5_3_invtransform_V_subbands<T>;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    return Haar_invtransform_V_subbands<T>;
+  default:
+    return NULL;
+  }
+}
+
+template<class T> static SubbandTransformH invhtransform_subbands_c(int wavelet_index) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    return LeGall_5_3_invtransform_H_subbands<T>;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+    return Haar_invtransform_H_subbands<0, T>;
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    return Haar_invtransform_H_subbands<1, T>;
+  default:
+    return NULL;
+  }
+}
+
+template<int active_bits, class T> static SubbandTransformFinal invhtransformfinal_subbands_c(int wavelet_index) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    return LeGall_5_3_invtransform_H_subbands_final<active_bits, T>;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+    return Haar_invtransform_H_subbands_final<0, active_bits, T>;
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    return Haar_invtransform_H_subbands_final<1, active_bits, T>;
+  default:
+    return NULL;
+  }
+}
+
+template<class T> static SubbandTransformV invvtransform_subbands_zero_high_c(int wavelet_index) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    return LeGall_5_3_invtransform_V_subbands_zero_high<T>;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    return Haar_invtransform_V_subbands_zero_high<T>;
+  default:
+    return NULL;
+  }
+}
+
+template<class T> static SubbandTransformH invhtransform_subbands_zero_high_c(int wavelet_index) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    return LeGall_5_3_invtransform_H_subbands_zero_high<T>;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+    return Haar_invtransform_H_subbands_zero_high<0, T>;
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    return Haar_invtransform_H_subbands_zero_high<1, T>;
+  default:
+    return NULL;
+  }
+}
+
+template<int active_bits, class T> static SubbandTransformFinal invhtransformfinal_subbands_zero_high_c(int wavelet_index) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    return LeGall_5_3_invtransform_H_subbands_final_zero_high<active_bits, T>;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+    return Haar_invtransform_H_subbands_final_zero_high<0, active_bits, T>;
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    return Haar_invtransform_H_subbands_final_zero_high<1, active_bits, T>;
+  default:
+    return NULL;
+  }
+}
+
+SubbandTransformV get_invvtransform_subbands_c(int wavelet_index, int sample_size) {
+  if (sample_size == 4)
+    return invvtransform_subbands_c<int32_t>(wavelet_index);
+  else if (sample_size == 2)
+    return invvtransform_subbands_c<int16_t>(wavelet_index);
+
+  writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
+  throw VC2DECODER_NOTIMPLEMENTED;
+}
+
+SubbandTransformH get_invhtransform_subbands_c(int wavelet_index, int sample_size) {
+  if (sample_size == 4)
+    return invhtransform_subbands_c<int32_t>(wavelet_index);
+  else if (sample_size == 2)
+    return invhtransform_subbands_c<int16_t>(wavelet_index);
+
+  writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
+  throw VC2DECODER_NOTIMPLEMENTED;
+}
+
+SubbandTransformFinal get_invhtransformfinal_subbands_c(int wavelet_index, int active_bits, int sample_size) {
+  if (active_bits != 10 && active_bits != 12) {
+    writelog(LOG_ERROR, "%s:%d:  Invalid bit depth\n", __FILE__, __LINE__);
+    throw VC2DECODER_NOTIMPLEMENTED;
+  }
+
+  if (sample_size == 4)
+    return (active_bits == 10) ? invhtransformfinal_subbands_c<10, int32_t>(wavelet_index) : invhtransformfinal_subbands_c<12, int32_t>(wavelet_index);
+  else if (sample_size == 2)
+    return (active_bits == 10) ? invhtransformfinal_subbands_c<10, int16_t>(wavelet_index) : invhtransformfinal_subbands_c<12, int16_t>(wavelet_index);
+
+  writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
+  throw VC2DECODER_NOTIMPLEMENTED;
+}
+
+SubbandTransformV get_invvtransform_subbands_zero_high_c(int wavelet_index, int sample_size) {
+  if (sample_size == 4)
+    return invvtransform_subbands_zero_high_c<int32_t>(wavelet_index);
+  else if (sample_size == 2)
+    return invvtransform_subbands_zero_high_c<int16_t>(wavelet_index);
+
+  writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
+  throw VC2DECODER_NOTIMPLEMENTED;
+}
+
+SubbandTransformH get_invhtransform_subbands_zero_high_c(int wavelet_index, int sample_size) {
+  if (sample_size == 4)
+    return invhtransform_subbands_zero_high_c<int32_t>(wavelet_index);
+  else if (sample_size == 2)
+    return invhtransform_subbands_zero_high_c<int16_t>(wavelet_index);
+
+  writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
+  throw VC2DECODER_NOTIMPLEMENTED;
+}
+
+SubbandTransformFinal get_invhtransformfinal_subbands_zero_high_c(int wavelet_index, int active_bits, int sample_size) {
+  if (active_bits != 10 && active_bits != 12) {
+    writelog(LOG_ERROR, "%s:%d:  Invalid bit depth\n", __FILE__, __LINE__);
+    throw VC2DECODER_NOTIMPLEMENTED;
+  }
+
+  if (sample_size == 4)
+    return (active_bits == 10) ? invhtransformfinal_subbands_zero_high_c<10, int32_t>(wavelet_index) : invhtransformfinal_subbands_zero_high_c<12, int32_t>(wavelet_index);
+  else if (sample_size == 2)
+    return (active_bits == 10) ? invhtransformfinal_subbands_zero_high_c<10, int16_t>(wavelet_index) : invhtransformfinal_subbands_zero_high_c<12, int16_t>(wavelet_index);
+
+  writelog(LOG_ERROR, "%s:%d:  Invalid sample size\n", __FILE__, __LINE__);
+  throw VC2DECODER_NOTIMPLEMENTED;
+}
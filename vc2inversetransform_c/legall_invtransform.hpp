@@ -315,3 +315,163 @@ template<int active_bits, class T> void LeGall_5_3_invtransform_H_final_1(void *
     }
   }
 }
+
+/* The subband layout versions of the above. The even rows or columns are those of the low pass subband
+   and the odd ones those of the high pass subband, which are lifted against each other in the same way. */
+template<class T> void LeGall_5_3_invtransform_V_subbands(void *_ldata,
+                                                          const int lstride,
+                                                          void *_hdata,
+                                                          const int hstride,
+                                                          const int width,
+                                                          const int height) {
+  T *ldata = (T *)_ldata;
+  T *hdata = (T *)_hdata;
+  for (int y = 0; y < height; y++) {
+    T *D = &ldata[y*lstride];
+    const T *Dm1 = &hdata[((y > 0) ? (y - 1) : 0)*hstride];
+    const T *Dp1 = &hdata[y*hstride];
+    for (int x = 0; x < width; x++)
+      D[x] = D[x] - ((Dm1[x] + Dp1[x] + 2) >> 2);
+
+    if (y > 0) {
+      const T *Xm2 = &ldata[(y - 1)*lstride];
+      T *Xm1 = &hdata[(y - 1)*hstride];
+      for (int x = 0; x < width; x++)
+        Xm1[x] = Xm1[x] + ((Xm2[x] + D[x] + 1) >> 1);
+    }
+  }
+
+  const T *X = &ldata[(height - 1)*lstride];
+  T *Xp1 = &hdata[(height - 1)*hstride];
+  for (int x = 0; x < width; x++)
+    Xp1[x] = Xp1[x] + ((X[x] + X[x] + 1) >> 1);
+}
+
+template<class T> void LeGall_5_3_invtransform_H_subbands(const void *_ldata,
+                                                          const int lstride,
+                                                          const void *_hdata,
+                                                          const int hstride,
+                                                          void *_odata,
+                                                          const int ostride,
+                                                          const int width,
+                                                          const int height) {
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    const T *H = &((const T *)_hdata)[y*hstride];
+    T *odata = &((T *)_odata)[y*ostride];
+
+    int32_t X = L[0] - ((H[0] + H[0] + 2) >> 2);
+    int x = 0;
+    for (; x < width - 1; x++) {
+      const int32_t Xp2 = L[x + 1] - ((H[x] + H[x + 1] + 2) >> 2);
+      const int32_t Xp1 = H[x] + ((X + Xp2 + 1) >> 1);
+      odata[2*x + 0] = (X   + 1) >> 1;
+      odata[2*x + 1] = (Xp1 + 1) >> 1;
+      X = Xp2;
+    }
+    const int32_t Xp1 = H[x] + ((X + X + 1) >> 1);
+    odata[2*x + 0] = (X   + 1) >> 1;
+    odata[2*x + 1] = (Xp1 + 1) >> 1;
+  }
+}
+
+/* The same transforms where the high pass subband is known to be zero, which is never read */
+template<class T> void LeGall_5_3_invtransform_V_subbands_zero_high(void *_ldata,
+                                                                    const int lstride,
+                                                                    void *_hdata,
+                                                                    const int hstride,
+                                                                    const int width,
+                                                                    const int height) {
+  const T *ldata = (const T *)_ldata;
+  T *hdata = (T *)_hdata;
+  for (int y = 0; y < height; y++) {
+    const T *X = &ldata[y*lstride];
+    const T *Xp2 = &ldata[((y < height - 1) ? (y + 1) : y)*lstride];
+    T *Xp1 = &hdata[y*hstride];
+    for (int x = 0; x < width; x++)
+      Xp1[x] = (X[x] + Xp2[x] + 1) >> 1;
+  }
+}
+
+template<class T> void LeGall_5_3_invtransform_H_subbands_zero_high(const void *_ldata,
+                                                                    const int lstride,
+                                                                    const void *,
+                                                                    const int,
+                                                                    void *_odata,
+                                                                    const int ostride,
+                                                                    const int width,
+                                                                    const int height) {
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    T *odata = &((T *)_odata)[y*ostride];
+
+    int x = 0;
+    for (; x < width - 1; x++) {
+      const int32_t Xp1 = (L[x] + L[x + 1] + 1) >> 1;
+      odata[2*x + 0] = (L[x] + 1) >> 1;
+      odata[2*x + 1] = (Xp1  + 1) >> 1;
+    }
+    odata[2*x + 0] = (L[x] + 1) >> 1;
+    odata[2*x + 1] = (L[x] + 1) >> 1;
+  }
+}
+
+template<int active_bits, class T> void LeGall_5_3_invtransform_H_subbands_final(const void *_ldata,
+                                                                                 const int lstride,
+                                                                                 const void *_hdata,
+                                                                                 const int hstride,
+                                                                                 const char *odata,
+                                                                                 const int ostride,
+                                                                                 const int width,
+                                                                                 const int height,
+                                                                                 const int ooffset_x,
+                                                                                 const int owidth) {
+  const int32_t clip = (1 << active_bits) - 1;
+  const int32_t offset = 1 << (active_bits - 1);
+
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    const T *H = &((const T *)_hdata)[y*hstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride];
+
+    int x = ooffset_x/2;
+    int32_t X = L[x] - ((H[(x > 0) ? (x - 1) : 0] + H[x] + 2) >> 2);
+    for (; 2*x < ooffset_x + owidth; x++) {
+      const int32_t Xp2 = (x < width - 1) ? (L[x + 1] - ((H[x] + H[x + 1] + 2) >> 2)) : X;
+      const int32_t Xp1 = H[x] + ((X + Xp2 + 1) >> 1);
+      if (2*x >= ooffset_x)
+        optr[2*x - ooffset_x + 0] = (uint16_t)MIN(MAX((((X   + 1) >> 1) + offset), 0), clip);
+      if (2*x + 1 < ooffset_x + owidth)
+        optr[2*x - ooffset_x + 1] = (uint16_t)MIN(MAX((((Xp1 + 1) >> 1) + offset), 0), clip);
+      X = Xp2;
+    }
+  }
+}
+
+template<int active_bits, class T> void LeGall_5_3_invtransform_H_subbands_final_zero_high(const void *_ldata,
+                                                                                           const int lstride,
+                                                                                           const void *,
+                                                                                           const int,
+                                                                                           const char *odata,
+                                                                                           const int ostride,
+                                                                                           const int width,
+                                                                                           const int height,
+                                                                                           const int ooffset_x,
+                                                                                           const int owidth) {
+  const int32_t clip = (1 << active_bits) - 1;
+  const int32_t offset = 1 << (active_bits - 1);
+
+  for (int y = 0; y < height; y++) {
+    const T *L = &((const T *)_ldata)[y*lstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride];
+
+    for (int x = ooffset_x/2; 2*x < ooffset_x + owidth; x++) {
+      const int32_t X = L[x];
+      const int32_t Xp1 = (x < width - 1) ? ((X + L[x + 1] + 1) >> 1) : X;
+      if (2*x >= ooffset_x)
+        optr[2*x - ooffset_x + 0] = (uint16_t)MIN(MAX((((X   + 1) >> 1) + offset), 0), clip);
+      if (2*x + 1 < ooffset_x + owidth)
+        optr[2*x - ooffset_x + 1] = (uint16_t)MIN(MAX((((Xp1 + 1) >> 1) + offset), 0), clip);
+    }
+  }
+}
@@ -94,7 +94,7 @@ void decode_simple(uint8_t *idata, int ilength, int32_t *odata, int olength) {
   }
 }
 
-inline int decode_c(uint8_t *idata, int ilength, int32_t *odata, int olength) {
+template<class T> inline int decode_c(uint8_t *idata, int ilength, T *odata, int olength) {
   int icounter = 1;
   int ocounter = 0;
   int32_t V = 0;
@@ -153,6 +153,10 @@ inline int decode_c(uint8_t *idata, int ilength, int32_t *odata, int olength) {
   }
 
   if (ocounter < olength) {
+    odata[ocounter + 0] = 0;
+    odata[ocounter + 1] = 0;
+    odata[ocounter + 2] = 0;
+    odata[ocounter + 3] = 0;
     switch (state) {
     case STATE_DATA:
       V <<= 1;
@@ -188,29 +192,25 @@ template<class T> void decode_slices_c(QuantisationMatrix *matrices,
                                        DequantiseFunction *dequant) {
   for (int i = 0; i < 16384; i += 64)
     _mm_prefetch(((char *)VLCLUT) + i, _MM_HINT_T0);
+  T *bands[3*MAX_DWT_DEPTH + 1];
 
   for (int Y = 0; Y < n_slices_y; Y++) {
     for (int X = 0; X < n_slices_x; X++) {
       const int n = Y*n_slices_x + X;
       int padding = 0;
-      padding += decode_c((uint8_t *)input[n].data[0], input[n].length[0], scratch[0]->data, scratch[0]->size);
-      _mm_prefetch((char *)&matrices[input[n].qindex], _MM_HINT_T0);
-      _mm_prefetch((char *)&video_data[0]->as<T>()[Y*slice_height*video_data[0]->stride + X*slice_width], _MM_HINT_T0);
-      dequant[0](&matrices[input[n].qindex], scratch[0]->data,
-                 &video_data[0]->as<T>()[Y*slice_height*video_data[0]->stride + X*slice_width], video_data[0]->stride,
-                 slice_width, slice_height, depth);
-
-      padding += decode_c((uint8_t *)input[n].data[1], input[n].length[1], scratch[1]->data, scratch[1]->size);
-      _mm_prefetch((char *)&video_data[1]->as<T>()[Y*slice_height*video_data[1]->stride + X*slice_width], _MM_HINT_T0);
-      dequant[1](&matrices[input[n].qindex], scratch[1]->data,
-                 &video_data[1]->as<T>()[Y*slice_height*video_data[1]->stride + X*slice_width/2], video_data[1]->stride,
-                 slice_width/2, slice_height, depth);
-
-      padding += decode_c((uint8_t *)input[n].data[2], input[n].length[2], scratch[2]->data, scratch[2]->size);
-      _mm_prefetch((char *)&video_data[2]->as<T>()[Y*slice_height*video_data[2]->stride + X*slice_width], _MM_HINT_T0);
-      dequant[2](&matrices[input[n].qindex], scratch[2]->data,
-                 &video_data[2]->as<T>()[Y*slice_height*video_data[2]->stride + X*slice_width/2], video_data[2]->stride,
-                 slice_width/2, slice_height, depth);
+      for (int c = 0; c < 3; c++) {
+        const int w = (c == 0) ? slice_width : slice_width/2;
+        void *optr = slice_output<T>(video_data[c], X*w, Y*slice_height, bands);
+        if (input[n].length[c] == 0) {
+          clear_slice_output<T>(video_data[c], optr, w, slice_height);
+        } else {
+          padding += decode_c<T>((uint8_t *)input[n].data[c], input[n].length[c], scratch[c]->as<T>(), scratch[c]->size);
+          _mm_prefetch((char *)&matrices[input[n].qindex], _MM_HINT_T0);
+          _mm_prefetch((char *)optr, _MM_HINT_T0);
+          dequant[c](&matrices[input[n].qindex], scratch[c]->data, optr, video_data[c]->stride,
+                     w, slice_height, depth);
+        }
+      }
 
       input[n].padding = padding;
 
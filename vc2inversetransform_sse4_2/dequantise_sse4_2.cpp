@@ -34,13 +34,22 @@ template <int slice_width,
           int slice_height,
           int depth,
           class T> void dequantise_sse4_2(QuantisationMatrix *qmatrix,
-                                          int32_t *idata,
+                                          void *idata,
                                           void *_odata,
                                           int ostride,
                                           int, int, int);
 
-inline __m128i LOAD_QUANTISED(const int32_t *idata, const QuantisationMatrix *qmatrix, const int l, const int s) {
-  __m128i D  = _mm_load_si128((__m128i *)idata);
+/* Loads four coefficients widened to 32 bits, which the dequantisation needs whatever size they are held at */
+inline __m128i LOAD_COEFFICIENTS(const int32_t *idata) {
+  return _mm_load_si128((__m128i *)idata);
+}
+
+inline __m128i LOAD_COEFFICIENTS(const int16_t *idata) {
+  return _mm_cvtepi16_epi32(_mm_loadl_epi64((__m128i *)idata));
+}
+
+template<class T> inline __m128i LOAD_QUANTISED(const T *idata, const QuantisationMatrix *qmatrix, const int l, const int s) {
+  __m128i D  = LOAD_COEFFICIENTS(idata);
   __m128i QF = _mm_load_si128((__m128i *)&qmatrix->qfactor[l][s]);
   __m128i QO = _mm_load_si128((__m128i *)&qmatrix->qoffset[l][s]);
   __m128i X  = _mm_abs_epi32(D);
@@ -64,7 +73,7 @@ template<> inline void STORE_SAMPLE_PAIR<int16_t>(__m128i *tgt, __m128i A, __m12
 }
 
 template<class T> inline void dequantise_sse4_2_8_8_2(QuantisationMatrix *qmatrix,
-                                                      int32_t *idata,
+                                                      void *_idata,
                                                       void *_odata,
                                                       int ostride) {
   T *odata = (T *)_odata;
@@ -74,7 +83,7 @@ template<class T> inline void dequantise_sse4_2_8_8_2(QuantisationMatrix *qmatri
   const int X = 0;
   const int N = 0;
   T * const optr = &odata[Y*slice_height*ostride + X*slice_width];
-  const int32_t * iptr = &idata[N*slice_height*slice_width];
+  const T * iptr = &((const T *)_idata)[N*slice_height*slice_width];
 
   const __m128i D0  = LOAD_QUANTISED(&iptr[ 0], qmatrix, 0, 0); // [  0  1  2  3 ]
   const __m128i D4  = LOAD_QUANTISED(&iptr[ 4], qmatrix, 1, 1); // [  4  5  6  7 ]
@@ -134,24 +143,38 @@ template<class T> inline void dequantise_sse4_2_8_8_2(QuantisationMatrix *qmatri
   STORE_SAMPLE_PAIR<T>((__m128i *)&optr[7*ostride + 0], Z6, Z7);
 }
 
-template<> void dequantise_sse4_2<4,8,2, int32_t>(QuantisationMatrix *qmatrix,
-                                  int32_t *idata,
-                                  void *_odata,
-                                  int ostride,
-                                  int, int, int) {
-  int32_t *odata = (int32_t *)_odata;
+/* Stores two rows of four samples, A in the first and B in the second. Packed to 16 bits the
+   two rows share a register, so it is split between them. */
+template<class T> inline void STORE_SAMPLE_ROWS(T *tgt0, T *tgt1, __m128i A, __m128i B);
+
+template<> inline void STORE_SAMPLE_ROWS<int32_t>(int32_t *tgt0, int32_t *tgt1, __m128i A, __m128i B) {
+  _mm_store_si128((__m128i *)tgt0, A);
+  _mm_store_si128((__m128i *)tgt1, B);
+}
+
+template<> inline void STORE_SAMPLE_ROWS<int16_t>(int16_t *tgt0, int16_t *tgt1, __m128i A, __m128i B) {
+  __m128i X = _mm_packs_epi32(A, B);
+  _mm_storel_epi64((__m128i *)tgt0, X);
+  _mm_storeh_pd((double *)tgt1, _mm_castsi128_pd(X));
+}
+
+template<class T> inline void dequantise_sse4_2_4_8_2(QuantisationMatrix *qmatrix,
+                                                      void *_idata,
+                                                      void *_odata,
+                                                      int ostride) {
+  T *odata = (T *)_odata;
   const int slice_width  = 4;
   const int slice_height = 8;
   const int Y = 0;
   const int X = 0;
   const int N = 0;
 
-  int32_t * const optr = &odata[Y*slice_height*ostride + X*slice_width];
-  const int32_t * iptr = &idata[N*slice_height*slice_width];
+  T * const optr = &odata[Y*slice_height*ostride + X*slice_width];
+  const T * iptr = &((const T *)_idata)[N*slice_height*slice_width];
 
   __m128i D0;
   {
-    D0 = _mm_load_si128((__m128i *)&iptr[ 0]); // [  0  1  2  3 ] (Q)
+    D0 = LOAD_COEFFICIENTS(&iptr[ 0]); // [  0  1  2  3 ] (Q)
     __m128i QF = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qfactor[0][0]),
                                     _mm_load_si128((__m128i *)&qmatrix->qfactor[1][1]));
     __m128i QO = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qoffset[0][0]),
@@ -165,7 +188,7 @@ template<> void dequantise_sse4_2<4,8,2, int32_t>(QuantisationMatrix *qmatrix,
   }
   __m128i D4;
   {
-    D4 = _mm_load_si128((__m128i *)&iptr[ 4]); // [  4  5  6  7 ] (Q)
+    D4 = LOAD_COEFFICIENTS(&iptr[ 4]); // [  4  5  6  7 ] (Q)
     __m128i QF = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qfactor[1][2]),
                                     _mm_load_si128((__m128i *)&qmatrix->qfactor[1][3]));
     __m128i QO = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qoffset[1][2]),
@@ -190,29 +213,23 @@ template<> void dequantise_sse4_2<4,8,2, int32_t>(QuantisationMatrix *qmatrix,
   const __m128i Y1  = _mm_unpackhi_epi32(X0,  X1); // [  1  3  5  7 ]
 
   const __m128i Z0  = _mm_unpacklo_epi32(Y0,  D8); // [  0  8  2  9 ]
-  _mm_store_si128((__m128i *)&optr[0*ostride + 0], Z0);
   const __m128i Z1  = _mm_unpackhi_epi32(Y0,  D8); // [  4 10  6 11 ]
-  _mm_store_si128((__m128i *)&optr[2*ostride + 0], Z1);
-
   const __m128i Z2  = _mm_unpacklo_epi32(Y1, D12); // [  1 12  3 13 ]
-  _mm_store_si128((__m128i *)&optr[4*ostride + 0], Z2);
   const __m128i Z3  = _mm_unpackhi_epi32(Y1, D12); // [  5 14  7 15 ]
-  _mm_store_si128((__m128i *)&optr[6*ostride + 0], Z3);
 
   const __m128i W0  = _mm_unpacklo_epi32(D16, D24);// [ 16 24 17 25 ]
-  _mm_store_si128((__m128i *)&optr[1*ostride + 0], W0);
   const __m128i W1  = _mm_unpackhi_epi32(D16, D24);// [ 18 26 19 27 ]
-  _mm_store_si128((__m128i *)&optr[3*ostride + 0], W1);
-
   const __m128i W2  = _mm_unpacklo_epi32(D20, D28);// [ 20 28 21 29 ]
-  _mm_store_si128((__m128i *)&optr[5*ostride + 0], W2);
   const __m128i W3  = _mm_unpackhi_epi32(D20, D28);// [ 22 30 23 31 ]
-  _mm_store_si128((__m128i *)&optr[7*ostride + 0], W3);
 
+  STORE_SAMPLE_ROWS<T>(&optr[0*ostride + 0], &optr[1*ostride + 0], Z0, W0);
+  STORE_SAMPLE_ROWS<T>(&optr[2*ostride + 0], &optr[3*ostride + 0], Z1, W1);
+  STORE_SAMPLE_ROWS<T>(&optr[4*ostride + 0], &optr[5*ostride + 0], Z2, W2);
+  STORE_SAMPLE_ROWS<T>(&optr[6*ostride + 0], &optr[7*ostride + 0], Z3, W3);
 }
 
 template<class T> inline void dequantise_sse4_2_32_8_3(QuantisationMatrix *qmatrix,
-                                                       int32_t *idata,
+                                                       void *_idata,
                                                        void *_odata,
                                                        int ostride) {
   T *odata = (T *)_odata;
@@ -224,7 +241,7 @@ template<class T> inline void dequantise_sse4_2_32_8_3(QuantisationMatrix *qmatr
   const int N = 0;
 
   T * const optr = &odata[Y*slice_height*ostride + X*slice_width];
-  const int32_t * iptr = &idata[N*slice_height*slice_width];
+  const T * iptr = &((const T *)_idata)[N*slice_height*slice_width];
 
   const __m128i D0  = LOAD_QUANTISED(&iptr[ 0], qmatrix, 0, 0);
   const __m128i D4  = LOAD_QUANTISED(&iptr[ 4], qmatrix, 1, 1);
@@ -387,7 +404,7 @@ template<class T> inline void dequantise_sse4_2_32_8_3(QuantisationMatrix *qmatr
 }
 
 template<class T> inline void dequantise_sse4_2_16_8_3(QuantisationMatrix *qmatrix,
-                                                        int32_t *idata,
+                                                        void *_idata,
                                                         void *_odata,
                                                         int ostride) {
   T *odata = (T *)_odata;
@@ -399,12 +416,12 @@ template<class T> inline void dequantise_sse4_2_16_8_3(QuantisationMatrix *qmatr
   const int N = 0;
 
   T * const optr = &odata[Y*slice_height*ostride + X*slice_width];
-  const int32_t * iptr = &idata[N*slice_height*slice_width];
+  const T * iptr = &((const T *)_idata)[N*slice_height*slice_width];
 
   {
     __m128i D0;
     {
-      D0 = _mm_load_si128((__m128i *)&iptr[ 0]); // [  0  1  2  3 ] (Q)
+      D0 = LOAD_COEFFICIENTS(&iptr[ 0]); // [  0  1  2  3 ] (Q)
       __m128i QF = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qfactor[0][0]),
                                       _mm_load_si128((__m128i *)&qmatrix->qfactor[1][1]));
       __m128i QO = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qoffset[0][0]),
@@ -439,7 +456,7 @@ template<class T> inline void dequantise_sse4_2_16_8_3(QuantisationMatrix *qmatr
   {
     __m128i D0;
     {
-      D0 = _mm_load_si128((__m128i *)&iptr[ 4]);
+      D0 = LOAD_COEFFICIENTS(&iptr[ 4]);
       __m128i QF = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qfactor[1][2]),
                                       _mm_load_si128((__m128i *)&qmatrix->qfactor[1][3]));
       __m128i QO = _mm_unpacklo_epi64(_mm_load_si128((__m128i *)&qmatrix->qoffset[1][2]),
@@ -529,53 +546,307 @@ template<class T> inline void dequantise_sse4_2_16_8_3(QuantisationMatrix *qmatr
 }
 
 template <> inline void dequantise_sse4_2<16,8,3, int32_t>(QuantisationMatrix *qmatrix,
-                                                           int32_t *idata,
+                                                           void *_idata,
                                                            void *_odata,
                                                            int ostride,
                                                            int, int, int) {
-  dequantise_sse4_2_16_8_3<int32_t>(qmatrix, idata, _odata, ostride);
+  dequantise_sse4_2_16_8_3<int32_t>(qmatrix, _idata, _odata, ostride);
 }
 
 template <> inline void dequantise_sse4_2<16,8,3, int16_t>(QuantisationMatrix *qmatrix,
-                                                           int32_t *idata,
+                                                           void *_idata,
                                                            void *_odata,
                                                            int ostride,
                                                            int, int, int) {
-  dequantise_sse4_2_16_8_3<int16_t>(qmatrix, idata, _odata, ostride);
+  dequantise_sse4_2_16_8_3<int16_t>(qmatrix, _idata, _odata, ostride);
 }
 
 template <> inline void dequantise_sse4_2<32,8,3, int32_t>(QuantisationMatrix *qmatrix,
-                                                           int32_t *idata,
+                                                           void *_idata,
                                                            void *_odata,
                                                            int ostride,
                                                            int, int, int) {
-  dequantise_sse4_2_32_8_3<int32_t>(qmatrix, idata, _odata, ostride);
+  dequantise_sse4_2_32_8_3<int32_t>(qmatrix, _idata, _odata, ostride);
 }
 
 template <> inline void dequantise_sse4_2<32,8,3, int16_t>(QuantisationMatrix *qmatrix,
-                                                           int32_t *idata,
+                                                           void *_idata,
                                                            void *_odata,
                                                            int ostride,
                                                            int, int, int) {
-  dequantise_sse4_2_32_8_3<int16_t>(qmatrix, idata, _odata, ostride);
+  dequantise_sse4_2_32_8_3<int16_t>(qmatrix, _idata, _odata, ostride);
+}
+
+template<> inline void dequantise_sse4_2<4,8,2, int32_t>(QuantisationMatrix *qmatrix,
+                                                         void *_idata,
+                                                         void *_odata,
+                                                         int ostride,
+                                                         int, int, int) {
+  dequantise_sse4_2_4_8_2<int32_t>(qmatrix, _idata, _odata, ostride);
+}
+
+template<> inline void dequantise_sse4_2<4,8,2, int16_t>(QuantisationMatrix *qmatrix,
+                                                         void *_idata,
+                                                         void *_odata,
+                                                         int ostride,
+                                                         int, int, int) {
+  dequantise_sse4_2_4_8_2<int16_t>(qmatrix, _idata, _odata, ostride);
 }
 
 template<> inline void dequantise_sse4_2<8,8,2, int32_t>(QuantisationMatrix *qmatrix,
-                                                         int32_t *idata,
+                                                         void *_idata,
                                                          void *_odata,
                                                          int ostride,
                                                          int, int, int) {
-  dequantise_sse4_2_8_8_2<int32_t>(qmatrix, idata, _odata, ostride);
+  dequantise_sse4_2_8_8_2<int32_t>(qmatrix, _idata, _odata, ostride);
 }
 
 template<> inline void dequantise_sse4_2<8,8,2, int16_t>(QuantisationMatrix *qmatrix,
-                                                         int32_t *idata,
+                                                         void *_idata,
                                                          void *_odata,
                                                          int ostride,
                                                          int, int, int) {
-  dequantise_sse4_2_8_8_2<int16_t>(qmatrix, idata, _odata, ostride);
+  dequantise_sse4_2_8_8_2<int16_t>(qmatrix, _idata, _odata, ostride);
+}
+
+/* The generic dequantiser builds each row of a slice from rows of its subbands, so the widest
+   slice it takes is bounded by the size of its row buffer */
+#define GENERIC_DEQUANTISE_MAX_WIDTH 1024
+
+/* As LOAD_COEFFICIENTS, but from anywhere in a subband */
+inline __m128i LOADU_COEFFICIENTS(const int32_t *idata) {
+  return _mm_loadu_si128((__m128i *)idata);
+}
+
+inline __m128i LOADU_COEFFICIENTS(const int16_t *idata) {
+  return _mm_cvtepi16_epi32(_mm_loadl_epi64((__m128i *)idata));
+}
+
+template<class T> inline __m128i LOADU_QUANTISED(const T *idata, const __m128i QF, const __m128i QO) {
+  __m128i D  = LOADU_COEFFICIENTS(idata);
+  __m128i X  = _mm_abs_epi32(D);
+  X = _mm_mullo_epi32(X, QF);
+  X = _mm_add_epi32(X, QO);
+  X = _mm_srai_epi32(X, 2);
+  X = _mm_sign_epi32(X, D);
+  return X;
+}
+
+inline int32_t DEQUANTISE(int32_t D, int32_t qf, int32_t qo) {
+  return sgn(D)*(((abs(D)*qf) + qo) >> 2);
+}
+
+template<class T> inline void STOREU_SAMPLES(T *tgt, __m128i A);
+
+template<> inline void STOREU_SAMPLES<int32_t>(int32_t *tgt, __m128i A) {
+  _mm_storeu_si128((__m128i *)tgt, A);
+}
+
+template<> inline void STOREU_SAMPLES<int16_t>(int16_t *tgt, __m128i A) {
+  _mm_storel_epi64((__m128i *)tgt, _mm_packs_epi32(A, A));
+}
+
+template<class T> inline void STOREU_SAMPLE_PAIR(T *tgt, __m128i A, __m128i B);
+
+template<> inline void STOREU_SAMPLE_PAIR<int32_t>(int32_t *tgt, __m128i A, __m128i B) {
+  _mm_storeu_si128((__m128i *)(tgt + 0), A);
+  _mm_storeu_si128((__m128i *)(tgt + 4), B);
+}
+
+template<> inline void STOREU_SAMPLE_PAIR<int16_t>(int16_t *tgt, __m128i A, __m128i B) {
+  _mm_storeu_si128((__m128i *)tgt, _mm_packs_epi32(A, B));
+}
+
+/* Where the coefficients of each subband of a slice start, in the order they are coded, and their
+   quantisers. Subband 0 is the DC band, subband 3*(l - 1) + s is subband s of level l. The subbands
+   of level l are width[l - 1] by height[l - 1], and undoing that level gives width[l] by height[l]. */
+template<class T> struct GenericSubbands {
+  GenericSubbands(QuantisationMatrix *qmatrix, const T *idata, int slice_width, int slice_height, int depth) {
+    int n = 0;
+    for (int l = 0; l <= depth; l++) {
+      width[l]  = slice_width  >> (depth - l);
+      height[l] = slice_height >> (depth - l);
+    }
+
+    band[0] = idata;
+    QF[0] = _mm_load_si128(&qmatrix->qfactor[0][0]);
+    QO[0] = _mm_load_si128(&qmatrix->qoffset[0][0]);
+    n += width[0]*height[0];
+    for (int l = 1; l <= depth; l++) {
+      for (int s = 1; s < 4; s++) {
+        band[3*(l - 1) + s] = &idata[n];
+        QF[3*(l - 1) + s] = _mm_load_si128(&qmatrix->qfactor[l][s]);
+        QO[3*(l - 1) + s] = _mm_load_si128(&qmatrix->qoffset[l][s]);
+        n += width[l - 1]*height[l - 1];
+      }
+    }
+  }
+
+  const T *band[3*MAX_DWT_DEPTH + 1];
+  __m128i QF[3*MAX_DWT_DEPTH + 1];
+  __m128i QO[3*MAX_DWT_DEPTH + 1];
+  int width[MAX_DWT_DEPTH + 1];
+  int height[MAX_DWT_DEPTH + 1];
+};
+
+/* Dequantises a row of n coefficients of subband b */
+template<class T, class O> inline void dequantise_row_sse4_2(const GenericSubbands<T> &S, int b, const T *iptr, O *optr, int n) {
+  int x = 0;
+  for (; x + 4 <= n; x += 4)
+    STOREU_SAMPLES<O>(&optr[x], LOADU_QUANTISED<T>(&iptr[x], S.QF[b], S.QO[b]));
+  for (; x < n; x++)
+    optr[x] = DEQUANTISE(iptr[x], _mm_cvtsi128_si32(S.QF[b]), _mm_cvtsi128_si32(S.QO[b]));
+}
+
+/* Interleaves a row of n coefficients of subband b, or already dequantised samples when there is
+   no subband given, with a row of n coefficients of subband c */
+template<class T, class O> inline void interleave_rows_sse4_2(const GenericSubbands<T> &S, int b, const T *aptr, const int32_t *lptr, int c, const T *bptr, O *optr, int n) {
+  int x = 0;
+  for (; x + 4 <= n; x += 4) {
+    const __m128i A = (lptr) ? _mm_loadu_si128((__m128i *)&lptr[x]) : LOADU_QUANTISED<T>(&aptr[x], S.QF[b], S.QO[b]);
+    const __m128i B = LOADU_QUANTISED<T>(&bptr[x], S.QF[c], S.QO[c]);
+    STOREU_SAMPLE_PAIR<O>(&optr[2*x], _mm_unpacklo_epi32(A, B), _mm_unpackhi_epi32(A, B));
+  }
+  for (; x < n; x++) {
+    optr[2*x + 0] = (lptr) ? lptr[x] : DEQUANTISE(aptr[x], _mm_cvtsi128_si32(S.QF[b]), _mm_cvtsi128_si32(S.QO[b]));
+    optr[2*x + 1] = DEQUANTISE(bptr[x], _mm_cvtsi128_si32(S.QF[c]), _mm_cvtsi128_si32(S.QO[c]));
+  }
 }
 
+/* Builds row r of the slice as it is once level l has been undone. An even row interleaves a row of
+   the slice at level l - 1 with a row of the HL subband, an odd row a row of the LH subband with one
+   of the HH subband. The rows of lower levels are built in tmp, which needs room for width[l] samples. */
+template<class T, class O> void generic_row_sse4_2(const GenericSubbands<T> &S, int l, int r, O *optr, int32_t *tmp) {
+  if (l == 0) {
+    dequantise_row_sse4_2<T, O>(S, 0, &S.band[0][r*S.width[0]], optr, S.width[0]);
+    return;
+  }
+
+  const int n = S.width[l - 1];
+  const int b = 3*(l - 1);
+  if ((r&1) == 0) {
+    generic_row_sse4_2<T, int32_t>(S, l - 1, r/2, tmp, tmp + n);
+    interleave_rows_sse4_2<T, O>(S, 0, NULL, tmp, b + 1, &S.band[b + 1][(r/2)*n], optr, n);
+  } else {
+    interleave_rows_sse4_2<T, O>(S, b + 2, &S.band[b + 2][(r/2)*n], NULL, b + 3, &S.band[b + 3][(r/2)*n], optr, n);
+  }
+}
+
+/* Dequantises slices of any shape and depth, a row of the output at a time so that all of the stores
+   are whole registers into consecutive samples */
+template<class T> void dequantise_generic_sse4_2(QuantisationMatrix *qmatrix,
+                                                 void *_idata,
+                                                 void *_odata,
+                                                 int ostride,
+                                                 int slice_width,
+                                                 int slice_height,
+                                                 int depth) {
+  T *odata = (T *)_odata;
+  const GenericSubbands<T> S(qmatrix, (const T *)_idata, slice_width, slice_height, depth);
+  int32_t tmp[GENERIC_DEQUANTISE_MAX_WIDTH];
+
+  for (int y = 0; y < slice_height; y++)
+    generic_row_sse4_2<T, T>(S, depth, y, &odata[y*ostride], tmp);
+}
+
+/* For planes held a subband at a time each subband is dequantised straight into its own place in the plane */
+template<class T> void dequantise_subbands_sse4_2(QuantisationMatrix *qmatrix,
+                                                  void *_idata,
+                                                  void *_odata,
+                                                  int ostride,
+                                                  int slice_width,
+                                                  int slice_height,
+                                                  int depth) {
+  T **bands = (T **)_odata;
+  const GenericSubbands<T> S(qmatrix, (const T *)_idata, slice_width, slice_height, depth);
+
+  for (int y = 0; y < S.height[0]; y++)
+    dequantise_row_sse4_2<T, T>(S, 0, &S.band[0][y*S.width[0]], &bands[0][y*ostride], S.width[0]);
+  for (int b = 1; b < 3*depth + 1; b++) {
+    const int l = (b + 2)/3;
+    for (int y = 0; y < S.height[l - 1]; y++)
+      dequantise_row_sse4_2<T, T>(S, b, &S.band[b][y*S.width[l - 1]], &bands[b][y*ostride], S.width[l - 1]);
+  }
+}
+
+/* As generic_row_sse4_2, but with the shape of the slice known when compiling, so that the recursion
+   through the levels and the widths of all of the rows are fixed, and the loops along them can be unrolled */
+template<int slice_width, int depth, int l, class T, class O> struct GeneratedRow {
+  static inline void build(const GenericSubbands<T> &S, int r, O *optr, int32_t *tmp) {
+    const int n = slice_width >> (depth - l + 1);
+    const int b = 3*(l - 1);
+    if ((r&1) == 0) {
+      GeneratedRow<slice_width, depth, l - 1, T, int32_t>::build(S, r/2, tmp, tmp + n);
+      interleave_rows_sse4_2<T, O>(S, 0, NULL, tmp, b + 1, &S.band[b + 1][(r/2)*n], optr, n);
+    } else {
+      interleave_rows_sse4_2<T, O>(S, b + 2, &S.band[b + 2][(r/2)*n], NULL, b + 3, &S.band[b + 3][(r/2)*n], optr, n);
+    }
+  }
+};
+
+template<int slice_width, int depth, class T, class O> struct GeneratedRow<slice_width, depth, 0, T, O> {
+  static inline void build(const GenericSubbands<T> &S, int r, O *optr, int32_t *) {
+    const int n = slice_width >> depth;
+    dequantise_row_sse4_2<T, O>(S, 0, &S.band[0][r*n], optr, n);
+  }
+};
+
+/* Shapes without a hand written kernel get one generated from the generic dequantiser. The rows are
+   taken in pairs so that which subbands each comes from is fixed. */
+template <int slice_width,
+          int slice_height,
+          int depth,
+          class T> void dequantise_sse4_2(QuantisationMatrix *qmatrix,
+                                          void *idata,
+                                          void *_odata,
+                                          int ostride,
+                                          int, int, int) {
+  T *odata = (T *)_odata;
+  const GenericSubbands<T> S(qmatrix, (const T *)idata, slice_width, slice_height, depth);
+  int32_t tmp[slice_width];
+
+  for (int y = 0; y < slice_height; y += 2) {
+    GeneratedRow<slice_width, depth, depth, T, T>::build(S, y + 0, &odata[(y + 0)*ostride], tmp);
+    GeneratedRow<slice_width, depth, depth, T, T>::build(S, y + 1, &odata[(y + 1)*ostride], tmp);
+  }
+}
+
+/* The slice shapes used in broadcast, for which dequantisers are generated when compiling. Those with
+   hand written kernels are picked out before this is looked in. */
+struct DequantiseKernel {
+  int slice_width;
+  int slice_height;
+  int depth;
+  DequantiseFunction func32;
+  DequantiseFunction func16;
+};
+
+#define DEQUANTISE_KERNEL(w, h, d) { w, h, d, dequantise_sse4_2<w,h,d, int32_t>, dequantise_sse4_2<w,h,d, int16_t> }
+
+static const DequantiseKernel DEQUANTISE_KERNELS[] = {
+  DEQUANTISE_KERNEL( 4,  4, 1), DEQUANTISE_KERNEL( 4,  8, 1), DEQUANTISE_KERNEL( 4, 16, 1), DEQUANTISE_KERNEL( 4, 32, 1),
+  DEQUANTISE_KERNEL( 8,  4, 1), DEQUANTISE_KERNEL( 8,  8, 1), DEQUANTISE_KERNEL( 8, 16, 1), DEQUANTISE_KERNEL( 8, 32, 1),
+  DEQUANTISE_KERNEL(16,  4, 1), DEQUANTISE_KERNEL(16,  8, 1), DEQUANTISE_KERNEL(16, 16, 1), DEQUANTISE_KERNEL(16, 32, 1),
+  DEQUANTISE_KERNEL(32,  4, 1), DEQUANTISE_KERNEL(32,  8, 1), DEQUANTISE_KERNEL(32, 16, 1), DEQUANTISE_KERNEL(32, 32, 1),
+  DEQUANTISE_KERNEL(64,  4, 1), DEQUANTISE_KERNEL(64,  8, 1), DEQUANTISE_KERNEL(64, 16, 1), DEQUANTISE_KERNEL(64, 32, 1),
+
+  DEQUANTISE_KERNEL( 4,  4, 2),                               DEQUANTISE_KERNEL( 4, 16, 2), DEQUANTISE_KERNEL( 4, 32, 2),
+  DEQUANTISE_KERNEL( 8,  4, 2),                               DEQUANTISE_KERNEL( 8, 16, 2), DEQUANTISE_KERNEL( 8, 32, 2),
+  DEQUANTISE_KERNEL(16,  4, 2), DEQUANTISE_KERNEL(16,  8, 2), DEQUANTISE_KERNEL(16, 16, 2), DEQUANTISE_KERNEL(16, 32, 2),
+  DEQUANTISE_KERNEL(32,  4, 2), DEQUANTISE_KERNEL(32,  8, 2), DEQUANTISE_KERNEL(32, 16, 2), DEQUANTISE_KERNEL(32, 32, 2),
+  DEQUANTISE_KERNEL(64,  4, 2), DEQUANTISE_KERNEL(64,  8, 2), DEQUANTISE_KERNEL(64, 16, 2), DEQUANTISE_KERNEL(64, 32, 2),
+
+  DEQUANTISE_KERNEL( 8,  8, 3), DEQUANTISE_KERNEL( 8, 16, 3), DEQUANTISE_KERNEL( 8, 32, 3),
+                                DEQUANTISE_KERNEL(16, 16, 3), DEQUANTISE_KERNEL(16, 32, 3),
+                                DEQUANTISE_KERNEL(32, 16, 3), DEQUANTISE_KERNEL(32, 32, 3),
+  DEQUANTISE_KERNEL(64,  8, 3), DEQUANTISE_KERNEL(64, 16, 3), DEQUANTISE_KERNEL(64, 32, 3),
+
+  DEQUANTISE_KERNEL(16, 16, 4), DEQUANTISE_KERNEL(16, 32, 4),
+  DEQUANTISE_KERNEL(32, 16, 4), DEQUANTISE_KERNEL(32, 32, 4),
+  DEQUANTISE_KERNEL(64, 16, 4), DEQUANTISE_KERNEL(64, 32, 4),
+};
+const int DEQUANTISE_KERNELS_NUM = sizeof(DEQUANTISE_KERNELS)/sizeof(DequantiseKernel);
+
 DequantiseFunction getDequantiseFunction_sse4_2(int slice_width,
                                                 int slice_height,
                                                 int depth,
@@ -598,7 +869,7 @@ DequantiseFunction getDequantiseFunction_sse4_2(int slice_width,
              slice_height == 8)
       return dequantise_sse4_2<16,8,3, int32_t>;
   } else if (sample_size == 2) {
-    /* if (depth == 2 &&
+    if (depth == 2 &&
         slice_width == 8 &&
         slice_height == 8)
       return dequantise_sse4_2<8,8,2, int16_t>;
@@ -606,15 +877,49 @@ DequantiseFunction getDequantiseFunction_sse4_2(int slice_width,
              slice_width == 4 &&
              slice_height == 8)
       return dequantise_sse4_2<4,8,2, int16_t>;
-      else*/ if (depth == 3 &&
+    else if (depth == 3 &&
              slice_width == 32 &&
              slice_height == 8)
       return dequantise_sse4_2<32,8,3, int16_t>;
-      else if (depth == 3 &&
+    else if (depth == 3 &&
              slice_width == 16 &&
              slice_height == 8)
       return dequantise_sse4_2<16,8,3, int16_t>;
-      }
+  }
+
+  for (int i = 0; i < DEQUANTISE_KERNELS_NUM; i++) {
+    const DequantiseKernel &K = DEQUANTISE_KERNELS[i];
+    if (K.slice_width == slice_width && K.slice_height == slice_height && K.depth == depth) {
+      if (sample_size == 4)
+        return K.func32;
+      else if (sample_size == 2)
+        return K.func16;
+    }
+  }
+
+  if (depth >= 0 && depth <= MAX_DWT_DEPTH &&
+      slice_width <= GENERIC_DEQUANTISE_MAX_WIDTH &&
+      (slice_width  % (1 << depth)) == 0 &&
+      (slice_height % (1 << depth)) == 0) {
+    if (sample_size == 4)
+      return dequantise_generic_sse4_2<int32_t>;
+    else if (sample_size == 2)
+      return dequantise_generic_sse4_2<int16_t>;
+  }
 
   return getDequantiseFunction_c(slice_width, slice_height, depth, sample_size);
 }
+
+DequantiseFunction getSubbandDequantiseFunction_sse4_2(int,
+                                                       int,
+                                                       int depth,
+                                                       int sample_size) {
+  if (depth >= 0 && depth <= MAX_DWT_DEPTH) {
+    if (sample_size == 4)
+      return dequantise_subbands_sse4_2<int32_t>;
+    else if (sample_size == 2)
+      return dequantise_subbands_sse4_2<int16_t>;
+  }
+
+  return getSubbandDequantiseFunction_c(0, 0, depth, sample_size);
+}
@@ -34,4 +34,8 @@ VC2EXPORT DequantiseFunction getDequantiseFunction_sse4_2(int slice_width,
                                                           int slice_height,
                                                           int depth,
                                                           int sample_size);
+VC2EXPORT DequantiseFunction getSubbandDequantiseFunction_sse4_2(int slice_width,
+                                                                 int slice_height,
+                                                                 int depth,
+                                                                 int sample_size);
 #endif /* __DEQUANTISE_SSE4_2_CPP__ */
@@ -172,3 +172,390 @@ template<int shift, int active_bits> void Haar_invtransform_H_final_1_sse4_2_int
     }
   }
 }
+
+/* The subband layout versions. Samples past the last whole vector of a row are left to the plain C versions. */
+void Haar_invtransform_V_subbands_sse4_2_int32_t(void *_ldata,
+                                                 const int lstride,
+                                                 void *_hdata,
+                                                 const int hstride,
+                                                 const int width,
+                                                 const int height) {
+  const __m128i ONE = _mm_set1_epi32(1);
+  const int vwidth = width&~3;
+
+  for (int y = 0; y < height; y++) {
+    int32_t *L = &((int32_t *)_ldata)[y*lstride];
+    int32_t *H = &((int32_t *)_hdata)[y*hstride];
+    for (int x = 0; x < vwidth; x += 4) {
+      __m128i D0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i D1 = _mm_loadu_si128((__m128i *)&H[x]);
+
+      __m128i X0 = _mm_sub_epi32(D0, _mm_srai_epi32(_mm_add_epi32(D1, ONE), 1));
+      __m128i X1 = _mm_add_epi32(D1, X0);
+
+      _mm_storeu_si128((__m128i *)&L[x], X0);
+      _mm_storeu_si128((__m128i *)&H[x], X1);
+    }
+  }
+
+  if (vwidth < width)
+    Haar_invtransform_V_subbands<int32_t>(&((int32_t *)_ldata)[vwidth], lstride, &((int32_t *)_hdata)[vwidth], hstride, width - vwidth, height);
+}
+
+void Haar_invtransform_V_subbands_sse4_2_int16_t(void *_ldata,
+                                                 const int lstride,
+                                                 void *_hdata,
+                                                 const int hstride,
+                                                 const int width,
+                                                 const int height) {
+  const __m128i ONE = _mm_set1_epi16(1);
+  const int vwidth = width&~7;
+
+  for (int y = 0; y < height; y++) {
+    int16_t *L = &((int16_t *)_ldata)[y*lstride];
+    int16_t *H = &((int16_t *)_hdata)[y*hstride];
+    for (int x = 0; x < vwidth; x += 8) {
+      __m128i D0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i D1 = _mm_loadu_si128((__m128i *)&H[x]);
+
+      __m128i X0 = _mm_sub_epi16(D0, _mm_srai_epi16(_mm_add_epi16(D1, ONE), 1));
+      __m128i X1 = _mm_add_epi16(D1, X0);
+
+      _mm_storeu_si128((__m128i *)&L[x], X0);
+      _mm_storeu_si128((__m128i *)&H[x], X1);
+    }
+  }
+
+  if (vwidth < width)
+    Haar_invtransform_V_subbands<int16_t>(&((int16_t *)_ldata)[vwidth], lstride, &((int16_t *)_hdata)[vwidth], hstride, width - vwidth, height);
+}
+
+template<int shift> void Haar_invtransform_H_subbands_sse4_2_int32_t(const void *_ldata,
+                                                                    const int lstride,
+                                                                    const void *_hdata,
+                                                                    const int hstride,
+                                                                    void *_odata,
+                                                                    const int ostride,
+                                                                    const int width,
+                                                                    const int height) {
+  const __m128i ONE = _mm_set1_epi32(1);
+  const __m128i ROUND = _mm_set1_epi32((shift > 0) ? (1 << (shift - 1)) : 0);
+  const int vwidth = width&~3;
+
+  for (int y = 0; y < height; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    const int32_t *H = &((const int32_t *)_hdata)[y*hstride];
+    int32_t *odata = &((int32_t *)_odata)[y*ostride];
+    for (int x = 0; x < vwidth; x += 4) {
+      __m128i D0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i D1 = _mm_loadu_si128((__m128i *)&H[x]);
+
+      __m128i X0 = _mm_sub_epi32(D0, _mm_srai_epi32(_mm_add_epi32(D1, ONE), 1));
+      __m128i X1 = _mm_add_epi32(D1, X0);
+
+      __m128i Z0 = _mm_unpacklo_epi32(X0, X1);
+      __m128i Z4 = _mm_unpackhi_epi32(X0, X1);
+
+      if (shift != 0) {
+        Z0 = _mm_srai_epi32(_mm_add_epi32(Z0, ROUND), shift);
+        Z4 = _mm_srai_epi32(_mm_add_epi32(Z4, ROUND), shift);
+      }
+
+      _mm_storeu_si128((__m128i *)&odata[2*x + 0], Z0);
+      _mm_storeu_si128((__m128i *)&odata[2*x + 4], Z4);
+    }
+  }
+
+  if (vwidth < width)
+    Haar_invtransform_H_subbands<shift, int32_t>(&((const int32_t *)_ldata)[vwidth], lstride, &((const int32_t *)_hdata)[vwidth], hstride,
+                                                 &((int32_t *)_odata)[2*vwidth], ostride, width - vwidth, height);
+}
+
+template<int shift> void Haar_invtransform_H_subbands_sse4_2_int16_t(const void *_ldata,
+                                                                    const int lstride,
+                                                                    const void *_hdata,
+                                                                    const int hstride,
+                                                                    void *_odata,
+                                                                    const int ostride,
+                                                                    const int width,
+                                                                    const int height) {
+  const __m128i ONE = _mm_set1_epi16(1);
+  const __m128i ROUND = _mm_set1_epi16((shift > 0) ? (1 << (shift - 1)) : 0);
+  const int vwidth = width&~7;
+
+  for (int y = 0; y < height; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    const int16_t *H = &((const int16_t *)_hdata)[y*hstride];
+    int16_t *odata = &((int16_t *)_odata)[y*ostride];
+    for (int x = 0; x < vwidth; x += 8) {
+      __m128i D0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i D1 = _mm_loadu_si128((__m128i *)&H[x]);
+
+      __m128i X0 = _mm_sub_epi16(D0, _mm_srai_epi16(_mm_add_epi16(D1, ONE), 1));
+      __m128i X1 = _mm_add_epi16(D1, X0);
+
+      __m128i Z0 = _mm_unpacklo_epi16(X0, X1);
+      __m128i Z8 = _mm_unpackhi_epi16(X0, X1);
+
+      if (shift != 0) {
+        Z0 = _mm_srai_epi16(_mm_add_epi16(Z0, ROUND), shift);
+        Z8 = _mm_srai_epi16(_mm_add_epi16(Z8, ROUND), shift);
+      }
+
+      _mm_storeu_si128((__m128i *)&odata[2*x + 0], Z0);
+      _mm_storeu_si128((__m128i *)&odata[2*x + 8], Z8);
+    }
+  }
+
+  if (vwidth < width)
+    Haar_invtransform_H_subbands<shift, int16_t>(&((const int16_t *)_ldata)[vwidth], lstride, &((const int16_t *)_hdata)[vwidth], hstride,
+                                                 &((int16_t *)_odata)[2*vwidth], ostride, width - vwidth, height);
+}
+
+/* Only whole vectors of sample pairs inside the output are done here, the odd sample at either end of the
+   output and any left past the last whole vector are done by the C version */
+template<int shift, int active_bits> void Haar_invtransform_H_subbands_final_sse4_2_int32_t(const void *_ldata,
+                                                                                           const int lstride,
+                                                                                           const void *_hdata,
+                                                                                           const int hstride,
+                                                                                           const char *odata,
+                                                                                           const int ostride,
+                                                                                           const int width,
+                                                                                           const int height,
+                                                                                           const int ooffset_x,
+                                                                                           const int owidth) {
+  const __m128i ONE = _mm_set1_epi32(1);
+  const __m128i ROUND = _mm_set1_epi32((shift > 0) ? (1 << (shift - 1)) : 0);
+  const __m128i OFFSET = _mm_set1_epi32(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/4)*4 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    const int32_t *H = &((const int32_t *)_hdata)[y*hstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+    for (int x = x0; x < xe; x += 4) {
+      __m128i D0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i D1 = _mm_loadu_si128((__m128i *)&H[x]);
+
+      __m128i X0 = _mm_sub_epi32(D0, _mm_srai_epi32(_mm_add_epi32(D1, ONE), 1));
+      __m128i X1 = _mm_add_epi32(D1, X0);
+
+      __m128i Z0 = _mm_unpacklo_epi32(X0, X1);
+      __m128i Z4 = _mm_unpackhi_epi32(X0, X1);
+
+      if (shift != 0) {
+        Z0 = _mm_srai_epi32(_mm_add_epi32(Z0, ROUND), shift);
+        Z4 = _mm_srai_epi32(_mm_add_epi32(Z4, ROUND), shift);
+      }
+
+      Z0 = _mm_add_epi32(Z0, OFFSET);
+      Z4 = _mm_add_epi32(Z4, OFFSET);
+      _mm_storeu_si128((__m128i *)&optr[2*x], _mm_min_epu16(_mm_packus_epi32(Z0, Z4), CLIP));
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    Haar_invtransform_H_subbands_final<shift, active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                    width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    Haar_invtransform_H_subbands_final<shift, active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                    width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
+
+template<int shift, int active_bits> void Haar_invtransform_H_subbands_final_sse4_2_int16_t(const void *_ldata,
+                                                                                           const int lstride,
+                                                                                           const void *_hdata,
+                                                                                           const int hstride,
+                                                                                           const char *odata,
+                                                                                           const int ostride,
+                                                                                           const int width,
+                                                                                           const int height,
+                                                                                           const int ooffset_x,
+                                                                                           const int owidth) {
+  const __m128i ONE = _mm_set1_epi16(1);
+  const __m128i ROUND = _mm_set1_epi16((shift > 0) ? (1 << (shift - 1)) : 0);
+  const __m128i OFFSET = _mm_set1_epi16(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+  const __m128i ZERO = _mm_setzero_si128();
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/8)*8 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    const int16_t *H = &((const int16_t *)_hdata)[y*hstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+    for (int x = x0; x < xe; x += 8) {
+      __m128i D0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i D1 = _mm_loadu_si128((__m128i *)&H[x]);
+
+      __m128i X0 = _mm_sub_epi16(D0, _mm_srai_epi16(_mm_add_epi16(D1, ONE), 1));
+      __m128i X1 = _mm_add_epi16(D1, X0);
+
+      __m128i Z0 = _mm_unpacklo_epi16(X0, X1);
+      __m128i Z8 = _mm_unpackhi_epi16(X0, X1);
+
+      if (shift != 0) {
+        Z0 = _mm_srai_epi16(_mm_add_epi16(Z0, ROUND), shift);
+        Z8 = _mm_srai_epi16(_mm_add_epi16(Z8, ROUND), shift);
+      }
+
+      Z0 = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(Z0, OFFSET), CLIP), ZERO);
+      Z8 = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(Z8, OFFSET), CLIP), ZERO);
+      _mm_storeu_si128((__m128i *)&optr[2*x + 0], Z0);
+      _mm_storeu_si128((__m128i *)&optr[2*x + 8], Z8);
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    Haar_invtransform_H_subbands_final<shift, active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                    width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    Haar_invtransform_H_subbands_final<shift, active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                    width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
+
+/* The zero_high versions, which only read the low pass subband. The vertical one is just a copy, so is left to the
+   plain C version */
+template<int shift> void Haar_invtransform_H_subbands_zero_high_sse4_2_int32_t(const void *_ldata,
+                                                                              const int lstride,
+                                                                              const void *_hdata,
+                                                                              const int hstride,
+                                                                              void *_odata,
+                                                                              const int ostride,
+                                                                              const int width,
+                                                                              const int height) {
+  const __m128i ROUND = _mm_set1_epi32((shift > 0) ? (1 << (shift - 1)) : 0);
+  const int vwidth = width&~3;
+
+  for (int y = 0; y < height; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    int32_t *odata = &((int32_t *)_odata)[y*ostride];
+    for (int x = 0; x < vwidth; x += 4) {
+      __m128i X0 = _mm_loadu_si128((__m128i *)&L[x]);
+      if (shift != 0)
+        X0 = _mm_srai_epi32(_mm_add_epi32(X0, ROUND), shift);
+
+      _mm_storeu_si128((__m128i *)&odata[2*x + 0], _mm_unpacklo_epi32(X0, X0));
+      _mm_storeu_si128((__m128i *)&odata[2*x + 4], _mm_unpackhi_epi32(X0, X0));
+    }
+  }
+
+  if (vwidth < width)
+    Haar_invtransform_H_subbands_zero_high<shift, int32_t>(&((const int32_t *)_ldata)[vwidth], lstride, _hdata, hstride,
+                                                           &((int32_t *)_odata)[2*vwidth], ostride, width - vwidth, height);
+}
+
+template<int shift> void Haar_invtransform_H_subbands_zero_high_sse4_2_int16_t(const void *_ldata,
+                                                                              const int lstride,
+                                                                              const void *_hdata,
+                                                                              const int hstride,
+                                                                              void *_odata,
+                                                                              const int ostride,
+                                                                              const int width,
+                                                                              const int height) {
+  const __m128i ROUND = _mm_set1_epi16((shift > 0) ? (1 << (shift - 1)) : 0);
+  const int vwidth = width&~7;
+
+  for (int y = 0; y < height; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    int16_t *odata = &((int16_t *)_odata)[y*ostride];
+    for (int x = 0; x < vwidth; x += 8) {
+      __m128i X0 = _mm_loadu_si128((__m128i *)&L[x]);
+      if (shift != 0)
+        X0 = _mm_srai_epi16(_mm_add_epi16(X0, ROUND), shift);
+
+      _mm_storeu_si128((__m128i *)&odata[2*x + 0], _mm_unpacklo_epi16(X0, X0));
+      _mm_storeu_si128((__m128i *)&odata[2*x + 8], _mm_unpackhi_epi16(X0, X0));
+    }
+  }
+
+  if (vwidth < width)
+    Haar_invtransform_H_subbands_zero_high<shift, int16_t>(&((const int16_t *)_ldata)[vwidth], lstride, _hdata, hstride,
+                                                           &((int16_t *)_odata)[2*vwidth], ostride, width - vwidth, height);
+}
+
+template<int shift, int active_bits> void Haar_invtransform_H_subbands_final_zero_high_sse4_2_int32_t(const void *_ldata,
+                                                                                                     const int lstride,
+                                                                                                     const void *_hdata,
+                                                                                                     const int hstride,
+                                                                                                     const char *odata,
+                                                                                                     const int ostride,
+                                                                                                     const int width,
+                                                                                                     const int height,
+                                                                                                     const int ooffset_x,
+                                                                                                     const int owidth) {
+  const __m128i ROUND = _mm_set1_epi32((shift > 0) ? (1 << (shift - 1)) : 0);
+  const __m128i OFFSET = _mm_set1_epi32(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/4)*4 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+    for (int x = x0; x < xe; x += 4) {
+      __m128i X0 = _mm_loadu_si128((__m128i *)&L[x]);
+      if (shift != 0)
+        X0 = _mm_srai_epi32(_mm_add_epi32(X0, ROUND), shift);
+      X0 = _mm_add_epi32(X0, OFFSET);
+
+      _mm_storeu_si128((__m128i *)&optr[2*x], _mm_min_epu16(_mm_packus_epi32(_mm_unpacklo_epi32(X0, X0), _mm_unpackhi_epi32(X0, X0)), CLIP));
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    Haar_invtransform_H_subbands_final_zero_high<shift, active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                              width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    Haar_invtransform_H_subbands_final_zero_high<shift, active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                              width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
+
+template<int shift, int active_bits> void Haar_invtransform_H_subbands_final_zero_high_sse4_2_int16_t(const void *_ldata,
+                                                                                                     const int lstride,
+                                                                                                     const void *_hdata,
+                                                                                                     const int hstride,
+                                                                                                     const char *odata,
+                                                                                                     const int ostride,
+                                                                                                     const int width,
+                                                                                                     const int height,
+                                                                                                     const int ooffset_x,
+                                                                                                     const int owidth) {
+  const __m128i ROUND = _mm_set1_epi16((shift > 0) ? (1 << (shift - 1)) : 0);
+  const __m128i OFFSET = _mm_set1_epi16(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+  const __m128i ZERO = _mm_setzero_si128();
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/8)*8 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+    for (int x = x0; x < xe; x += 8) {
+      __m128i X0 = _mm_loadu_si128((__m128i *)&L[x]);
+      if (shift != 0)
+        X0 = _mm_srai_epi16(_mm_add_epi16(X0, ROUND), shift);
+      X0 = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(X0, OFFSET), CLIP), ZERO);
+
+      _mm_storeu_si128((__m128i *)&optr[2*x + 0], _mm_unpacklo_epi16(X0, X0));
+      _mm_storeu_si128((__m128i *)&optr[2*x + 8], _mm_unpackhi_epi16(X0, X0));
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    Haar_invtransform_H_subbands_final_zero_high<shift, active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                              width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    Haar_invtransform_H_subbands_final_zero_high<shift, active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                              width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
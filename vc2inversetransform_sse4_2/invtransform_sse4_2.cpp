@@ -26,6 +26,8 @@
 #include "../vc2inversetransform_c/invtransform_c.hpp"
 #include "invtransform_sse4_2.hpp"
 #include "logger.hpp"
+#include "../vc2inversetransform_c/legall_invtransform.hpp"
+#include "../vc2inversetransform_c/haar_invtransform.hpp"
 #include "legall_invtransform.hpp"
 #include "haar_invtransform.hpp"
 
@@ -130,3 +132,194 @@ InplaceTransformFinal get_invhtransformfinal_sse4_2(int wavelet_index, int activ
 
   return get_invhtransformfinal_c(wavelet_index, active_bits, sample_size);
 }
+
+SubbandTransformV get_invvtransform_subbands_sse4_2(int wavelet_index, int sample_size) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    if (sample_size == 4)
+      return LeGall_5_3_invtransform_V_subbands_sse4_2_int32_t;
+    else if (sample_size == 2)
+      return LeGall_5_3_invtransform_V_subbands_sse4_2_int16_t;
+    break;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    if (sample_size == 4)
+      return Haar_invtransform_V_subbands_sse4_2_int32_t;
+    else if (sample_size == 2)
+      return Haar_invtransform_V_subbands_sse4_2_int16_t;
+    break;
+  default:
+    break;
+  }
+
+  return get_invvtransform_subbands_c(wavelet_index, sample_size);
+}
+
+SubbandTransformH get_invhtransform_subbands_sse4_2(int wavelet_index, int sample_size) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    if (sample_size == 4)
+      return LeGall_5_3_invtransform_H_subbands_sse4_2_int32_t;
+    else if (sample_size == 2)
+      return LeGall_5_3_invtransform_H_subbands_sse4_2_int16_t;
+    break;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+    if (sample_size == 4)
+      return Haar_invtransform_H_subbands_sse4_2_int32_t<0>;
+    else if (sample_size == 2)
+      return Haar_invtransform_H_subbands_sse4_2_int16_t<0>;
+    break;
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    if (sample_size == 4)
+      return Haar_invtransform_H_subbands_sse4_2_int32_t<1>;
+    else if (sample_size == 2)
+      return Haar_invtransform_H_subbands_sse4_2_int16_t<1>;
+    break;
+  default:
+    break;
+  }
+
+  return get_invhtransform_subbands_c(wavelet_index, sample_size);
+}
+
+SubbandTransformFinal get_invhtransformfinal_subbands_sse4_2(int wavelet_index, int active_bits, int sample_size) {
+  if (sample_size == 4) {
+    switch (wavelet_index) {
+    case VC2DECODER_WFT_LEGALL_5_3:
+      switch (active_bits) {
+      case 10: return LeGall_5_3_invtransform_H_subbands_final_sse4_2_int32_t<10>;
+      case 12: return LeGall_5_3_invtransform_H_subbands_final_sse4_2_int32_t<12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_NO_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_sse4_2_int32_t<0, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_sse4_2_int32_t<0, 12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_sse4_2_int32_t<1, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_sse4_2_int32_t<1, 12>;
+      }
+      break;
+    default:
+      break;
+    }
+  } else if (sample_size == 2) {
+    switch (wavelet_index) {
+    case VC2DECODER_WFT_LEGALL_5_3:
+      switch (active_bits) {
+      case 10: return LeGall_5_3_invtransform_H_subbands_final_sse4_2_int16_t<10>;
+      case 12: return LeGall_5_3_invtransform_H_subbands_final_sse4_2_int16_t<12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_NO_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_sse4_2_int16_t<0, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_sse4_2_int16_t<0, 12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_sse4_2_int16_t<1, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_sse4_2_int16_t<1, 12>;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  return get_invhtransformfinal_subbands_c(wavelet_index, active_bits, sample_size);
+}
+
+SubbandTransformV get_invvtransform_subbands_zero_high_sse4_2(int wavelet_index, int sample_size) {
+  if (wavelet_index == VC2DECODER_WFT_LEGALL_5_3) {
+    if (sample_size == 4)
+      return LeGall_5_3_invtransform_V_subbands_zero_high_sse4_2_int32_t;
+    else if (sample_size == 2)
+      return LeGall_5_3_invtransform_V_subbands_zero_high_sse4_2_int16_t;
+  }
+
+  return get_invvtransform_subbands_zero_high_c(wavelet_index, sample_size);
+}
+
+SubbandTransformH get_invhtransform_subbands_zero_high_sse4_2(int wavelet_index, int sample_size) {
+  switch (wavelet_index) {
+  case VC2DECODER_WFT_LEGALL_5_3:
+    if (sample_size == 4)
+      return LeGall_5_3_invtransform_H_subbands_zero_high_sse4_2_int32_t;
+    else if (sample_size == 2)
+      return LeGall_5_3_invtransform_H_subbands_zero_high_sse4_2_int16_t;
+    break;
+  case VC2DECODER_WFT_HAAR_NO_SHIFT:
+    if (sample_size == 4)
+      return Haar_invtransform_H_subbands_zero_high_sse4_2_int32_t<0>;
+    else if (sample_size == 2)
+      return Haar_invtransform_H_subbands_zero_high_sse4_2_int16_t<0>;
+    break;
+  case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+    if (sample_size == 4)
+      return Haar_invtransform_H_subbands_zero_high_sse4_2_int32_t<1>;
+    else if (sample_size == 2)
+      return Haar_invtransform_H_subbands_zero_high_sse4_2_int16_t<1>;
+    break;
+  default:
+    break;
+  }
+
+  return get_invhtransform_subbands_zero_high_c(wavelet_index, sample_size);
+}
+
+SubbandTransformFinal get_invhtransformfinal_subbands_zero_high_sse4_2(int wavelet_index, int active_bits, int sample_size) {
+  if (sample_size == 4) {
+    switch (wavelet_index) {
+    case VC2DECODER_WFT_LEGALL_5_3:
+      switch (active_bits) {
+      case 10: return LeGall_5_3_invtransform_H_subbands_final_zero_high_sse4_2_int32_t<10>;
+      case 12: return LeGall_5_3_invtransform_H_subbands_final_zero_high_sse4_2_int32_t<12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_NO_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int32_t<0, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int32_t<0, 12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int32_t<1, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int32_t<1, 12>;
+      }
+      break;
+    default:
+      break;
+    }
+  } else if (sample_size == 2) {
+    switch (wavelet_index) {
+    case VC2DECODER_WFT_LEGALL_5_3:
+      switch (active_bits) {
+      case 10: return LeGall_5_3_invtransform_H_subbands_final_zero_high_sse4_2_int16_t<10>;
+      case 12: return LeGall_5_3_invtransform_H_subbands_final_zero_high_sse4_2_int16_t<12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_NO_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int16_t<0, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int16_t<0, 12>;
+      }
+      break;
+    case VC2DECODER_WFT_HAAR_SINGLE_SHIFT:
+      switch (active_bits) {
+      case 10: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int16_t<1, 10>;
+      case 12: return Haar_invtransform_H_subbands_final_zero_high_sse4_2_int16_t<1, 12>;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  return get_invhtransformfinal_subbands_zero_high_c(wavelet_index, active_bits, sample_size);
+}
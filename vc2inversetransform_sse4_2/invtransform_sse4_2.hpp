@@ -33,5 +33,11 @@
 VC2EXPORT InplaceTransform get_invvtransform_sse4_2(int wavelet_index, int level, int depth, int sample_size);
 VC2EXPORT InplaceTransform get_invhtransform_sse4_2(int wavelet_index, int level, int depth, int sample_size);
 VC2EXPORT InplaceTransformFinal get_invhtransformfinal_sse4_2(int wavelet_index, int active_bits, int sample_size);
+VC2EXPORT SubbandTransformV get_invvtransform_subbands_sse4_2(int wavelet_index, int sample_size);
+VC2EXPORT SubbandTransformH get_invhtransform_subbands_sse4_2(int wavelet_index, int sample_size);
+VC2EXPORT SubbandTransformFinal get_invhtransformfinal_subbands_sse4_2(int wavelet_index, int active_bits, int sample_size);
+VC2EXPORT SubbandTransformV get_invvtransform_subbands_zero_high_sse4_2(int wavelet_index, int sample_size);
+VC2EXPORT SubbandTransformH get_invhtransform_subbands_zero_high_sse4_2(int wavelet_index, int sample_size);
+VC2EXPORT SubbandTransformFinal get_invhtransformfinal_subbands_zero_high_sse4_2(int wavelet_index, int active_bits, int sample_size);
 
 #endif /* __INVTRANSFORM_SSE4_2_HPP__ */
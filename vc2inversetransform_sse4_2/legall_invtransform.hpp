@@ -472,3 +472,487 @@ void LeGall_5_3_invtransform_H_inplace_2_sse4_2(void *_idata,
     _mm_store_si128((__m128i *)&idata[y*istride + x + 12], Z12);
   }
 }
+
+/* The subband layout versions, which need no shuffling because the low and high pass samples are in rows of
+   their own. Samples past the last whole vector of a row are left to the plain C versions. */
+void LeGall_5_3_invtransform_V_subbands_sse4_2_int32_t(void *_ldata,
+                                                       const int lstride,
+                                                       void *_hdata,
+                                                       const int hstride,
+                                                       const int width,
+                                                       const int height) {
+  int32_t *ldata = (int32_t *)_ldata;
+  int32_t *hdata = (int32_t *)_hdata;
+  const __m128i ONE = _mm_set1_epi32(1);
+  const __m128i TWO = _mm_set1_epi32(2);
+  const int vwidth = width&~3;
+
+  for (int y = 0; y < height; y++) {
+    int32_t *D = &ldata[y*lstride];
+    const int32_t *Dm1 = &hdata[((y > 0) ? (y - 1) : 0)*hstride];
+    const int32_t *Dp1 = &hdata[y*hstride];
+    for (int x = 0; x < vwidth; x += 4) {
+      __m128i X = _mm_sub_epi32(_mm_loadu_si128((__m128i *)&D[x]),
+                                _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_loadu_si128((__m128i *)&Dm1[x]), _mm_loadu_si128((__m128i *)&Dp1[x])), TWO), 2));
+      _mm_storeu_si128((__m128i *)&D[x], X);
+
+      if (y > 0) {
+        int32_t *Xm1 = &hdata[(y - 1)*hstride];
+        __m128i Xm2 = _mm_loadu_si128((__m128i *)&ldata[(y - 1)*lstride + x]);
+        _mm_storeu_si128((__m128i *)&Xm1[x],
+                         _mm_add_epi32(_mm_loadu_si128((__m128i *)&Xm1[x]), _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(Xm2, X), ONE), 1)));
+      }
+    }
+  }
+
+  for (int x = 0; x < vwidth; x += 4) {
+    int32_t *Xp1 = &hdata[(height - 1)*hstride];
+    __m128i X = _mm_loadu_si128((__m128i *)&ldata[(height - 1)*lstride + x]);
+    _mm_storeu_si128((__m128i *)&Xp1[x], _mm_add_epi32(_mm_loadu_si128((__m128i *)&Xp1[x]), _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(X, X), ONE), 1)));
+  }
+
+  if (vwidth < width)
+    LeGall_5_3_invtransform_V_subbands<int32_t>(&ldata[vwidth], lstride, &hdata[vwidth], hstride, width - vwidth, height);
+}
+
+void LeGall_5_3_invtransform_V_subbands_sse4_2_int16_t(void *_ldata,
+                                                       const int lstride,
+                                                       void *_hdata,
+                                                       const int hstride,
+                                                       const int width,
+                                                       const int height) {
+  int16_t *ldata = (int16_t *)_ldata;
+  int16_t *hdata = (int16_t *)_hdata;
+  const __m128i ONE = _mm_set1_epi16(1);
+  const __m128i TWO = _mm_set1_epi16(2);
+  const int vwidth = width&~7;
+
+  for (int y = 0; y < height; y++) {
+    int16_t *D = &ldata[y*lstride];
+    const int16_t *Dm1 = &hdata[((y > 0) ? (y - 1) : 0)*hstride];
+    const int16_t *Dp1 = &hdata[y*hstride];
+    for (int x = 0; x < vwidth; x += 8) {
+      __m128i X = _mm_sub_epi16(_mm_loadu_si128((__m128i *)&D[x]),
+                                _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((__m128i *)&Dm1[x]), _mm_loadu_si128((__m128i *)&Dp1[x])), TWO), 2));
+      _mm_storeu_si128((__m128i *)&D[x], X);
+
+      if (y > 0) {
+        int16_t *Xm1 = &hdata[(y - 1)*hstride];
+        __m128i Xm2 = _mm_loadu_si128((__m128i *)&ldata[(y - 1)*lstride + x]);
+        _mm_storeu_si128((__m128i *)&Xm1[x],
+                         _mm_add_epi16(_mm_loadu_si128((__m128i *)&Xm1[x]), _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(Xm2, X), ONE), 1)));
+      }
+    }
+  }
+
+  for (int x = 0; x < vwidth; x += 8) {
+    int16_t *Xp1 = &hdata[(height - 1)*hstride];
+    __m128i X = _mm_loadu_si128((__m128i *)&ldata[(height - 1)*lstride + x]);
+    _mm_storeu_si128((__m128i *)&Xp1[x], _mm_add_epi16(_mm_loadu_si128((__m128i *)&Xp1[x]), _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(X, X), ONE), 1)));
+  }
+
+  if (vwidth < width)
+    LeGall_5_3_invtransform_V_subbands<int16_t>(&ldata[vwidth], lstride, &hdata[vwidth], hstride, width - vwidth, height);
+}
+
+/* The low pass samples of a vector are lifted along with those of the next one, which gives the following low pass
+   sample each high pass sample needs, so vectors run up to the last whole one before the end of the row */
+void LeGall_5_3_invtransform_H_subbands_sse4_2_int32_t(const void *_ldata,
+                                                       const int lstride,
+                                                       const void *_hdata,
+                                                       const int hstride,
+                                                       void *_odata,
+                                                       const int ostride,
+                                                       const int width,
+                                                       const int height) {
+  const __m128i ONE = _mm_set1_epi32(1);
+  const __m128i TWO = _mm_set1_epi32(2);
+
+  for (int y = 0; y < height; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    const int32_t *H = &((const int32_t *)_hdata)[y*hstride];
+    int32_t *odata = &((int32_t *)_odata)[y*ostride];
+    int x = 0;
+
+    if (width >= 8) {
+      __m128i H0 = _mm_loadu_si128((__m128i *)&H[0]);
+      __m128i E0 = _mm_sub_epi32(_mm_loadu_si128((__m128i *)&L[0]),
+                                 _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_shuffle_epi32(H0, 0x90), H0), TWO), 2)); // {  0  1  2  3 }
+      for (; x + 8 <= width; x += 4) {
+        __m128i H4 = _mm_loadu_si128((__m128i *)&H[x + 4]);
+        __m128i H3 = _mm_loadu_si128((__m128i *)&H[x + 3]);
+        __m128i E4 = _mm_sub_epi32(_mm_loadu_si128((__m128i *)&L[x + 4]),
+                                   _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(H3, H4), TWO), 2)); // {  4  5  6  7 }
+        __m128i E1 = _mm_alignr_epi8(E4, E0, 4); // {  1  2  3  4 }
+        __m128i O0 = _mm_add_epi32(H0, _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(E0, E1), ONE), 1));
+
+        _mm_storeu_si128((__m128i *)&odata[2*x + 0], _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi32(E0, O0), ONE), 1));
+        _mm_storeu_si128((__m128i *)&odata[2*x + 4], _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi32(E0, O0), ONE), 1));
+
+        H0 = H4;
+        E0 = E4;
+      }
+    }
+
+    for (; x < width; x++) {
+      const int32_t X   = L[x] - ((H[(x > 0) ? (x - 1) : 0] + H[x] + 2) >> 2);
+      const int32_t Xp2 = (x < width - 1) ? (L[x + 1] - ((H[x] + H[x + 1] + 2) >> 2)) : X;
+      const int32_t Xp1 = H[x] + ((X + Xp2 + 1) >> 1);
+      odata[2*x + 0] = (X   + 1) >> 1;
+      odata[2*x + 1] = (Xp1 + 1) >> 1;
+    }
+  }
+}
+
+void LeGall_5_3_invtransform_H_subbands_sse4_2_int16_t(const void *_ldata,
+                                                       const int lstride,
+                                                       const void *_hdata,
+                                                       const int hstride,
+                                                       void *_odata,
+                                                       const int ostride,
+                                                       const int width,
+                                                       const int height) {
+  const __m128i ONE = _mm_set1_epi16(1);
+  const __m128i TWO = _mm_set1_epi16(2);
+
+  for (int y = 0; y < height; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    const int16_t *H = &((const int16_t *)_hdata)[y*hstride];
+    int16_t *odata = &((int16_t *)_odata)[y*ostride];
+    int x = 0;
+
+    if (width >= 16) {
+      __m128i H0 = _mm_loadu_si128((__m128i *)&H[0]);
+      __m128i Hm1 = _mm_shufflelo_epi16(_mm_slli_si128(H0, 2), 0xE5);
+      __m128i E0 = _mm_sub_epi16(_mm_loadu_si128((__m128i *)&L[0]),
+                                 _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(Hm1, H0), TWO), 2));
+      for (; x + 16 <= width; x += 8) {
+        __m128i H8 = _mm_loadu_si128((__m128i *)&H[x + 8]);
+        __m128i H7 = _mm_loadu_si128((__m128i *)&H[x + 7]);
+        __m128i E8 = _mm_sub_epi16(_mm_loadu_si128((__m128i *)&L[x + 8]),
+                                   _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(H7, H8), TWO), 2));
+        __m128i E1 = _mm_alignr_epi8(E8, E0, 2);
+        __m128i O0 = _mm_add_epi16(H0, _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(E0, E1), ONE), 1));
+
+        _mm_storeu_si128((__m128i *)&odata[2*x + 0], _mm_srai_epi16(_mm_add_epi16(_mm_unpacklo_epi16(E0, O0), ONE), 1));
+        _mm_storeu_si128((__m128i *)&odata[2*x + 8], _mm_srai_epi16(_mm_add_epi16(_mm_unpackhi_epi16(E0, O0), ONE), 1));
+
+        H0 = H8;
+        E0 = E8;
+      }
+    }
+
+    for (; x < width; x++) {
+      const int32_t X   = L[x] - ((H[(x > 0) ? (x - 1) : 0] + H[x] + 2) >> 2);
+      const int32_t Xp2 = (x < width - 1) ? (L[x + 1] - ((H[x] + H[x + 1] + 2) >> 2)) : X;
+      const int32_t Xp1 = H[x] + ((X + Xp2 + 1) >> 1);
+      odata[2*x + 0] = (X   + 1) >> 1;
+      odata[2*x + 1] = (Xp1 + 1) >> 1;
+    }
+  }
+}
+
+/* Only whole vectors of sample pairs inside the output are done here, the odd sample at either end of the
+   output and any left past the last whole vector are done by the C version */
+template<int active_bits> void LeGall_5_3_invtransform_H_subbands_final_sse4_2_int32_t(const void *_ldata,
+                                                                                       const int lstride,
+                                                                                       const void *_hdata,
+                                                                                       const int hstride,
+                                                                                       const char *odata,
+                                                                                       const int ostride,
+                                                                                       const int width,
+                                                                                       const int height,
+                                                                                       const int ooffset_x,
+                                                                                       const int owidth) {
+  const __m128i ONE = _mm_set1_epi32(1);
+  const __m128i TWO = _mm_set1_epi32(2);
+  const __m128i OFFSET = _mm_set1_epi32(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width - 4);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/4)*4 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    const int32_t *H = &((const int32_t *)_hdata)[y*hstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+
+    __m128i H0 = _mm_loadu_si128((__m128i *)&H[x0]);
+    __m128i Hm1 = (x0 > 0) ? _mm_loadu_si128((__m128i *)&H[x0 - 1]) : _mm_shuffle_epi32(H0, 0x90);
+    __m128i E0 = _mm_sub_epi32(_mm_loadu_si128((__m128i *)&L[x0]), _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(Hm1, H0), TWO), 2));
+    for (int x = x0; x < xe; x += 4) {
+      __m128i H4 = _mm_loadu_si128((__m128i *)&H[x + 4]);
+      __m128i H3 = _mm_loadu_si128((__m128i *)&H[x + 3]);
+      __m128i E4 = _mm_sub_epi32(_mm_loadu_si128((__m128i *)&L[x + 4]),
+                                 _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(H3, H4), TWO), 2));
+      __m128i E1 = _mm_alignr_epi8(E4, E0, 4);
+      __m128i O0 = _mm_add_epi32(H0, _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(E0, E1), ONE), 1));
+
+      __m128i Z0 = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi32(E0, O0), ONE), 1), OFFSET);
+      __m128i Z4 = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi32(E0, O0), ONE), 1), OFFSET);
+      _mm_storeu_si128((__m128i *)&optr[2*x], _mm_min_epu16(_mm_packus_epi32(Z0, Z4), CLIP));
+
+      H0 = H4;
+      E0 = E4;
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    LeGall_5_3_invtransform_H_subbands_final<active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                   width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    LeGall_5_3_invtransform_H_subbands_final<active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                   width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
+
+template<int active_bits> void LeGall_5_3_invtransform_H_subbands_final_sse4_2_int16_t(const void *_ldata,
+                                                                                       const int lstride,
+                                                                                       const void *_hdata,
+                                                                                       const int hstride,
+                                                                                       const char *odata,
+                                                                                       const int ostride,
+                                                                                       const int width,
+                                                                                       const int height,
+                                                                                       const int ooffset_x,
+                                                                                       const int owidth) {
+  const __m128i ONE = _mm_set1_epi16(1);
+  const __m128i TWO = _mm_set1_epi16(2);
+  const __m128i OFFSET = _mm_set1_epi16(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+  const __m128i ZERO = _mm_setzero_si128();
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width - 8);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/8)*8 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    const int16_t *H = &((const int16_t *)_hdata)[y*hstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+
+    __m128i H0 = _mm_loadu_si128((__m128i *)&H[x0]);
+    __m128i Hm1 = (x0 > 0) ? _mm_loadu_si128((__m128i *)&H[x0 - 1]) : _mm_shufflelo_epi16(_mm_slli_si128(H0, 2), 0xE5);
+    __m128i E0 = _mm_sub_epi16(_mm_loadu_si128((__m128i *)&L[x0]), _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(Hm1, H0), TWO), 2));
+    for (int x = x0; x < xe; x += 8) {
+      __m128i H8 = _mm_loadu_si128((__m128i *)&H[x + 8]);
+      __m128i H7 = _mm_loadu_si128((__m128i *)&H[x + 7]);
+      __m128i E8 = _mm_sub_epi16(_mm_loadu_si128((__m128i *)&L[x + 8]),
+                                 _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(H7, H8), TWO), 2));
+      __m128i E1 = _mm_alignr_epi8(E8, E0, 2);
+      __m128i O0 = _mm_add_epi16(H0, _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(E0, E1), ONE), 1));
+
+      __m128i Z0 = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_unpacklo_epi16(E0, O0), ONE), 1), OFFSET);
+      __m128i Z8 = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_unpackhi_epi16(E0, O0), ONE), 1), OFFSET);
+      _mm_storeu_si128((__m128i *)&optr[2*x + 0], _mm_max_epi16(_mm_min_epi16(Z0, CLIP), ZERO));
+      _mm_storeu_si128((__m128i *)&optr[2*x + 8], _mm_max_epi16(_mm_min_epi16(Z8, CLIP), ZERO));
+
+      H0 = H8;
+      E0 = E8;
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    LeGall_5_3_invtransform_H_subbands_final<active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                   width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    LeGall_5_3_invtransform_H_subbands_final<active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                   width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
+
+/* The zero_high versions, which only read the low pass subband */
+void LeGall_5_3_invtransform_V_subbands_zero_high_sse4_2_int32_t(void *_ldata,
+                                                                 const int lstride,
+                                                                 void *_hdata,
+                                                                 const int hstride,
+                                                                 const int width,
+                                                                 const int height) {
+  const int32_t *ldata = (const int32_t *)_ldata;
+  int32_t *hdata = (int32_t *)_hdata;
+  const __m128i ONE = _mm_set1_epi32(1);
+  const int vwidth = width&~3;
+
+  for (int y = 0; y < height; y++) {
+    const int32_t *X = &ldata[y*lstride];
+    const int32_t *Xp2 = &ldata[((y < height - 1) ? (y + 1) : y)*lstride];
+    int32_t *Xp1 = &hdata[y*hstride];
+    for (int x = 0; x < vwidth; x += 4)
+      _mm_storeu_si128((__m128i *)&Xp1[x],
+                       _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_loadu_si128((__m128i *)&X[x]), _mm_loadu_si128((__m128i *)&Xp2[x])), ONE), 1));
+  }
+
+  if (vwidth < width)
+    LeGall_5_3_invtransform_V_subbands_zero_high<int32_t>(&((int32_t *)_ldata)[vwidth], lstride, &hdata[vwidth], hstride, width - vwidth, height);
+}
+
+void LeGall_5_3_invtransform_V_subbands_zero_high_sse4_2_int16_t(void *_ldata,
+                                                                 const int lstride,
+                                                                 void *_hdata,
+                                                                 const int hstride,
+                                                                 const int width,
+                                                                 const int height) {
+  const int16_t *ldata = (const int16_t *)_ldata;
+  int16_t *hdata = (int16_t *)_hdata;
+  const __m128i ONE = _mm_set1_epi16(1);
+  const int vwidth = width&~7;
+
+  for (int y = 0; y < height; y++) {
+    const int16_t *X = &ldata[y*lstride];
+    const int16_t *Xp2 = &ldata[((y < height - 1) ? (y + 1) : y)*lstride];
+    int16_t *Xp1 = &hdata[y*hstride];
+    for (int x = 0; x < vwidth; x += 8)
+      _mm_storeu_si128((__m128i *)&Xp1[x],
+                       _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((__m128i *)&X[x]), _mm_loadu_si128((__m128i *)&Xp2[x])), ONE), 1));
+  }
+
+  if (vwidth < width)
+    LeGall_5_3_invtransform_V_subbands_zero_high<int16_t>(&((int16_t *)_ldata)[vwidth], lstride, &hdata[vwidth], hstride, width - vwidth, height);
+}
+
+void LeGall_5_3_invtransform_H_subbands_zero_high_sse4_2_int32_t(const void *_ldata,
+                                                                 const int lstride,
+                                                                 const void *,
+                                                                 const int,
+                                                                 void *_odata,
+                                                                 const int ostride,
+                                                                 const int width,
+                                                                 const int height) {
+  const __m128i ONE = _mm_set1_epi32(1);
+
+  for (int y = 0; y < height; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    int32_t *odata = &((int32_t *)_odata)[y*ostride];
+    int x = 0;
+
+    for (; x + 4 < width; x += 4) {
+      __m128i E0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i E1 = _mm_loadu_si128((__m128i *)&L[x + 1]);
+      __m128i O0 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(E0, E1), ONE), 1);
+
+      _mm_storeu_si128((__m128i *)&odata[2*x + 0], _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi32(E0, O0), ONE), 1));
+      _mm_storeu_si128((__m128i *)&odata[2*x + 4], _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi32(E0, O0), ONE), 1));
+    }
+
+    for (; x < width; x++) {
+      const int32_t X   = L[x];
+      const int32_t Xp1 = (x < width - 1) ? ((X + L[x + 1] + 1) >> 1) : X;
+      odata[2*x + 0] = (X   + 1) >> 1;
+      odata[2*x + 1] = (Xp1 + 1) >> 1;
+    }
+  }
+}
+
+void LeGall_5_3_invtransform_H_subbands_zero_high_sse4_2_int16_t(const void *_ldata,
+                                                                 const int lstride,
+                                                                 const void *,
+                                                                 const int,
+                                                                 void *_odata,
+                                                                 const int ostride,
+                                                                 const int width,
+                                                                 const int height) {
+  const __m128i ONE = _mm_set1_epi16(1);
+
+  for (int y = 0; y < height; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    int16_t *odata = &((int16_t *)_odata)[y*ostride];
+    int x = 0;
+
+    for (; x + 8 < width; x += 8) {
+      __m128i E0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i E1 = _mm_loadu_si128((__m128i *)&L[x + 1]);
+      __m128i O0 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(E0, E1), ONE), 1);
+
+      _mm_storeu_si128((__m128i *)&odata[2*x + 0], _mm_srai_epi16(_mm_add_epi16(_mm_unpacklo_epi16(E0, O0), ONE), 1));
+      _mm_storeu_si128((__m128i *)&odata[2*x + 8], _mm_srai_epi16(_mm_add_epi16(_mm_unpackhi_epi16(E0, O0), ONE), 1));
+    }
+
+    for (; x < width; x++) {
+      const int32_t X   = L[x];
+      const int32_t Xp1 = (x < width - 1) ? ((X + L[x + 1] + 1) >> 1) : X;
+      odata[2*x + 0] = (X   + 1) >> 1;
+      odata[2*x + 1] = (Xp1 + 1) >> 1;
+    }
+  }
+}
+
+template<int active_bits> void LeGall_5_3_invtransform_H_subbands_final_zero_high_sse4_2_int32_t(const void *_ldata,
+                                                                                                 const int lstride,
+                                                                                                 const void *_hdata,
+                                                                                                 const int hstride,
+                                                                                                 const char *odata,
+                                                                                                 const int ostride,
+                                                                                                 const int width,
+                                                                                                 const int height,
+                                                                                                 const int ooffset_x,
+                                                                                                 const int owidth) {
+  const __m128i ONE = _mm_set1_epi32(1);
+  const __m128i OFFSET = _mm_set1_epi32(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width - 4);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/4)*4 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int32_t *L = &((const int32_t *)_ldata)[y*lstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+    for (int x = x0; x < xe; x += 4) {
+      __m128i E0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i E1 = _mm_loadu_si128((__m128i *)&L[x + 1]);
+      __m128i O0 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(E0, E1), ONE), 1);
+
+      __m128i Z0 = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi32(E0, O0), ONE), 1), OFFSET);
+      __m128i Z4 = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi32(E0, O0), ONE), 1), OFFSET);
+      _mm_storeu_si128((__m128i *)&optr[2*x], _mm_min_epu16(_mm_packus_epi32(Z0, Z4), CLIP));
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    LeGall_5_3_invtransform_H_subbands_final_zero_high<active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                             width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    LeGall_5_3_invtransform_H_subbands_final_zero_high<active_bits, int32_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                             width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
+
+template<int active_bits> void LeGall_5_3_invtransform_H_subbands_final_zero_high_sse4_2_int16_t(const void *_ldata,
+                                                                                                 const int lstride,
+                                                                                                 const void *_hdata,
+                                                                                                 const int hstride,
+                                                                                                 const char *odata,
+                                                                                                 const int ostride,
+                                                                                                 const int width,
+                                                                                                 const int height,
+                                                                                                 const int ooffset_x,
+                                                                                                 const int owidth) {
+  const __m128i ONE = _mm_set1_epi16(1);
+  const __m128i OFFSET = _mm_set1_epi16(1 << (active_bits - 1));
+  const __m128i CLIP = _mm_set1_epi16((1 << active_bits) - 1);
+  const __m128i ZERO = _mm_setzero_si128();
+
+  const int x0 = (ooffset_x + 1)/2;
+  const int x1 = MIN((ooffset_x + owidth)/2, width - 8);
+  const int xe = (x1 > x0) ? x0 + ((x1 - x0)/8)*8 : x0;
+
+  for (int y = 0; y < height && xe > x0; y++) {
+    const int16_t *L = &((const int16_t *)_ldata)[y*lstride];
+    uint16_t *optr = &((uint16_t *)odata)[y*ostride - ooffset_x];
+    for (int x = x0; x < xe; x += 8) {
+      __m128i E0 = _mm_loadu_si128((__m128i *)&L[x]);
+      __m128i E1 = _mm_loadu_si128((__m128i *)&L[x + 1]);
+      __m128i O0 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(E0, E1), ONE), 1);
+
+      __m128i Z0 = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_unpacklo_epi16(E0, O0), ONE), 1), OFFSET);
+      __m128i Z8 = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_unpackhi_epi16(E0, O0), ONE), 1), OFFSET);
+      _mm_storeu_si128((__m128i *)&optr[2*x + 0], _mm_max_epi16(_mm_min_epi16(Z0, CLIP), ZERO));
+      _mm_storeu_si128((__m128i *)&optr[2*x + 8], _mm_max_epi16(_mm_min_epi16(Z8, CLIP), ZERO));
+    }
+  }
+
+  if (ooffset_x%2 != 0 && owidth > 0)
+    LeGall_5_3_invtransform_H_subbands_final_zero_high<active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata, ostride,
+                                                                             width, height, ooffset_x, 1);
+  if (2*xe < ooffset_x + owidth)
+    LeGall_5_3_invtransform_H_subbands_final_zero_high<active_bits, int16_t>(_ldata, lstride, _hdata, hstride, odata + (2*xe - ooffset_x)*2, ostride,
+                                                                             width, height, 2*xe, ooffset_x + owidth - 2*xe);
+}
@@ -26,8 +26,11 @@
 #include "logger.hpp"
 #include "internal.h"
 #include "vlc.hpp"
+#include "platform_variant.hpp"
 #include "../vc2inversetransform_c/vlc_c.hpp"
 #include <cstdio>
+#include <stdlib.h>
+#include <string.h>
 #include <immintrin.h>
 
 #ifdef DEBUG
@@ -43,94 +46,283 @@ extern int DEBUG_P_SLICE_H;
 #endif
 
 
-/* These are used for decoding actual coded coefficients */
-inline int decode_sse4_2(uint8_t *idata, int ilength, int32_t *odata, int olength) {
-  int icounter = 1;
-  int ocounter = 0;
-  int32_t V = 0;
-  int state;
+/* Coefficients are decoded to the same size as the samples of the plane they end up in, so
+   those for 16-bit planes are written eight to a register. These write out the eight coefficients
+   of a LUT entry, the values of which sit in its top four bytes, with the first given separately. */
+template<class T> inline void store_step_sse4_2(T *odata, const CompactLUTEntry &E, int32_t first);
 
-  _mm_prefetch((char *)idata, _MM_HINT_T0);
-  _mm_prefetch((char *)odata, _MM_HINT_T0);
+template<> inline void store_step_sse4_2<int32_t>(int32_t *odata, const CompactLUTEntry &E, int32_t first) {
+  __m128i B = _mm_cvtepi8_epi32(_mm_srli_epi64(_mm_loadl_epi64((__m128i *)&E), 24));
+  B = _mm_insert_epi32(B, first, 0);
 
-  const __m128i ZERO = _mm_set1_epi8(0);
+  _mm_storeu_si128((__m128i *)&odata[0], B);
+  _mm_storeu_si128((__m128i *)&odata[4], _mm_cvtsi32_si128(E.val[3]));
+}
 
-  const LUTEntry *next;
-  if (ilength > 0)
-    next = &VLCLUT[idata[0]];
-  else
-    next = &VLCLUT[0xFF];
+template<> inline void store_step_sse4_2<int16_t>(int16_t *odata, const CompactLUTEntry &E, int32_t first) {
+  __m128i B = _mm_cvtepi8_epi16(_mm_srli_epi64(_mm_loadl_epi64((__m128i *)&E), 24));
+  B = _mm_insert_epi16(B, first, 0);
 
-  while (icounter < ilength && ocounter < olength) {
-    __m128i E = _mm_load_si128((__m128i *)next);
-    next  = &VLCLUT[(((int)_mm_extract_epi8(E, 0)) << 8) + idata[icounter++]];
+  _mm_storeu_si128((__m128i *)&odata[0], B);
+}
 
-    V <<= _mm_extract_epi8(E, 1); // preshift
-    V +=  _mm_extract_epi8(E, 8); // val0
+/* Writes out eight zero coefficients */
+template<class T> inline void store_zeros_sse4_2(T *odata) {
+  const __m128i ZERO = _mm_setzero_si128();
+  for (int i = 0; i < (int)(8*sizeof(T)); i += 16)
+    _mm_storeu_si128((__m128i *)((char *)odata + i), ZERO);
+}
 
-    __m128i A = _mm_unpackhi_epi8(ZERO, E);
-    __m128i B = _mm_srai_epi32(_mm_unpacklo_epi16(ZERO, A), 24);
-    __m128i C = _mm_srai_epi32(_mm_unpackhi_epi16(ZERO, A), 24);
+/* A single step of the state machine, consumes one byte and writes out up to eight coefficients.
+   Only the first five of them can be nonzero. */
+template<class T> inline void step_sse4_2(const CompactLUTEntry *LUT, const CompactLUTEntry *&next, uint8_t byte, int32_t &V, T *odata, int &ocounter) {
+  const CompactLUTEntry &E = *next;
+  next  = &LUT[(((int)E.state) << 8) + byte];
 
-    B = _mm_insert_epi32(B, (V - 1)*((int8_t)_mm_extract_epi8(E, 2)), 0);
+  V <<= E.preshift_sgn & 0x1F;
+  V |=  E.val0;
 
-    _mm_storeu_si128((__m128i *)&odata[ocounter],     B);
-    _mm_storeu_si128((__m128i *)&odata[ocounter + 4], C);
+  store_step_sse4_2<T>(&odata[ocounter], E, (V - 1)*(((int8_t)E.preshift_sgn) >> 6));
 
-    if (_mm_extract_epi8(E, 3))         // term
-      V = _mm_extract_epi8(E, 4);       // V
-    ocounter += _mm_extract_epi8(E, 5); // N
-  }
+  if (E.N_V & 0xF)
+    V = E.N_V >> 4;
+  ocounter += E.N_V & 0xF;
+}
 
-  if (icounter < ilength) {
-    return ilength - icounter;
+/* Coded data which ends in 0xFF bytes decodes the same as if they were missing, since missing
+   bytes are read as all ones. Slices are padded out with them, and the heavily quantised high
+   frequency subbands at the end of a slice code as long runs of them. Counts how many there
+   are at the end, sixteen bytes at a time. */
+inline int trailing_ones_sse4_2(uint8_t *idata, int ilength) {
+  const __m128i ONES = _mm_set1_epi8(-1);
+  int n = ilength;
+  for (; n >= 16; n -= 16) {
+    const unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)&idata[n - 16]), ONES));
+    if (mask != 0xFFFF)
+      return ilength - n + __builtin_clz((~mask & 0xFFFF) << 16);
   }
+  while (n > 0 && idata[n - 1] == 0xFF)
+    n--;
+  return ilength - n;
+}
 
-  if (ocounter < olength) {
-    __m128i E = _mm_load_si128((__m128i *)next);
-    state = (int)_mm_extract_epi8(E, 0);
+/* Carries on decoding a component from part way through. Everything after the first coded
+   bytes is 0xFF, and once the state machine is back at the start each of those bytes is eight
+   zeros, so they are written out together rather than stepped through. */
+template<class T> inline int decode_sse4_2_from(const CompactLUTEntry *LUT, uint8_t *idata, int ilength, int coded, int icounter, T *odata, int olength, int ocounter, int32_t V, const CompactLUTEntry *next) {
+  int state;
 
-    V <<= _mm_extract_epi8(E, 1); // preshift
-    V +=  _mm_extract_epi8(E, 8); // val0
+  while (icounter < coded && ocounter < olength)
+    step_sse4_2(LUT, next, idata[icounter++], V, odata, ocounter);
 
-    __m128i A = _mm_unpackhi_epi8(ZERO, E);
-    __m128i B = _mm_srai_epi32(_mm_unpacklo_epi16(ZERO, A), 24);
-    __m128i C = _mm_srai_epi32(_mm_unpackhi_epi16(ZERO, A), 24);
+  while (icounter < ilength && ocounter < olength && next != &LUT[0xFF])
+    step_sse4_2(LUT, next, idata[icounter++], V, odata, ocounter);
 
-    B = _mm_insert_epi32(B, (V - 1)*((int8_t)_mm_extract_epi8(E, 2)), 0);
+  if (icounter < ilength && ocounter < olength) {
+    int run = (olength - ocounter + 7)/8;
+    if (run > ilength - icounter)
+      run = ilength - icounter;
+    for (int i = 0; i < run; i++)
+      store_zeros_sse4_2<T>(&odata[ocounter + 8*i]);
+    icounter += run;
+    ocounter += 8*run;
+  }
 
-    _mm_storeu_si128((__m128i *)&odata[ocounter],     B);
-    _mm_storeu_si128((__m128i *)&odata[ocounter + 4], C);
+  if (icounter < ilength) {
+    return ilength - icounter;
+  }
 
-    if (_mm_extract_epi8(E, 3))         // term
-      V = _mm_extract_epi8(E, 4);       // V
-    ocounter += _mm_extract_epi8(E, 5); // N
+  if (ocounter < olength) {
+    state = next->state;
+    step_sse4_2(LUT, next, 0, V, odata, ocounter);
   }
 
   if (ocounter < olength) {
-    __m128i TMP = ZERO;
+    int32_t last = 0;
     switch (state) {
     case STATE_DATA:
       V <<= 1;
       V += 1;
     case STATE_FOLLOW:
     case STATE_SIGN:
-      _mm_insert_epi32(TMP, -(V - 1), 0);
+      last = -(V - 1);
     }
-    _mm_storeu_si128((__m128i *)&odata[ocounter], TMP);
-    ocounter = (ocounter + 4)&0xFFFFFFFC;
+    store_zeros_sse4_2<T>(&odata[ocounter]);
+    odata[ocounter] = last;
+    ocounter += 8;
   }
 
-  while (ocounter < olength) {
-    _mm_store_si128((__m128i *)&odata[ocounter], ZERO);
-    ocounter+=4;
-  }
+  for (; ocounter < olength; ocounter += 8)
+    store_zeros_sse4_2<T>(&odata[ocounter]);
 
   return 0;
 }
 
+/* These are used for decoding actual coded coefficients */
+template<class T> inline int decode_sse4_2(uint8_t *idata, int ilength, T *odata, int olength) {
+  _mm_prefetch((char *)idata, _MM_HINT_T0);
+  _mm_prefetch((char *)odata, _MM_HINT_T0);
+
+  const CompactLUTEntry *LUT = compact_vlc_lut();
+  return decode_sse4_2_from(LUT, idata, ilength, ilength - trailing_ones_sse4_2(idata, ilength), 1, odata, olength, 0, 0, (ilength > 0) ? &LUT[idata[0]] : &LUT[0xFF]);
+}
 
-template<class T> void decode_slices_sse4_2(QuantisationMatrix *matrices,
+/* Decodes several components at once. Each step of the state machine has to wait for the
+   LUT entry loaded by the one before, so the components are stepped in turn to give the
+   processor independent lookups to overlap. A component drops out when it is finished. */
+template<class T> inline void decode_interleaved_sse4_2(const CompactLUTEntry *LUT, int n, uint8_t **idata, int *ilength, T **odata, int *olength, int *padding) {
+  int coded[3*VLC_SCRATCH_SLICES];
+  int icounter[3*VLC_SCRATCH_SLICES];
+  int ocounter[3*VLC_SCRATCH_SLICES];
+  int32_t V[3*VLC_SCRATCH_SLICES];
+  const CompactLUTEntry *next[3*VLC_SCRATCH_SLICES];
+  int live[3*VLC_SCRATCH_SLICES];
+
+  for (int j = 0; j < n; j++) {
+    _mm_prefetch((char *)idata[j], _MM_HINT_T0);
+    _mm_prefetch((char *)odata[j], _MM_HINT_T0);
+    coded[j]    = ilength[j] - trailing_ones_sse4_2(idata[j], ilength[j]);
+    icounter[j] = 1;
+    ocounter[j] = 0;
+    V[j]        = 0;
+    next[j]     = (ilength[j] > 0) ? &LUT[idata[j][0]] : &LUT[0xFF];
+    live[j]     = j;
+  }
+
+  while (n > 0) {
+    /* No component can run out of input or output within this many steps */
+    int steps = coded[live[0]];
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if (coded[j] - icounter[j] < steps)
+        steps = coded[j] - icounter[j];
+      if ((olength[j] - ocounter[j] + 7)/8 < steps)
+        steps = (olength[j] - ocounter[j] + 7)/8;
+    }
+
+    for (int s = 0; s < steps; s++) {
+      for (int k = 0; k < n; k++) {
+        const int j = live[k];
+        step_sse4_2(LUT, next[j], idata[j][icounter[j]++], V[j], odata[j], ocounter[j]);
+      }
+    }
+
+    int m = 0;
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if (icounter[j] < coded[j] && ocounter[j] < olength[j])
+        live[m++] = j;
+      else
+        padding[j] = decode_sse4_2_from(LUT, idata[j], ilength[j], coded[j], icounter[j], odata[j], olength[j], ocounter[j], V[j], next[j]);
+    }
+    n = m;
+  }
+}
+
+
+/* Writes out the twelve coefficients of a wide LUT entry, given as bytes, with the first given separately */
+template<class T> inline void store_wide_step_sse4_2(T *odata, __m128i X, int32_t first);
+
+template<> inline void store_wide_step_sse4_2<int32_t>(int32_t *odata, __m128i X, int32_t first) {
+  __m128i A = _mm_insert_epi32(_mm_cvtepi8_epi32(X), first, 0);
+  __m128i B = _mm_cvtepi8_epi32(_mm_srli_si128(X, 4));
+  __m128i C = _mm_cvtepi8_epi32(_mm_srli_si128(X, 8));
+
+  _mm_storeu_si128((__m128i *)&odata[0], A);
+  _mm_storeu_si128((__m128i *)&odata[4], B);
+  _mm_storeu_si128((__m128i *)&odata[8], C);
+}
+
+template<> inline void store_wide_step_sse4_2<int16_t>(int16_t *odata, __m128i X, int32_t first) {
+  __m128i A = _mm_insert_epi16(_mm_cvtepi8_epi16(X), first, 0);
+  __m128i B = _mm_cvtepi8_epi16(_mm_srli_si128(X, 8));
+
+  _mm_storeu_si128((__m128i *)&odata[0], A);
+  _mm_storeu_si128((__m128i *)&odata[8], B);
+}
+
+/* A step through the wide table, which takes twelve bits and writes out up to twelve coefficients */
+template<class T> inline void wide_step_sse4_2(const WideLUTEntry *LUT, uint8_t &state, int bits, int32_t &V, T *odata, int &ocounter) {
+  const WideLUTEntry &E = LUT[(((int)state) << WIDE_VLC_BITS) + bits];
+
+  V <<= E.preshift;
+  V |=  E.val[0];
+
+  store_wide_step_sse4_2<T>(&odata[ocounter], _mm_loadu_si128((__m128i *)E.val), (V - 1)*E.sgn);
+
+  if (E.term)
+    V = E.V;
+  ocounter += E.N;
+  state = E.state;
+}
+
+/* Takes the next three bytes through the wide table */
+template<class T> inline void wide_steps_sse4_2(const WideLUTEntry *LUT, uint8_t &state, uint8_t *idata, int32_t &V, T *odata, int &ocounter) {
+  wide_step_sse4_2(LUT, state, (idata[0] << 4) | (idata[1] >> 4), V, odata, ocounter);
+  wide_step_sse4_2(LUT, state, ((idata[1]&0xF) << 8) | idata[2], V, odata, ocounter);
+}
+
+/* Carries on a byte at a time from where the wide table left off. A missing byte
+   is read as all ones, which is how the end of the coded data is treated anyway */
+template<class T> inline int decode_sse4_2_after_wide(uint8_t *idata, int ilength, int coded, int icounter, T *odata, int olength, int ocounter, int32_t V, uint8_t state) {
+  const CompactLUTEntry *LUT = compact_vlc_lut();
+  const CompactLUTEntry *next = &LUT[(((int)state) << 8) + ((icounter < ilength) ? idata[icounter] : 0xFF)];
+  return decode_sse4_2_from(LUT, idata, ilength, coded, icounter + 1, odata, olength, ocounter, V, next);
+}
+
+/* As decode_interleaved_sse4_2 but using the wide table, three bytes to a step. A component
+   only takes a step whilst the output can't fill up part way through it, so that the padding
+   comes out the same, and is finished off a byte at a time once it can't. */
+template<class T> inline void decode_interleaved_wide_sse4_2(const WideLUTEntry *LUT, int n, uint8_t **idata, int *ilength, T **odata, int *olength, int *padding) {
+  int coded[3*VLC_SCRATCH_SLICES];
+  int icounter[3*VLC_SCRATCH_SLICES];
+  int ocounter[3*VLC_SCRATCH_SLICES];
+  int32_t V[3*VLC_SCRATCH_SLICES];
+  uint8_t state[3*VLC_SCRATCH_SLICES];
+  int live[3*VLC_SCRATCH_SLICES];
+
+  for (int j = 0; j < n; j++) {
+    _mm_prefetch((char *)idata[j], _MM_HINT_T0);
+    _mm_prefetch((char *)odata[j], _MM_HINT_T0);
+    coded[j]    = ilength[j] - trailing_ones_sse4_2(idata[j], ilength[j]);
+    icounter[j] = 0;
+    ocounter[j] = 0;
+    V[j]        = 0;
+    state[j]    = STATE_START;
+    live[j]     = j;
+  }
+
+  while (n > 0) {
+    int steps = coded[live[0]];
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if ((coded[j] - icounter[j])/3 < steps)
+        steps = (coded[j] - icounter[j])/3;
+      if ((olength[j] - ocounter[j] - 1)/24 < steps)
+        steps = (olength[j] - ocounter[j] - 1)/24;
+    }
+
+    for (int s = 0; s < steps; s++) {
+      for (int k = 0; k < n; k++) {
+        const int j = live[k];
+        wide_steps_sse4_2(LUT, state[j], &idata[j][icounter[j]], V[j], odata[j], ocounter[j]);
+        icounter[j] += 3;
+      }
+    }
+
+    int m = 0;
+    for (int k = 0; k < n; k++) {
+      const int j = live[k];
+      if (icounter[j] + 3 <= coded[j] && ocounter[j] + 24 < olength[j])
+        live[m++] = j;
+      else
+        padding[j] = decode_sse4_2_after_wide(idata[j], ilength[j], coded[j], icounter[j], odata[j], olength[j], ocounter[j], V[j], state[j]);
+    }
+    n = m;
+  }
+}
+
+template<class T, bool WIDE> void decode_slices_sse4_2(QuantisationMatrix *matrices,
                                        CodedSlice * const input,
                                        DecodedSlice ** scratch,
                                        int n_slices_x,
@@ -140,33 +332,65 @@ template<class T> void decode_slices_sse4_2(QuantisationMatrix *matrices,
                                        int slice_height,
                                        int depth,
                                        DequantiseFunction *dequant) {
-  for (int i = 0; i < 16384; i += 64)
-    _mm_prefetch(((char *)VLCLUT) + i, _MM_HINT_T0);
+  const WideLUTEntry *LUT = WIDE ? wide_vlc_lut() : NULL;
+  const CompactLUTEntry *CLUT = compact_vlc_lut();
+  if (!WIDE) {
+    for (int i = 0; i < 4*256*(int)sizeof(CompactLUTEntry); i += 64)
+      _mm_prefetch(((char *)CLUT) + i, _MM_HINT_T0);
+  }
+  T *bands[3*MAX_DWT_DEPTH + 1];
 
   for (int Y = 0; Y < n_slices_y; Y++) {
-    for (int X = 0; X < n_slices_x; X++) {
-      const int n = Y*n_slices_x + X;
-      int padding = 0;
-      padding += decode_sse4_2((uint8_t *)input[n].data[0], input[n].length[0], scratch[0]->data, scratch[0]->size);
-      _mm_prefetch((char *)&matrices[input[n].qindex], _MM_HINT_T0);
-      _mm_prefetch((char *)&video_data[0]->as<T>()[Y*slice_height*video_data[0]->stride + X*slice_width], _MM_HINT_T0);
-      dequant[0](&matrices[input[n].qindex], scratch[0]->data,
-                 &video_data[0]->as<T>()[Y*slice_height*video_data[0]->stride + X*slice_width], video_data[0]->stride,
-                 slice_width, slice_height, depth);
-
-      padding += decode_sse4_2((uint8_t *)input[n].data[1], input[n].length[1], scratch[1]->data, scratch[1]->size);
-      _mm_prefetch((char *)&video_data[1]->as<T>()[Y*slice_height*video_data[1]->stride + X*slice_width], _MM_HINT_T0);
-      dequant[1](&matrices[input[n].qindex], scratch[1]->data,
-                 &video_data[1]->as<T>()[Y*slice_height*video_data[1]->stride + X*slice_width/2], video_data[1]->stride,
-                 slice_width/2, slice_height, depth);
-
-      padding += decode_sse4_2((uint8_t *)input[n].data[2], input[n].length[2], scratch[2]->data, scratch[2]->size);
-      _mm_prefetch((char *)&video_data[2]->as<T>()[Y*slice_height*video_data[2]->stride + X*slice_width], _MM_HINT_T0);
-      dequant[2](&matrices[input[n].qindex], scratch[2]->data,
-                 &video_data[2]->as<T>()[Y*slice_height*video_data[2]->stride + X*slice_width/2], video_data[2]->stride,
-                 slice_width/2, slice_height, depth);
+    for (int X = 0; X < n_slices_x; X += VLC_SCRATCH_SLICES) {
+      const int K = (n_slices_x - X < VLC_SCRATCH_SLICES) ? (n_slices_x - X) : VLC_SCRATCH_SLICES;
+      uint8_t *idata[3*VLC_SCRATCH_SLICES];
+      int ilength[3*VLC_SCRATCH_SLICES];
+      T *odata[3*VLC_SCRATCH_SLICES];
+      int olength[3*VLC_SCRATCH_SLICES];
+      int padding[3*VLC_SCRATCH_SLICES + 1];
+      int slot[3*VLC_SCRATCH_SLICES];
+
+      /* Components with no coded data are left out, and given the spare slot at the end which has no padding */
+      int m = 0;
+      for (int k = 0; k < K; k++) {
+        const int n = Y*n_slices_x + X + k;
+        for (int c = 0; c < 3; c++) {
+          if (input[n].length[c] == 0) {
+            slot[3*k + c] = 3*VLC_SCRATCH_SLICES;
+            continue;
+          }
+          slot[3*k + c] = m;
+          idata[m]   = (uint8_t *)input[n].data[c];
+          ilength[m] = input[n].length[c];
+          odata[m]   = scratch[3*k + c]->as<T>();
+          olength[m] = scratch[3*k + c]->size;
+          m++;
+        }
+      }
+      for (int j = 0; j <= 3*VLC_SCRATCH_SLICES; j++)
+        padding[j] = 0;
+      if (WIDE)
+        decode_interleaved_wide_sse4_2(LUT, m, idata, ilength, odata, olength, padding);
+      else
+        decode_interleaved_sse4_2(CLUT, m, idata, ilength, odata, olength, padding);
+
+      for (int k = 0; k < K; k++) {
+        const int n = Y*n_slices_x + X + k;
+        _mm_prefetch((char *)&matrices[input[n].qindex], _MM_HINT_T0);
+        for (int c = 0; c < 3; c++) {
+          const int w = (c == 0) ? slice_width : slice_width/2;
+          void *optr = slice_output<T>(video_data[c], (X + k)*w, Y*slice_height, bands);
+          if (input[n].length[c] == 0) {
+            clear_slice_output<T>(video_data[c], optr, w, slice_height);
+          } else {
+            _mm_prefetch((char *)optr, _MM_HINT_T0);
+            dequant[c](&matrices[input[n].qindex], scratch[3*k + c]->data, optr, video_data[c]->stride,
+                       w, slice_height, depth);
+          }
+        }
 
-      input[n].padding = padding;
+        input[n].padding = padding[slot[3*k + 0]] + padding[slot[3*k + 1]] + padding[slot[3*k + 2]];
+      }
 
 #ifdef DEBUG_P_BLOCK_DEC
       {
@@ -231,12 +455,186 @@ template<class T> void decode_slices_sse4_2(QuantisationMatrix *matrices,
   }
 }
 
+template<class T> inline void STORE_SAMPLE(T *tgt, int32_t X);
+
+template<> inline void STORE_SAMPLE<int32_t>(int32_t *tgt, int32_t X) {
+  *tgt = X;
+}
+
+/* Saturates in the same way as the packing in the SSE4.2 dequantisers */
+template<> inline void STORE_SAMPLE<int16_t>(int16_t *tgt, int32_t X) {
+  *tgt = (int16_t)((X > 32767) ? 32767 : ((X < -32768) ? -32768 : X));
+}
+
+/* Dequantises coefficient n and puts it in place, moving on to the next subband's
+   quantiser whenever a subband boundary is passed */
+template<class T> inline void place_coefficient(T *odata, int ostride, const FusedPlacement &P, int &band, const int32_t *qf, const int32_t *qo, int n, int32_t D) {
+  while (n >= P.band_end[band])
+    band++;
+  const int32_t X = (int32_t)(((uint32_t)abs(D)*(uint32_t)qf[band] + (uint32_t)qo[band])) >> 2;
+  STORE_SAMPLE<T>(&odata[P.y[n]*ostride + P.x[n]], (D < 0) ? -X : X);
+}
+
+/* Puts the whole coefficients after the first of a LUT entry in place, skipping the zeros */
+template<class T> inline void place_values(const LUTEntry &E, T *odata, int ostride, const FusedPlacement &P, int &band, const int32_t *qf, const int32_t *qo, int ocounter) {
+  __m128i Z = _mm_cmpeq_epi8(_mm_loadl_epi64((__m128i *)&E.val0), _mm_setzero_si128());
+  int mask = ~_mm_movemask_epi8(Z) & 0xFE;
+  while (mask) {
+    const int k = __builtin_ctz(mask);
+    if (ocounter + k >= P.length)
+      break;
+    place_coefficient<T>(odata, ostride, P, band, qf, qo, ocounter + k, (&E.val0)[k]);
+    mask &= mask - 1;
+  }
+}
+
+/* Decodes a component straight into its plane without going through scratch space. The
+   plane has already been cleared, so only the non-zero coefficients need putting in place, and
+   the zeros from the 0xFF bytes at the end of the coded data are passed over without stepping */
+template<class T> inline int decode_fused_sse4_2(uint8_t *idata, int ilength, T *odata, int ostride, const FusedPlacement &P, const int32_t *qf, const int32_t *qo) {
+  int icounter = 1;
+  int ocounter = 0;
+  int32_t V = 0;
+  int state;
+  int band = 0;
+  const int olength = P.length;
+  const int coded = ilength - trailing_ones_sse4_2(idata, ilength);
+
+  _mm_prefetch((char *)idata, _MM_HINT_T0);
+
+  const LUTEntry *next;
+  if (ilength > 0)
+    next = &VLCLUT[idata[0]];
+  else
+    next = &VLCLUT[0xFF];
+
+  while (ocounter < olength && (icounter < coded || (icounter < ilength && next != &VLCLUT[0xFF]))) {
+    const LUTEntry &E = *next;
+    next  = &VLCLUT[(((int)E.state) << 8) + idata[icounter++]];
+
+    V <<= E.preshift;
+    V |=  E.val0;
+
+    if (E.N > 0 && V != 1 && E.sgn != 0)
+      place_coefficient<T>(odata, ostride, P, band, qf, qo, ocounter, (V - 1)*E.sgn);
+    place_values<T>(E, odata, ostride, P, band, qf, qo, ocounter);
+
+    if (E.term)
+      V = E.V;
+    ocounter += E.N;
+  }
+
+  if (icounter < ilength && ocounter < olength) {
+    int run = (olength - ocounter + 7)/8;
+    if (run > ilength - icounter)
+      run = ilength - icounter;
+    icounter += run;
+    ocounter += 8*run;
+  }
+
+  if (icounter < ilength) {
+    return ilength - icounter;
+  }
+
+  if (ocounter < olength) {
+    const LUTEntry &E = *next;
+    state = E.state;
+
+    V <<= E.preshift;
+    V |=  E.val0;
+
+    if (E.N > 0 && V != 1 && E.sgn != 0)
+      place_coefficient<T>(odata, ostride, P, band, qf, qo, ocounter, (V - 1)*E.sgn);
+    place_values<T>(E, odata, ostride, P, band, qf, qo, ocounter);
+
+    if (E.term)
+      V = E.V;
+    ocounter += E.N;
+  }
+
+  if (ocounter < olength) {
+    switch (state) {
+    case STATE_DATA:
+      V <<= 1;
+      V += 1;
+    case STATE_FOLLOW:
+    case STATE_SIGN:
+      if (V != 1)
+        place_coefficient<T>(odata, ostride, P, band, qf, qo, ocounter, -(V - 1));
+    }
+  }
+
+  return 0;
+}
+
+template<class T> void decode_slices_fused_sse4_2(QuantisationMatrix *matrices,
+                                                  CodedSlice * const input,
+                                                  int n_slices_x,
+                                                  int n_slices_y,
+                                                  VideoPlane **video_data,
+                                                  int slice_width,
+                                                  int slice_height,
+                                                  int depth,
+                                                  FusedPlacement **placement) {
+  for (int i = 0; i < 16384; i += 64)
+    _mm_prefetch(((char *)VLCLUT) + i, _MM_HINT_T0);
+
+  const int width[3] = { slice_width, slice_width/2, slice_width/2 };
+
+  int32_t qf[3*MAX_DWT_DEPTH + 1];
+  int32_t qo[3*MAX_DWT_DEPTH + 1];
+
+  for (int Y = 0; Y < n_slices_y; Y++) {
+    for (int X = 0; X < n_slices_x; X++) {
+      const int n = Y*n_slices_x + X;
+      QuantisationMatrix &matrix = matrices[input[n].qindex];
+      qf[0] = *(int32_t *)&matrix.qfactor[0][0];
+      qo[0] = *(int32_t *)&matrix.qoffset[0][0];
+      for (int l = 1; l <= depth; l++) {
+        for (int s = 1; s < 4; s++) {
+          qf[3*(l - 1) + s] = *(int32_t *)&matrix.qfactor[l][s];
+          qo[3*(l - 1) + s] = *(int32_t *)&matrix.qoffset[l][s];
+        }
+      }
+
+      int padding = 0;
+      for (int c = 0; c < 3; c++) {
+        T *optr = &video_data[c]->as<T>()[Y*slice_height*video_data[c]->stride + X*width[c]];
+        clear_slice<T>(optr, video_data[c]->stride, width[c], slice_height);
+        if (input[n].length[c] != 0)
+          padding += decode_fused_sse4_2<T>((uint8_t *)input[n].data[c], input[n].length[c], optr, video_data[c]->stride, *placement[c], qf, qo);
+      }
+      input[n].padding = padding;
+    }
+  }
+}
+
 SliceDecoderFunc get_slice_decoder_sse4_2(int sample_size) {
   if (sample_size == 4) {
-    return decode_slices_sse4_2<int32_t>;
+    return decode_slices_sse4_2<int32_t, false>;
   } else if (sample_size == 2) {
-    return decode_slices_sse4_2<int16_t>;
+    return decode_slices_sse4_2<int16_t, false>;
   }
 
   return get_slice_decoder_c(sample_size);
 }
+
+SliceDecoderFunc get_wide_slice_decoder_sse4_2(int sample_size) {
+  if (sample_size == 4) {
+    return decode_slices_sse4_2<int32_t, true>;
+  } else if (sample_size == 2) {
+    return decode_slices_sse4_2<int16_t, true>;
+  }
+
+  return get_slice_decoder_c(sample_size);
+}
+
+FusedSliceDecoderFunc get_fused_slice_decoder_sse4_2(int sample_size) {
+  if (sample_size == 4) {
+    return decode_slices_fused_sse4_2<int32_t>;
+  } else if (sample_size == 2) {
+    return decode_slices_fused_sse4_2<int16_t>;
+  }
+
+  return NULL;
+}
@@ -29,6 +29,10 @@
 #include "vlc.hpp"
 
 SliceDecoderFunc get_slice_decoder_sse4_2(int sample_size);
+SliceDecoderFunc get_wide_slice_decoder_sse4_2(int sample_size);
+
+/* Returns NULL where there is no fused decoder for the sample size */
+FusedSliceDecoderFunc get_fused_slice_decoder_sse4_2(int sample_size);
 
 
 